@@ -0,0 +1,24 @@
+/*
+ * acq_engine.h
+ *
+ * Purpose: Declare the single task acquisition engine.
+ * Content:
+ * Engine task, its stack size and the savings report.
+ */
+
+#ifndef ACQ_ENGINE_H
+#define ACQ_ENGINE_H
+
+#include "sensors.h"
+
+// stack of the engine task in words, it runs the processing of every sensor
+#define ACQ_ENGINE_STACK_SIZE 512
+
+/* replaced_stack_words/replaced_tasks: stacks and number of the sensor
+ * tasks the engine stands in for, used to report the RAM saved
+ * */
+void ACQ_ENGINE_Init(uint32_t replaced_stack_words, uint32_t replaced_tasks);
+void vAcqEngineTask(void *pvParameters);
+void ACQ_ENGINE_Report(void);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * adaptive.c
+ *
+ * Purpose: Sample quiet sensors less often and active ones more often.
+ * Content:
+ * Activity test per sample: deviation from an EWMA baseline and baseline
+ * distance to the thresholds, both in standard deviations.
+ * effective_interval update within [min_interval, max_interval] of sensor_ctrl.
+ *
+ * Fast attack, slow release: on activity the interval drops straight to
+ * min_interval; every ADAPT_QUIET_SAMPLES quiet samples it grows by half
+ * until max_interval. The acquisition (sensor tasks, acq_engine.c, drdy.c)
+ * and the predictive scheduler use effective_interval.
+ */
+
+#include "adaptive.h"
+#include <math.h>
+#include <string.h>
+
+typedef struct {
+	float mean;
+	float var;
+	uint16_t count;
+	uint16_t quiet;
+} adapt_state;
+
+static adapt_state state[SENSOR_COUNT];
+
+void ADAPT_Init(void) {
+	memset(state, 0, sizeof(state));
+}
+
+/* The baseline is close enough to a threshold for the noise alone to cross it */
+static int near_limit(const sensor_ctrl_data *ctrl, float mean, float sd) {
+	float margin = ctrl->threshold_up - mean;
+
+	// negative lower limits are unreachable for magnitudes, only the upper one counts then
+	if (ctrl->threshold_down > 0 && mean - ctrl->threshold_down < margin) {
+		margin = mean - ctrl->threshold_down;
+	}
+	return margin < ADAPT_Z_NEAR * sd;
+}
+
+/* Called with every processed value (magnitude for the 3 axis sensors) */
+void ADAPT_Update(sensor_id sensor, float value) {
+	sensor_ctrl_data *ctrl = sensor_ctrl[sensor];
+	adapt_state *st = &state[sensor];
+	int active;
+	float var = 0;
+
+	if (!ADAPT_ENABLE || ctrl->min_interval <= 0) {
+		return;
+	}
+
+	float diff = value - st->mean;
+	if (st->count == 0) {
+		st->mean = value;
+		active = 0;
+	}else{
+		float floor = 1e-6f + 1e-6f * st->mean * st->mean;
+		var = st->var > floor ? st->var : floor;
+		active = diff * diff > ADAPT_Z_ACTIVE * ADAPT_Z_ACTIVE * var;
+		float incr = ADAPT_ALPHA * diff;
+		st->mean += incr;
+		st->var = (1 - ADAPT_ALPHA) * (st->var + diff * incr);
+	}
+	if (st->count < 0xFFFF) {
+		st->count++;
+	}
+
+	// no decision until the baseline has seen a few samples
+	if (st->count < ADAPT_QUIET_SAMPLES) {
+		return;
+	}
+
+	if (active || near_limit(ctrl, st->mean, sqrtf(var))) {
+		st->quiet = 0;
+		ctrl->effective_interval = ctrl->min_interval;
+	}else if (++st->quiet >= ADAPT_QUIET_SAMPLES) {
+		int interval = ctrl->effective_interval + ctrl->effective_interval / 2;
+		st->quiet = 0;
+		ctrl->effective_interval = interval < ctrl->max_interval ? interval : ctrl->max_interval;
+	}
+}
+
+/* Current intervals, motion and environmental sensors on one line each */
+void ADAPT_Report(void) {
+	char message[MAX_MESSAGE_LENGTH];
+
+	for (int first = 0; first < SENSOR_COUNT; first += 3) {
+		snprintf(message, sizeof(message), "Interval ms %s %d %s %d %s %d\r\n",
+				sensor_name[first], sensor_ctrl[first]->effective_interval,
+				sensor_name[first + 1], sensor_ctrl[first + 1]->effective_interval,
+				sensor_name[first + 2], sensor_ctrl[first + 2]->effective_interval);
+		send_uart_message(message);
+	}
+}
@@ -0,0 +1,35 @@
+/*
+ * adaptive.h
+ *
+ * Purpose: Declare the activity adaptive sampling controller.
+ * Content:
+ * Controller parameters, per sample update and report.
+ */
+
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include "sensors.h"
+
+// 0 keeps every sensor at its nominal interval
+#ifndef ADAPT_ENABLE
+#define ADAPT_ENABLE 1
+#endif
+
+// EWMA weight of a new sample for the activity baseline
+#define ADAPT_ALPHA 0.2f
+
+// a sample this many standard deviations from the baseline is activity
+#define ADAPT_Z_ACTIVE 3.0f
+
+// a baseline within this many standard deviations of a threshold is activity
+#define ADAPT_Z_NEAR 3.0f
+
+// quiet samples in a row before the interval is stretched by half
+#define ADAPT_QUIET_SAMPLES 10
+
+void ADAPT_Init(void);
+void ADAPT_Update(sensor_id sensor, float value);
+void ADAPT_Report(void);
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * alarm_mgr.c
+ *
+ * Purpose: Keep alarm storms off the UART.
+ * Content:
+ * One entry per sensor and condition, decision print/suppress per event.
+ * Deferred clears against flapping, periodic summaries of the repeats.
+ * Export of the suppression state and report.
+ *
+ * The rules only post state changes, but a value flapping around a limit
+ * or a detector firing again and again still produced a pair of alarm
+ * lines per event, and a few sensors at once could fill the link. Only
+ * state changes are printed now: a trip, a clear that held for
+ * ALARM_HOLDOFF_MS, or an anomaly ALARM_ESCALATE_RATIO times stronger than
+ * the printed one. Repeats are counted and printed as one summary line
+ * (count, first and last time) every ALARM_SUMMARY_MS. The actuators and
+ * LEDs still see every event (event.c), only the output is reduced.
+ * Used by the critical event task only, ALARM_Export() may be called from
+ * any task (console alarms).
+ */
+
+#include "alarm_mgr.h"
+#include <math.h>
+#include <string.h>
+
+static alarm_entry entry[ALARM_ENTRIES];
+static uint32_t untracked;
+static uint32_t deferred;		// summary lines that found the UART queue full
+static TickType_t last_summary;
+
+void ALARM_Init(void) {
+	memset(entry, 0, sizeof(entry));
+	untracked = 0;
+	deferred = 0;
+	last_summary = xTaskGetTickCount();
+}
+
+/* Entry of the event's sensor and condition, a free one if new, NULL if full */
+static alarm_entry *find(const event_record *event) {
+	alarm_entry *free_entry = NULL;
+
+	for (int i = 0; i < ALARM_ENTRIES; i++) {
+		if (entry[i].what == event->what && entry[i].sensor == event->sensor) {
+			return &entry[i];
+		}
+		if (entry[i].what == NULL && free_entry == NULL) {
+			free_entry = &entry[i];
+		}
+	}
+
+	if (free_entry != NULL) {
+		taskENTER_CRITICAL();
+		memset(free_entry, 0, sizeof(*free_entry));
+		free_entry->what = event->what;
+		free_entry->sensor = event->sensor;
+		taskEXIT_CRITICAL();
+	}
+	return free_entry;
+}
+
+static void stamp(alarm_time *time, const event_record *event) {
+	time->Hours = event->Hours;
+	time->Minutes = event->Minutes;
+	time->Seconds = event->Seconds;
+	time->milliSeconds = event->milliSeconds;
+}
+
+/* Count a repeat towards the next summary */
+static alarm_decision suppress(alarm_entry *e, const event_record *event) {
+	if (e->suppressed++ == 0) {
+		stamp(&e->first, event);
+	}
+	stamp(&e->last, event);
+	return ALARM_SUPPRESS;
+}
+
+/* Print or count the event, clears are held back (ALARM_Due) */
+alarm_decision ALARM_Filter(const event_record *event) {
+	TickType_t now = xTaskGetTickCount();
+	alarm_entry *e = find(event);
+	alarm_decision decision;
+
+	if (e == NULL) {
+		untracked++;
+		return ALARM_PRINT;
+	}
+
+	taskENTER_CRITICAL();
+	switch (event->type) {
+		case EVENT_CLEAR:
+			e->active = 0;
+			e->clear_pending = 1;
+			e->clear = *event;
+			decision = ALARM_SUPPRESS;
+			break;
+
+		case EVENT_TRIP:
+			e->raised++;
+			e->active = 1;
+			if (e->clear_pending) {
+				// back before the clear was shown: one flap, the alarm line still holds
+				e->clear_pending = 0;
+				decision = suppress(e, event);
+			}else{
+				decision = ALARM_PRINT;
+			}
+			break;
+
+		default:
+			e->raised++;
+			if (e->active && now - e->last_event < pdMS_TO_TICKS(ALARM_HOLDOFF_MS)
+					&& fabsf(event->score) < ALARM_ESCALATE_RATIO * e->severity) {
+				decision = suppress(e, event);
+			}else{
+				e->active = 1;
+				e->severity = fabsf(event->score);
+				decision = ALARM_PRINT;
+			}
+			break;
+	}
+	e->type = event->type;
+	e->last_event = now;
+	taskEXIT_CRITICAL();
+
+	return decision;
+}
+
+/* Next clear that held for ALARM_HOLDOFF_MS, SUCCESS if there is one.
+ * Anomalies that stopped repeating become inactive on the way.
+ * */
+int ALARM_Due(event_record *event) {
+	TickType_t now = xTaskGetTickCount();
+	int status = FAILURE;
+
+	taskENTER_CRITICAL();
+	for (int i = 0; i < ALARM_ENTRIES && status == FAILURE; i++) {
+		alarm_entry *e = &entry[i];
+
+		if (e->what == NULL || now - e->last_event < pdMS_TO_TICKS(ALARM_HOLDOFF_MS)) {
+			continue;
+		}
+		if (e->clear_pending) {
+			e->clear_pending = 0;
+			*event = e->clear;
+			status = SUCCESS;
+		}else if (e->type == EVENT_ANOMALY || e->type == EVENT_PATTERN) {
+			e->active = 0;	// detectors and patterns post no clear
+		}
+	}
+	taskEXIT_CRITICAL();
+	return status;
+}
+
+/* Every ALARM_SUMMARY_MS, one line per condition with counted repeats.
+ * Runs in the critical event task, which must not wait behind the sample
+ * lines: a line that finds the UART queue full is counted as deferred and
+ * its repeats go into the next summary.
+ * */
+void ALARM_Summary(void) {
+	char message[MAX_MESSAGE_LENGTH];
+
+	if (xTaskGetTickCount() - last_summary < pdMS_TO_TICKS(ALARM_SUMMARY_MS)) {
+		return;
+	}
+	last_summary = xTaskGetTickCount();
+
+	for (int i = 0; i < ALARM_ENTRIES; i++) {
+		alarm_entry *e = &entry[i];
+		uint32_t count;
+		alarm_time first, last;
+
+		taskENTER_CRITICAL();
+		count = e->suppressed;
+		first = e->first;
+		last = e->last;
+		e->suppressed = 0;
+		taskEXIT_CRITICAL();
+
+		if (e->what == NULL || count == 0) {
+			continue;
+		}
+		snprintf(message, sizeof(message), "%s %s x%lu %02d:%02d:%02d..%02d:%02d:%02d\r\n",
+				sensor_name[e->sensor], e->what, (unsigned long)count, first.Hours, first.Minutes, first.Seconds,
+				last.Hours, last.Minutes, last.Seconds);
+		if (send_uart_message_nowait(message) != SUCCESS) {
+			taskENTER_CRITICAL();
+			if (e->suppressed == 0) {
+				e->last = last;
+			}
+			e->first = first;
+			e->suppressed += count;
+			taskEXIT_CRITICAL();
+			deferred++;
+		}
+	}
+}
+
+/* Copy of entry index, SUCCESS if it is in use. One entry per call, so the
+ * interrupts are masked for one copy only.
+ * */
+int ALARM_Export(int index, alarm_entry *out) {
+	if (index < 0 || index >= ALARM_ENTRIES) {
+		return FAILURE;
+	}
+	taskENTER_CRITICAL();
+	*out = entry[index];
+	taskEXIT_CRITICAL();
+	return out->what != NULL ? SUCCESS : FAILURE;
+}
+
+/* Called by the scheduler with the periodic report */
+void ALARM_Report(void) {
+	char message[MAX_MESSAGE_LENGTH];
+	uint32_t raised = 0, active = 0, tracked = 0;
+
+	for (int i = 0; i < ALARM_ENTRIES; i++) {
+		if (entry[i].what != NULL) {
+			tracked++;
+			raised += entry[i].raised;
+			active += entry[i].active;
+		}
+	}
+	snprintf(message, sizeof(message), "Alarms %lu active %lu conditions %lu untracked %lu deferred %lu\r\n",
+			(unsigned long)raised, (unsigned long)active, (unsigned long)tracked, (unsigned long)untracked,
+			(unsigned long)deferred);
+	send_uart_message(message);
+}
@@ -0,0 +1,73 @@
+/*
+ * alarm_mgr.h
+ *
+ * Purpose: Declare the alarm manager.
+ * Content:
+ * Suppression parameters, per condition entry (exportable) and the
+ * functions used by the critical event task.
+ */
+
+#ifndef ALARM_MGR_H
+#define ALARM_MGR_H
+
+#include "event.h"
+#include "rules.h"
+#include "anomaly.h"
+#include "cep.h"
+
+/* One entry per condition that can raise an alarm: each rule, each
+ * detector on each sensor, each pattern under either of its two sensors
+ * (the one whose sample completed it). An untracked alarm is always printed.
+ * */
+#define ALARM_ENTRIES (RULE_COUNT + ANOMALY_DETECTOR_COUNT * SENSOR_COUNT + 2 * CEP_PATTERN_COUNT)
+
+/* Repeats of a condition within this time of its previous event are only
+ * counted, and a clear is printed once the condition stayed clear this long
+ * */
+#ifndef ALARM_HOLDOFF_MS
+#define ALARM_HOLDOFF_MS 10000
+#endif
+
+// period of the summary lines of the counted repeats
+#ifndef ALARM_SUMMARY_MS
+#define ALARM_SUMMARY_MS 60000
+#endif
+
+// an anomaly repeat this many times stronger than the printed one is printed again
+#define ALARM_ESCALATE_RATIO 2.0f
+
+typedef enum {
+	ALARM_SUPPRESS = 0,
+	ALARM_PRINT
+} alarm_decision;
+
+typedef struct {
+	uint8_t Hours;
+	uint8_t Minutes;
+	uint8_t Seconds;
+	uint16_t milliSeconds;
+} alarm_time;
+
+typedef struct {
+	const char *what;		// condition (rule or detector name), NULL: free
+	uint8_t sensor;
+	uint8_t type;			// event_type of the last event
+	uint8_t active;			// tripped rule, or anomaly repeating
+	uint8_t clear_pending;	// cleared, waiting for ALARM_HOLDOFF_MS
+	float severity;			// |score| of the last printed anomaly
+	uint32_t raised;		// trips and anomalies since start
+	uint32_t suppressed;	// repeats since the last summary
+	alarm_time first;		// first and last of those repeats
+	alarm_time last;
+	TickType_t last_event;
+	event_record clear;		// the deferred clear
+} alarm_entry;
+
+void ALARM_Init(void);
+alarm_decision ALARM_Filter(const event_record *event);
+int ALARM_Due(event_record *event);
+void ALARM_Summary(void);
+int ALARM_Export(int index, alarm_entry *out);
+void ALARM_Report(void);
+
+#endif
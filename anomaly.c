@@ -0,0 +1,178 @@
+/*
+ * anomaly.c
+ *
+ * Purpose: Detect shocks and drift in the sensor streams on the device.
+ * Content:
+ * EWMA mean/variance and z-score per sensor.
+ * Two sided CUSUM on the residual against a slow long-term baseline.
+ * Time of day baseline (one EWMA per slot) for the seasonal detector.
+ * Scored events raised through the alarm output of rules.c.
+ *
+ * Every detector is updated incrementally on each sample with a fixed
+ * amount of state per sensor. A detector reports when it starts firing,
+ * not on every sample it stays above its limit. The sensors run from one
+ * sample per few seconds to one block per 77 ms (imu_fifo.c, which feeds
+ * the largest magnitude of the block), so the seasonal baseline weighs a
+ * sample by the time since the previous one (ANOMALY_SEASON_TAU_S).
+ * The slots are in RAM and learned again after a reset; the seasonal
+ * detector stays off until the RTC holds the time of day (rtc_set_time(),
+ * console time), the RTC itself keeps running through a reset (main.c).
+ */
+
+#include "anomaly.h"
+#include "event.h"
+#include <math.h>
+#include <string.h>
+
+typedef struct {
+	float mean;
+	float var;
+	uint16_t count;			// samples, saturates at 0xFFFF
+} ewma;
+
+typedef struct {
+	ewma recent;
+	float reference;		// long-term level for the CUSUM
+	uint16_t reference_count;
+	float cusum_up;
+	float cusum_down;
+	ewma season[ANOMALY_SEASON_SLOTS];
+	TickType_t last_tick;	// previous sample, for the seasonal weight
+	uint8_t firing;			// bit per detector, for edge reporting
+	uint32_t count[ANOMALY_DETECTOR_COUNT];
+} sensor_anomaly;
+
+static sensor_anomaly anomaly[SENSOR_COUNT];
+
+static const char *const detector_name[ANOMALY_DETECTOR_COUNT] = {
+	"shock z", "drift up", "drift down", "unusual z"
+};
+
+void ANOMALY_Init(void) {
+	memset(anomaly, 0, sizeof(anomaly));
+}
+
+uint32_t ANOMALY_Count(sensor_id sensor, anomaly_detector detector) {
+	return anomaly[sensor].count[detector];
+}
+
+static float ewma_sd(const ewma *e) {
+	// floor relative to the level, a perfectly flat signal must not make every change infinite
+	float floor = 1e-6f + 1e-6f * e->mean * e->mean;
+	return sqrtf(e->var > floor ? e->var : floor);
+}
+
+/* Standardised residual of x against the baseline, then baseline update */
+static float ewma_update(ewma *e, float x, float alpha) {
+	float diff = x - e->mean;
+	float z = 0;
+
+	if (e->count == 0) {
+		e->mean = x;
+		e->var = 0;
+	}else{
+		z = diff / ewma_sd(e);
+
+		float incr = alpha * diff;
+		e->mean += incr;
+		e->var = (1 - alpha) * (e->var + diff * incr);
+	}
+	if (e->count < 0xFFFF) {
+		e->count++;
+	}
+	return z;
+}
+
+static void report(sensor_id sensor, anomaly_detector detector, float score, float value) {
+	event_record event = {
+		.what = detector_name[detector],
+		.action = "Check the rack!!!",
+		.value = value,
+		.score = score,
+		.sensor = sensor,
+		.type = EVENT_ANOMALY,
+		.high = detector != ANOMALY_CUSUM_DOWN && score > 0,
+	};
+
+	anomaly[sensor].count[detector]++;
+	EVENT_Post(&event);
+}
+
+/* Edge detection: 1 when a detector starts firing */
+static int edge(sensor_anomaly *a, anomaly_detector detector, int firing) {
+	uint8_t bit = 1 << detector;
+	int rising = firing && !(a->firing & bit);
+
+	if (firing) {
+		a->firing |= bit;
+	}else{
+		a->firing &= ~bit;
+	}
+	return rising;
+}
+
+int ANOMALY_Update(sensor_id sensor, float value) {
+	sensor_anomaly *a = &anomaly[sensor];
+	int warm = a->recent.count >= ANOMALY_WARMUP;
+	int fired = 0;
+
+	// drift residual in units of the recent noise, before the updates
+	float z_drift = (value - a->reference) / ewma_sd(&a->recent);
+	float z = ewma_update(&a->recent, value, ANOMALY_ALPHA);
+
+	// plain average until the slow EWMA has enough history
+	if (a->reference_count < 0xFFFF) {
+		a->reference_count++;
+	}
+	a->reference += fmaxf(ANOMALY_DRIFT_ALPHA, 1.0f / a->reference_count) * (value - a->reference);
+
+	/* seasonal baseline, by RTC time of day: weight of the time since the
+	 * previous sample, plain average until the slot has that much history.
+	 * Until the RTC is set to the time of day (console time) the hour is
+	 * only the time since the first power-up, so the slots are not used.
+	 * */
+	TickType_t now = xTaskGetTickCount();
+	int slot_warm = 0;
+	float z_season = 0;
+	if (rtc_time_valid()) {
+		float season_alpha = (float)(now - a->last_tick) / pdMS_TO_TICKS(1000UL * ANOMALY_SEASON_TAU_S);
+		ewma *slot = &a->season[sTime.Hours * ANOMALY_SEASON_SLOTS / 24];
+		slot_warm = slot->count >= ANOMALY_WARMUP;
+		z_season = ewma_update(slot, value, fminf(1.0f, fmaxf(season_alpha, 1.0f / (slot->count + 1))));
+	}
+	a->last_tick = now;
+
+	if (!warm) {
+		return 0;
+	}
+
+	// shock: one sample far from the recent mean
+	if (edge(a, ANOMALY_ZSCORE, fabsf(z) > ANOMALY_Z_LIMIT)) {
+		report(sensor, ANOMALY_ZSCORE, z, value);
+		fired |= 1 << ANOMALY_ZSCORE;
+	}
+
+	/* drift: accumulated small deviations, shocks are left out.
+	 * Once reported, the current level becomes the reference.
+	 * */
+	if (fabsf(z) <= ANOMALY_Z_LIMIT) {
+		a->cusum_up = fmaxf(0, a->cusum_up + z_drift - ANOMALY_CUSUM_K);
+		a->cusum_down = fmaxf(0, a->cusum_down - z_drift - ANOMALY_CUSUM_K);
+	}
+	if (a->cusum_up > ANOMALY_CUSUM_H || a->cusum_down > ANOMALY_CUSUM_H) {
+		anomaly_detector detector = a->cusum_up > ANOMALY_CUSUM_H ? ANOMALY_CUSUM_UP : ANOMALY_CUSUM_DOWN;
+
+		report(sensor, detector, fmaxf(a->cusum_up, a->cusum_down), value);
+		fired |= 1 << detector;
+		a->reference = a->recent.mean;
+		a->cusum_up = 0;
+		a->cusum_down = 0;
+	}
+
+	if (slot_warm && edge(a, ANOMALY_SEASONAL, fabsf(z_season) > ANOMALY_SEASON_Z_LIMIT)) {
+		report(sensor, ANOMALY_SEASONAL, z_season, value);
+		fired |= 1 << ANOMALY_SEASONAL;
+	}
+
+	return fired;
+}
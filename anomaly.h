@@ -0,0 +1,57 @@
+/*
+ * anomaly.h
+ *
+ * Purpose: Declare the streaming anomaly detectors.
+ * Content:
+ * Detector parameters (EWMA z-score, CUSUM, seasonal baseline) and the
+ * per sample update function.
+ */
+
+#ifndef ANOMALY_H
+#define ANOMALY_H
+
+#include "sensors.h"
+
+// EWMA weight of a new sample for the mean/variance of the z-score and CUSUM
+#ifndef ANOMALY_ALPHA
+#define ANOMALY_ALPHA 0.05f
+#endif
+
+// samples before a detector may fire, the baseline is learned meanwhile
+#define ANOMALY_WARMUP 20
+
+// |z| above this is a shock
+#define ANOMALY_Z_LIMIT 4.0f
+
+// much slower EWMA the CUSUM compares against, so it catches drift the recent mean follows
+#ifndef ANOMALY_DRIFT_ALPHA
+#define ANOMALY_DRIFT_ALPHA 0.002f
+#endif
+
+// CUSUM slack and decision threshold, in standard deviations
+#define ANOMALY_CUSUM_K 0.5f
+#define ANOMALY_CUSUM_H 8.0f
+
+// seasonal baseline: one EWMA per slot of the day (24: hourly), with a time
+// constant instead of a weight per sample, so that it learns as slowly at 416 Hz as at 0.2 Hz
+#define ANOMALY_SEASON_SLOTS 24
+#ifndef ANOMALY_SEASON_TAU_S
+#define ANOMALY_SEASON_TAU_S 3600
+#endif
+#define ANOMALY_SEASON_Z_LIMIT 4.0f
+
+typedef enum {
+	ANOMALY_ZSCORE = 0,		// sudden deviation from the recent mean
+	ANOMALY_CUSUM_UP,		// slow upward drift
+	ANOMALY_CUSUM_DOWN,		// slow downward drift
+	ANOMALY_SEASONAL,		// unusual for this time of day
+	ANOMALY_DETECTOR_COUNT
+} anomaly_detector;
+
+void ANOMALY_Init(void);
+// 3 axis sensors feed the magnitude (burst mode: the largest of each block),
+// returns a bit per detector that fired on this sample
+int ANOMALY_Update(sensor_id sensor, float value);
+uint32_t ANOMALY_Count(sensor_id sensor, anomaly_detector detector);
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * bench.c
+ *
+ * Purpose: Measure what the hot paths cost per call.
+ * Content:
+ * Benchmark cases for the FIFO writes and reads, the sample line and UART
+ * prefix formatting, the console number parsing, the sensor task float
+ * conversions and a trace event; repetition, statistics, UART output on
+ * the target.
+ *
+ * Each case runs BENCH_OPS operations per repetition, BENCH_REPEATS timed
+ * repetitions after one warm-up, with the scheduler suspended so that only
+ * interrupts get in. Times are TIMING_Cycles(): DWT cycles on the board,
+ * the host clock scaled to SystemCoreClock in the host bench (host/, which
+ * reports nanoseconds and writes a JSON results file). The median is the
+ * figure to compare between commits, the spread tells how far to trust it.
+ * On the target each case is printed as three lines, one UART message each,
+ * 	BENCH name=<case> ops=<n> reps=<n> unit=cycles
+ * 	BENCH name=<case> median=<c> sd=<c>
+ * 	BENCH name=<case> mean=<c> min=<c>
+ * which tools/bench_compare.py reads like the host's results file.
+ */
+
+#include "bench.h"
+
+#if BENCH_ENABLE
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "fifo.h"
+#include "dsp_kernels.h"
+#include "timing.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+	const char *name;
+	void (*setup)(void);		// untimed, before every repetition
+	void (*run)(uint32_t ops);
+} bench_case;
+
+static Data3Axis fifo3_buffer[BENCH_OPS];
+static Data fifo_buffer[BENCH_OPS];
+static FIFO3Axis fifo3 = { .data = fifo3_buffer, .size = BENCH_OPS };
+static FIFO fifo1 = { .data = fifo_buffer, .size = BENCH_OPS };
+static char line[MAX_MESSAGE_LENGTH + 16];
+static volatile float float_sink;
+
+// readings as the sensors deliver them, varied so formatting and parsing are not constant
+static const int16_t accel_raw[8][3] = {
+	{ -12, 8, 1003 }, { 35, -41, 987 }, { -250, 130, 1210 }, { 4, 0, 998 },
+	{ 812, -640, 455 }, { -3, 17, 1001 }, { 120, 95, 940 }, { -77, -12, 1024 }
+};
+static const float gyro_raw[8][3] = {
+	{ 70.0f, -140.0f, 210.0f }, { 1750.5f, -2280.0f, 35.0f }, { 0.0f, 0.0f, 0.0f }, { -350.0f, 420.0f, -70.0f },
+	{ 12500.0f, -8400.0f, 2100.0f }, { 140.0f, 70.0f, -210.0f }, { -49000.0f, 61250.0f, 700.0f }, { 280.0f, -35.0f, 105.0f }
+};
+static const char *const console_values[8] = {
+	"1000", "12.5", "-11", "0.75", "250", "1013.25", "36", "0.05"
+};
+
+static Data3Axis sample3(uint32_t i) {
+	Data3Axis d = {
+		.Hours = 13, .Minutes = (uint8_t)(i % 60), .Seconds = (uint8_t)((i * 7) % 60),
+		.milliSeconds = (i * 37) % 1000, .timestamp = i * 1000,
+		.x = accel_raw[i & 7][0] * 0.0098f, .y = accel_raw[i & 7][1] * 0.0098f, .z = accel_raw[i & 7][2] * 0.0098f,
+	};
+	return d;
+}
+
+static Data sample1(uint32_t i) {
+	Data d = {
+		.Hours = 13, .Minutes = (uint8_t)(i % 60), .Seconds = (uint8_t)((i * 7) % 60),
+		.milliSeconds = (i * 37) % 1000, .timestamp = i * 1000, .skipped = (uint16_t)(i & 3),
+		.value = 20.0f + (accel_raw[i & 7][0] & 0xFF) / 16.0f,
+	};
+	return d;
+}
+
+static void empty_fifos(void) {
+	FIFO_Init_3Axis(&fifo3);
+	FIFO_Init(&fifo1);
+}
+
+static void fill_fifo3(void) {
+	FIFO_Init_3Axis(&fifo3);
+	for (uint32_t i = 0; i < BENCH_OPS; i++) {
+		FIFO_Write_3Axis(&fifo3, sample3(i));
+	}
+}
+
+/* sensor task: store a sample */
+static void run_fifo_write_3axis(uint32_t ops) {
+	for (uint32_t i = 0; i < ops; i++) {
+		FIFO_Write_3Axis(&fifo3, sample3(i));
+	}
+}
+
+static void run_fifo_write(uint32_t ops) {
+	for (uint32_t i = 0; i < ops; i++) {
+		FIFO_Write(&fifo1, sample1(i));
+	}
+}
+
+/* scheduler: take a sample */
+static void run_fifo_read_3axis(uint32_t ops) {
+	Data3Axis d;
+
+	for (uint32_t i = 0; i < ops; i++) {
+		FIFO_Read_3Axis(&fifo3, &d);
+	}
+	float_sink = d.x;
+}
+
+/* scheduler: sample line of a motion sensor, as in vSchedulerTask */
+static void run_format_3axis(uint32_t ops) {
+	for (uint32_t i = 0; i < ops; i++) {
+		Data3Axis d = sample3(i);
+		sprintf(line, "%02d:%02d:%02d:%03lu Acl XYZ: %6.2f %6.2f %6.2f %02d/%02d\r\n",
+				d.Hours, d.Minutes, d.Seconds, (unsigned long)d.milliSeconds, d.x, d.y, d.z, (int)(i & 31), 32);
+	}
+}
+
+/* scheduler: sample line of an environmental sensor */
+static void run_format_1axis(uint32_t ops) {
+	for (uint32_t i = 0; i < ops; i++) {
+		Data d = sample1(i);
+		sprintf(line, "%02d:%02d:%02d:%03lu Temp: %6.2f %02d/%02d +%u\r\n",
+				d.Hours, d.Minutes, d.Seconds, (unsigned long)d.milliSeconds, d.value, (int)(i & 15), 16, d.skipped);
+	}
+}
+
+/* UART_Task: time prefix in front of a queued line */
+static void run_uart_prefix(uint32_t ops) {
+	static const char text[] = "13:04:27:512 Acl XYZ:  -0.12   0.08   9.83 03/32\r\n";
+
+	for (uint32_t i = 0; i < ops; i++) {
+		sprintf(line, "%02d:%02d:%02d:%03d %s", 13, (int)(i % 60), (int)((i * 7) % 60), (int)((i * 37) % 1000), text);
+	}
+}
+
+/* console: the number parsing of "set <sensor> <field> <value>" */
+static void run_console_parse(uint32_t ops) {
+	char *end;
+	float sum = 0;
+
+	for (uint32_t i = 0; i < ops; i++) {
+		sum += strtof(console_values[i & 7], &end);
+	}
+	float_sink = sum;
+}
+
+/* accelerometer task: mg -> m/s^2 and the norm for the rules */
+static void run_accel_convert(uint32_t ops) {
+	float xyz[3], sum = 0;
+
+	for (uint32_t i = 0; i < ops; i++) {
+		DSP_Convert_i16(accel_raw[i & 7], xyz, 3, 9.8f / 1000.0f);
+		sum += DSP_Norm_f32(xyz);
+	}
+	float_sink = sum;
+}
+
+/* gyroscope task: mdps -> dps and the norm */
+static void run_gyro_convert(uint32_t ops) {
+	float xyz[3], sum = 0;
+
+	for (uint32_t i = 0; i < ops; i++) {
+		DSP_Scale_f32(gyro_raw[i & 7], xyz, 3, 1.0f / 1000.0f);
+		sum += DSP_Norm_f32(xyz);
+	}
+	float_sink = sum;
+}
+
+#if TRACE_ENABLE
+/* trace: one event, as recorded by the kernel hooks and fifo.c; the type is
+ * outside the decoded ones, tools/trace2chrome.py skips it */
+static void run_trace_record(uint32_t ops) {
+	for (uint32_t i = 0; i < ops; i++) {
+		TRACE_Record(TRACE_TYPE_COUNT, 0, (uint16_t)i);
+	}
+}
+#endif
+
+static const bench_case cases[] = {
+	{ "fifo_write_3axis", empty_fifos, run_fifo_write_3axis },
+	{ "fifo_write", empty_fifos, run_fifo_write },
+	{ "fifo_read_3axis", fill_fifo3, run_fifo_read_3axis },
+	{ "format_3axis", NULL, run_format_3axis },
+	{ "format_1axis", NULL, run_format_1axis },
+	{ "uart_prefix", NULL, run_uart_prefix },
+	{ "console_parse", NULL, run_console_parse },
+	{ "accel_convert", NULL, run_accel_convert },
+	{ "gyro_convert", NULL, run_gyro_convert },
+#if TRACE_ENABLE
+	{ "trace_record", NULL, run_trace_record },
+#endif
+};
+
+static uint32_t measure(const bench_case *c) {
+	uint32_t start, cycles;
+
+	if (c->setup != NULL) {
+		c->setup();
+	}
+	vTaskSuspendAll();
+	start = TIMING_Cycles();
+	c->run(BENCH_OPS);
+	cycles = TIMING_Cycles() - start;
+	xTaskResumeAll();
+	return cycles;
+}
+
+static void statistics(float *per_op, bench_result *result) {
+	float sum = 0, sq = 0;
+
+	// insertion sort, a handful of values
+	for (int i = 1; i < BENCH_REPEATS; i++) {
+		float v = per_op[i];
+		int j = i - 1;
+		for (; j >= 0 && per_op[j] > v; j--) {
+			per_op[j + 1] = per_op[j];
+		}
+		per_op[j + 1] = v;
+	}
+	for (int i = 0; i < BENCH_REPEATS; i++) {
+		sum += per_op[i];
+	}
+	result->mean = sum / BENCH_REPEATS;
+	for (int i = 0; i < BENCH_REPEATS; i++) {
+		sq += (per_op[i] - result->mean) * (per_op[i] - result->mean);
+	}
+	result->stddev = BENCH_REPEATS > 1 ? sqrtf(sq / (BENCH_REPEATS - 1)) : 0;
+	result->median = BENCH_REPEATS % 2 ? per_op[BENCH_REPEATS / 2]
+			: (per_op[BENCH_REPEATS / 2 - 1] + per_op[BENCH_REPEATS / 2]) / 2;
+	result->min = per_op[0];
+	result->max = per_op[BENCH_REPEATS - 1];
+}
+
+/* Runs every case and hands each result to sink */
+void BENCH_Run(bench_sink sink) {
+	float per_op[BENCH_REPEATS];
+	bench_result result;
+
+	for (uint32_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+		measure(&cases[c]);		// warm-up: caches, lazy initialisation in the C library
+		for (int r = 0; r < BENCH_REPEATS; r++) {
+			per_op[r] = (float)measure(&cases[c]) / BENCH_OPS;
+		}
+		result.name = cases[c].name;
+		result.ops = BENCH_OPS;
+		result.repeats = BENCH_REPEATS;
+		statistics(per_op, &result);
+		sink(&result);
+	}
+}
+
+/* Target sink, see the format above */
+void BENCH_Print(const bench_result *result) {
+	char message[MAX_MESSAGE_LENGTH];
+
+	snprintf(message, sizeof(message), "BENCH name=%s ops=%lu reps=%lu unit=cycles\r\n",
+			result->name, (unsigned long)result->ops, (unsigned long)result->repeats);
+	send_uart_message(message);
+	snprintf(message, sizeof(message), "BENCH name=%s median=%.1f sd=%.1f\r\n",
+			result->name, result->median, result->stddev);
+	send_uart_message(message);
+	snprintf(message, sizeof(message), "BENCH name=%s mean=%.1f min=%.1f\r\n",
+			result->name, result->mean, result->min);
+	send_uart_message(message);
+}
+
+#endif
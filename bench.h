@@ -0,0 +1,44 @@
+/*
+ * bench.h
+ *
+ * Purpose: Declare the microbenchmark suite of the hot paths.
+ * Content:
+ * Benchmark result, result sink, suite runner, UART sink of the target.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "main.h"
+
+// 1 runs BENCH_Run() once when the scheduler task starts (the host bench always runs it)
+#ifndef BENCH_ENABLE
+#define BENCH_ENABLE 0
+#endif
+
+// timed repetitions per case, the statistics are over these
+#ifndef BENCH_REPEATS
+#define BENCH_REPEATS 15
+#endif
+
+// operations per repetition
+#define BENCH_OPS 64
+
+typedef struct {
+	const char *name;
+	uint32_t ops;			// operations per repetition
+	uint32_t repeats;
+	// TIMING_Cycles() per operation over the repetitions
+	float median, mean, stddev, min, max;
+} bench_result;
+
+typedef void (*bench_sink)(const bench_result *result);
+
+#if BENCH_ENABLE
+void BENCH_Run(bench_sink sink);
+void BENCH_Print(const bench_result *result);
+#else
+#define BENCH_Run(sink) ((void)0)
+#endif
+
+#endif
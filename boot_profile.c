@@ -0,0 +1,79 @@
+/*
+ * boot_profile.c
+ *
+ * Purpose: Show where the boot time goes and when data starts flowing.
+ * Content:
+ * Timestamps of the boot phases and of each sensor's bring-up and first
+ * stored sample, on the DWT microsecond clock, printed once.
+ *
+ * t = 0 is TIMING_Init(), right after the system clock configuration.
+ * The sensors are brought up slowest first (sensors_init), so their
+ * power-up and first conversion run during the rest of the boot and in
+ * parallel, and each sensor's first read waits only for its own startup
+ * time (SENSOR_StartupDelay) instead of a full interval. Time to first
+ * sample is the metric to watch: it is what a reset costs in data.
+ */
+
+#include "boot_profile.h"
+#include "timing.h"
+
+static const char *const phase_name[BOOT_PHASE_COUNT] = {
+	"clock", "uart", "rtc", "sensors", "modules", "drivers", "tasks"
+};
+
+static uint32_t phase_us[BOOT_PHASE_COUNT];
+static uint32_t up_us[SENSOR_COUNT];
+static uint32_t first_us[SENSOR_COUNT];
+static volatile uint32_t first_mask;
+static uint8_t reported;
+
+void BOOT_Mark(boot_phase phase) {
+	phase_us[phase] = TIMING_Micros();
+}
+
+void BOOT_SensorUp(sensor_id sensor) {
+	up_us[sensor] = TIMING_Micros();
+}
+
+uint32_t BOOT_SensorUpTime(sensor_id sensor) {
+	return up_us[sensor];
+}
+
+/* Called on every stored sample, only the first one of a sensor costs a timestamp */
+void BOOT_FirstSample(sensor_id sensor) {
+	if (first_mask & (1u << sensor)) {
+		return;
+	}
+	first_us[sensor] = TIMING_Micros();
+	taskENTER_CRITICAL();
+	first_mask |= 1u << sensor;
+	taskEXIT_CRITICAL();
+}
+
+/* Called by the scheduler loop, prints the timeline once */
+void BOOT_Poll(void) {
+	char message[MAX_MESSAGE_LENGTH];
+	uint32_t all = (1u << SENSOR_COUNT) - 1;
+
+	if (reported || (first_mask != all && TIMING_Micros() < BOOT_REPORT_TIMEOUT_MS * 1000u)) {
+		return;
+	}
+	reported = 1;
+
+	for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+		uint32_t start = i > 0 ? phase_us[i - 1] : 0;
+		snprintf(message, sizeof(message), "Boot %-8s done %8.1f ms (%.1f ms)\r\n",
+				phase_name[i], phase_us[i] / 1000.0f, (phase_us[i] - start) / 1000.0f);
+		send_uart_message(message);
+	}
+	for (int i = 0; i < SENSOR_COUNT; i++) {
+		if (first_mask & (1u << i)) {
+			snprintf(message, sizeof(message), "Boot %-5s up %8.1f ms, first sample %8.1f ms\r\n",
+					sensor_name[i], up_us[i] / 1000.0f, first_us[i] / 1000.0f);
+		}else{
+			snprintf(message, sizeof(message), "Boot %-5s up %8.1f ms, no sample yet\r\n",
+					sensor_name[i], up_us[i] / 1000.0f);
+		}
+		send_uart_message(message);
+	}
+}
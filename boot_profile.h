@@ -0,0 +1,37 @@
+/*
+ * boot_profile.h
+ *
+ * Purpose: Declare the boot timeline.
+ * Content:
+ * Boot phases, sensor bring-up and first sample marks, one-time report.
+ */
+
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include "sensors.h"
+
+// the report is printed once every sensor stored a sample, or after this long
+#ifndef BOOT_REPORT_TIMEOUT_MS
+#define BOOT_REPORT_TIMEOUT_MS 15000
+#endif
+
+// phases in boot order, each mark is the end of its phase
+typedef enum {
+	BOOT_CLOCK = 0,		// HAL, system clock, cycle counter: t = 0
+	BOOT_UART,
+	BOOT_RTC,
+	BOOT_SENSORS,		// BSP bring-up of all sensors (sensors_init)
+	BOOT_MODULES,		// processing modules, configuration load
+	BOOT_DRIVERS,		// I2C bus manager, console, data-ready/FIFO interrupts
+	BOOT_TASKS,			// right before vTaskStartScheduler
+	BOOT_PHASE_COUNT
+} boot_phase;
+
+void BOOT_Mark(boot_phase phase);
+void BOOT_SensorUp(sensor_id sensor);
+void BOOT_FirstSample(sensor_id sensor);
+uint32_t BOOT_SensorUpTime(sensor_id sensor);
+void BOOT_Poll(void);
+
+#endif
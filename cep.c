@@ -0,0 +1,247 @@
+/*
+ * cep.c
+ *
+ * Purpose: Detect failure signatures that span several sensors.
+ * Content:
+ * Pattern table: two atoms joined by AND (time aligned) or THEN (sequence).
+ * Bucketed sliding window sums per atom: mean, standard deviation and
+ * least squares slope in O(CEP_BUCKETS), whatever the sample rate.
+ * Incremental evaluation on each sample of the sensors a pattern uses.
+ *
+ * Rising temperature alone may be a hot day and some vibration a passing
+ * trolley, together they are a failing fan. Each atom keeps its window as
+ * CEP_BUCKETS partial sums with bucket local times and values relative to
+ * the first one, so float precision holds over days and at 1000 hPa. A
+ * sample only updates and re-evaluates the atoms of its sensor; a pattern
+ * reports through the critical event task when it starts matching.
+ */
+
+#include "cep.h"
+#include "event.h"
+#include <math.h>
+#include <string.h>
+
+/***********************************************
+ * Pattern table
+ ***********************************************/
+static const cep_pattern pattern_table[] = {
+	{	{ SENSOR_TEMP,  CEP_SLOPE, CEP_ABOVE,  0.5f, 300000 }, CEP_AND,
+		{ SENSOR_ACCEL, CEP_SD,    CEP_ABOVE,  0.5f, 10000 },  60000,
+		"fan failing", "Check the rack fans!!!" },
+	{	{ SENSOR_PRESS, CEP_SLOPE, CEP_BELOW, -0.5f, 120000 }, CEP_THEN,
+		{ SENSOR_TEMP,  CEP_SLOPE, CEP_ABOVE,  0.5f, 300000 }, 600000,
+		"airflow loss", "Check the cooling unit!!!" },
+	{	{ SENSOR_HUMID, CEP_SLOPE, CEP_ABOVE,  2.0f, 300000 }, CEP_AND,
+		{ SENSOR_TEMP,  CEP_SLOPE, CEP_BELOW, -0.5f, 300000 }, 120000,
+		"condensation risk", "Turning on dehumidifier..." },
+};
+
+_Static_assert(sizeof(pattern_table) / sizeof(pattern_table[0]) == CEP_PATTERN_COUNT, "CEP_PATTERN_COUNT in cep.h must match pattern_table");
+
+// sums of the samples of one bucket, t in s from the bucket start, v relative to ref
+typedef struct {
+	uint16_t n;
+	float st, sv, stt, stv, svv;
+} cep_bucket;
+
+typedef struct {
+	cep_bucket bucket[CEP_BUCKETS];
+	TickType_t bucket_id[CEP_BUCKETS];
+	float ref;
+	uint8_t has_ref;
+	uint8_t holds;
+	uint8_t has_rose;
+	TickType_t sampled;		// tick of the last sample
+	TickType_t rose;		// tick when it last started holding
+} atom_state;
+
+typedef struct {
+	atom_state a, b;
+	uint8_t active;
+} pattern_state;
+
+static pattern_state state[CEP_PATTERN_COUNT];
+
+void CEP_Init(void) {
+	memset(state, 0, sizeof(state));
+	for (uint32_t p = 0; p < CEP_PATTERN_COUNT; p++) {
+		for (int b = 0; b < CEP_BUCKETS; b++) {
+			state[p].a.bucket_id[b] = (TickType_t)-1;
+			state[p].b.bucket_id[b] = (TickType_t)-1;
+		}
+	}
+}
+
+static TickType_t bucket_ticks(const cep_atom *atom) {
+	TickType_t width = pdMS_TO_TICKS(atom->window_ms) / CEP_BUCKETS;
+	return width > 0 ? width : 1;
+}
+
+static void add(const cep_atom *atom, atom_state *s, float value, TickType_t now) {
+	TickType_t width = bucket_ticks(atom);
+	TickType_t id = now / width;
+	int slot = id % CEP_BUCKETS;
+	cep_bucket *b = &s->bucket[slot];
+
+	if (!s->has_ref) {
+		s->ref = value;
+		s->has_ref = 1;
+	}
+	if (s->bucket_id[slot] != id) {
+		s->bucket_id[slot] = id;
+		memset(b, 0, sizeof(*b));
+	}
+
+	float t = (float)(now - id * width) / configTICK_RATE_HZ;
+	float v = value - s->ref;
+	b->n++;
+	b->st += t;
+	b->sv += v;
+	b->stt += t * t;
+	b->stv += t * v;
+	b->svv += v * v;
+}
+
+/* Feature over the buckets of the window, SUCCESS if there are enough samples */
+static int feature(const cep_atom *atom, const atom_state *s, float value, TickType_t now, float *out) {
+	TickType_t width = bucket_ticks(atom);
+	TickType_t first = now / width - (CEP_BUCKETS - 1);
+	float n = 0, st = 0, sv = 0, stt = 0, stv = 0, svv = 0;
+
+	if (atom->feature == CEP_VALUE) {
+		*out = value;
+		return SUCCESS;
+	}
+
+	// move each bucket's times to the start of the oldest bucket of the window
+	for (int i = 0; i < CEP_BUCKETS; i++) {
+		const cep_bucket *b = &s->bucket[i];
+		if (s->bucket_id[i] - first >= CEP_BUCKETS || b->n == 0) {
+			continue;
+		}
+		float d = (float)((s->bucket_id[i] - first) * width) / configTICK_RATE_HZ;
+		n += b->n;
+		st += b->st + b->n * d;
+		stt += b->stt + 2 * d * b->st + b->n * d * d;
+		sv += b->sv;
+		stv += b->stv + d * b->sv;
+		svv += b->svv;
+	}
+	if (n < CEP_MIN_SAMPLES) {
+		return FAILURE;
+	}
+
+	switch (atom->feature) {
+		case CEP_MEAN:
+			*out = s->ref + sv / n;
+			return SUCCESS;
+		case CEP_SD:
+			*out = sqrtf(fmaxf(0, svv / n - (sv / n) * (sv / n)));
+			return SUCCESS;
+		default: {
+			float den = n * stt - st * st;
+			if (den <= 0) {
+				return FAILURE;
+			}
+			*out = 60 * (n * stv - st * sv) / den;
+			return SUCCESS;
+		}
+	}
+}
+
+/* Add the sample and tell whether the atom holds. Only the bucket update
+ * and a copy of the window run with interrupts masked, the feature is
+ * computed on the copy.
+ * */
+static int evaluate_atom(const cep_atom *atom, atom_state *s, float value, TickType_t now) {
+	atom_state window;
+	float x;
+
+	taskENTER_CRITICAL();
+	add(atom, s, value, now);
+	window = *s;
+	taskEXIT_CRITICAL();
+
+	if (feature(atom, &window, value, now, &x) != SUCCESS) {
+		return 0;
+	}
+	return atom->cmp == CEP_ABOVE ? x > atom->limit : x < atom->limit;
+}
+
+/* With interrupts masked, matches() reads it from the other sensor's task */
+static void set_holds(atom_state *s, int holds, TickType_t now) {
+	if (holds && !s->holds) {
+		s->rose = now;
+		s->has_rose = 1;
+	}
+	s->holds = holds;
+	s->sampled = now;
+}
+
+static int matches(const cep_pattern *p, const pattern_state *s) {
+	TickType_t within = pdMS_TO_TICKS(p->within_ms);
+
+	if (!s->b.holds) {
+		return 0;
+	}
+	if (p->op == CEP_AND) {
+		TickType_t apart = s->a.sampled - s->b.sampled;
+		if ((TickType_t)(s->b.sampled - s->a.sampled) < apart) {
+			apart = s->b.sampled - s->a.sampled;
+		}
+		return s->a.holds && apart <= within;
+	}
+	// wraps to a large difference when b started before a
+	return s->a.has_rose && (TickType_t)(s->b.rose - s->a.rose) <= within;
+}
+
+uint32_t CEP_Update(sensor_id sensor, float value) {
+	TickType_t now = xTaskGetTickCount();
+	uint32_t fired = 0;
+
+	for (uint32_t i = 0; i < CEP_PATTERN_COUNT; i++) {
+		const cep_pattern *p = &pattern_table[i];
+		pattern_state *s = &state[i];
+		int holds_a = 0, holds_b = 0;
+
+		if (p->a.sensor != sensor && p->b.sensor != sensor) {
+			continue;
+		}
+		if (p->a.sensor == sensor) {
+			holds_a = evaluate_atom(&p->a, &s->a, value, now);
+		}
+		if (p->b.sensor == sensor) {
+			holds_b = evaluate_atom(&p->b, &s->b, value, now);
+		}
+
+		// patterns span sensors sampled by different tasks
+		taskENTER_CRITICAL();
+		if (p->a.sensor == sensor) {
+			set_holds(&s->a, holds_a, now);
+		}
+		if (p->b.sensor == sensor) {
+			set_holds(&s->b, holds_b, now);
+		}
+		int match = matches(p, s);
+		if (match && !s->active) {
+			fired |= 1u << i;
+		}
+		s->active = match;
+		taskEXIT_CRITICAL();
+	}
+
+	for (uint32_t i = 0; fired >> i; i++) {
+		if (fired & (1u << i)) {
+			event_record event = {
+				.what = pattern_table[i].what,
+				.action = pattern_table[i].action,
+				.value = value,
+				.sensor = sensor,
+				.type = EVENT_PATTERN,
+				.high = 1,
+			};
+			EVENT_Post(&event);
+		}
+	}
+	return fired;
+}
@@ -0,0 +1,62 @@
+/*
+ * cep.h
+ *
+ * Purpose: Declare the cross-sensor complex event processing.
+ * Content:
+ * Window features, atoms (feature of one sensor against a limit), patterns
+ * joining two atoms and the per sample update.
+ */
+
+#ifndef CEP_H
+#define CEP_H
+
+#include "sensors.h"
+
+// buckets per atom window, the window slides by window_ms / CEP_BUCKETS
+#define CEP_BUCKETS 6
+
+// samples in the window before MEAN, SD or SLOPE can hold
+#define CEP_MIN_SAMPLES 3
+
+typedef enum {
+	CEP_VALUE = 0,		// latest value
+	CEP_MEAN,			// mean over the window
+	CEP_SD,				// standard deviation over the window
+	CEP_SLOPE			// least squares trend over the window, per minute
+} cep_feature;
+
+typedef enum {
+	CEP_ABOVE = 0,
+	CEP_BELOW
+} cep_cmp;
+
+typedef enum {
+	CEP_AND = 0,		// a and b hold on samples at most within_ms apart
+	CEP_THEN			// b starts holding at most within_ms after a started
+} cep_op;
+
+typedef struct {
+	sensor_id sensor;
+	cep_feature feature;
+	cep_cmp cmp;
+	float limit;
+	uint32_t window_ms;
+} cep_atom;
+
+typedef struct {
+	cep_atom a;
+	cep_op op;
+	cep_atom b;
+	uint32_t within_ms;
+	const char *what;		// "fan failing"
+	const char *action;		// printed when the pattern matches
+} cep_pattern;
+
+// rows of pattern_table in cep.c, checked there
+#define CEP_PATTERN_COUNT 3
+
+void CEP_Init(void);
+// 3 axis sensors feed the magnitude, returns a bit per pattern that started matching
+uint32_t CEP_Update(sensor_id sensor, float value);
+
+#endif
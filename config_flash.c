@@ -0,0 +1,91 @@
+/*
+ * config_flash.c
+ *
+ * Purpose: Internal flash backend of the configuration store.
+ * Content:
+ * Erase, double word programming and read of the two configuration pages,
+ * the last two 2 KB pages of flash bank 2.
+ *
+ * The program runs from bank 1, so erasing and writing bank 2 does not
+ * stall the instruction fetches (read-while-write). The linker script
+ * must keep the two pages out of the FLASH region (LENGTH = 1020K).
+ * A reset or power loss while a double word is programmed leaves its ECC
+ * wrong, and reading it raises an NMI (two bit error, FLASH_ECCR ECCD)
+ * instead of returning bad data. CONFIG_FlashNMI() clears it when a slot
+ * read was in progress and the read fails, so the store falls back to the
+ * other slot instead of the default handler looping until the watchdog
+ * resets the board, at every boot.
+ */
+
+#include "config_store.h"
+#include <string.h>
+
+#define SLOT_PAGE(slot)		(FLASH_BANK_SIZE / FLASH_PAGE_SIZE - CONFIG_SLOTS + (slot))
+#define SLOT_ADDRESS(slot)	(FLASH_BASE + FLASH_BANK_SIZE + SLOT_PAGE(slot) * FLASH_PAGE_SIZE)
+
+static volatile uint8_t reading;		// flash_read() copying a slot
+static volatile uint8_t ecc_error;		// two bit ECC error during that copy
+
+static int flash_erase(int slot) {
+	FLASH_EraseInitTypeDef erase = {
+		.TypeErase = FLASH_TYPEERASE_PAGES,
+		.Banks = FLASH_BANK_2,
+		.Page = SLOT_PAGE(slot),
+		.NbPages = 1,
+	};
+	uint32_t page_error;
+	HAL_StatusTypeDef status;
+
+	HAL_FLASH_Unlock();
+	__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+	status = HAL_FLASHEx_Erase(&erase, &page_error);
+	HAL_FLASH_Lock();
+	return status == HAL_OK ? SUCCESS : FAILURE;
+}
+
+static int flash_write(int slot, uint32_t offset, const void *data, uint32_t size) {
+	uint32_t address = SLOT_ADDRESS(slot) + offset;
+	const uint8_t *p = data;
+	HAL_StatusTypeDef status = HAL_OK;
+
+	if ((offset | size) & 7 || offset + size > FLASH_PAGE_SIZE) {
+		return FAILURE;
+	}
+
+	HAL_FLASH_Unlock();
+	__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+	for (uint32_t i = 0; i < size && status == HAL_OK; i += 8) {
+		uint64_t word;
+		memcpy(&word, p + i, sizeof(word));
+		status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, address + i, word);
+	}
+	HAL_FLASH_Lock();
+	return status == HAL_OK ? SUCCESS : FAILURE;
+}
+
+static int flash_read(int slot, uint32_t offset, void *data, uint32_t size) {
+	if (offset + size > FLASH_PAGE_SIZE) {
+		return FAILURE;
+	}
+	ecc_error = 0;
+	reading = 1;
+	memcpy(data, (const void *)(SLOT_ADDRESS(slot) + offset), size);
+	reading = 0;
+	return ecc_error ? FAILURE : SUCCESS;
+}
+
+int CONFIG_FlashNMI(void) {
+	if (!reading || !__HAL_FLASH_GET_FLAG(FLASH_FLAG_ECCD)) {
+		return FAILURE;
+	}
+	__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ECCD);
+	ecc_error = 1;
+	return SUCCESS;
+}
+
+const config_flash config_flash_internal = {
+	.slot_size = FLASH_PAGE_SIZE,
+	.erase = flash_erase,
+	.write = flash_write,
+	.read = flash_read,
+};
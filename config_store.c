@@ -0,0 +1,176 @@
+/*
+ * config_store.c
+ *
+ * Purpose: Keep the runtime configuration across resets.
+ * Content:
+ * Versioned, CRC protected binary configuration in two flash slots (A/B).
+ * Boot load with validation and fallback to the sensors_init() defaults.
+ * Save to the older slot, so the last good configuration survives a
+ * reset or power loss in the middle of a write.
+ *
+ * The stored blob is the in-memory config_data itself: loading is a read,
+ * a CRC and a copy, nothing is parsed or recomputed at boot. A slot is
+ * used only if its magic, version, size and CRC match and its values pass
+ * SENSOR_CheckConfig() and the scheme and output mode ranges; of two valid slots the one with the higher
+ * sequence number wins. A save erases and writes the other slot, the
+ * previous configuration stays intact until the new one is complete.
+ * The flash is reached through a config_flash, so the store runs on a
+ * host against a RAM or file stand-in.
+ */
+
+#include "config_store.h"
+#include "scheduler.h"
+#include <stddef.h>
+#include <string.h>
+
+#if CONFIG_ENABLE
+
+static const config_flash *store_flash;
+static int current_slot;		// slot of the newest valid blob, -1: none
+static uint32_t sequence;
+static volatile int dirty;
+
+// blob + padding to the 8 byte write granularity
+static union {
+	config_blob blob;
+	uint64_t words[(sizeof(config_blob) + 7) / 8];
+} buffer;
+
+/* CRC-32 (IEEE 802.3, reflected), 4 bits at a time: 64 bytes of table */
+uint32_t CONFIG_Crc32(const void *data, uint32_t size, uint32_t crc) {
+	static const uint32_t table[16] = {
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+	};
+	const uint8_t *p = data;
+
+	crc = ~crc;
+	while (size--) {
+		crc = (crc >> 4) ^ table[(crc ^ *p) & 0x0F];
+		crc = (crc >> 4) ^ table[(crc ^ (*p >> 4)) & 0x0F];
+		p++;
+	}
+	return ~crc;
+}
+
+static uint32_t blob_crc(const config_blob *blob) {
+	uint32_t crc = CONFIG_Crc32(blob, offsetof(config_blob, crc), 0);
+	return CONFIG_Crc32(&blob->data, sizeof(blob->data), crc);
+}
+
+/* Read and validate a slot into buffer, SUCCESS if it holds a usable configuration */
+static int read_slot(int slot) {
+	config_blob *blob = &buffer.blob;
+
+	if (store_flash->read(slot, 0, blob, sizeof(*blob)) != SUCCESS) {
+		return FAILURE;
+	}
+	if (blob->magic != CONFIG_MAGIC || blob->version != CONFIG_VERSION
+			|| blob->size != sizeof(config_data) || blob->crc != blob_crc(blob)) {
+		return FAILURE;
+	}
+	for (int i = 0; i < SENSOR_COUNT; i++) {
+		if (SENSOR_CheckConfig(&blob->data.ctrl[i]) != NULL
+				|| blob->data.output_mode[i] < 0 || blob->data.output_mode[i] >= OUTPUT_MODES) {
+			return FAILURE;
+		}
+	}
+	return blob->data.scheme >= 0 && blob->data.scheme < SCHEDULER_SCHEMES ? SUCCESS : FAILURE;
+}
+
+void CONFIG_Init(const config_flash *flash) {
+	store_flash = flash;
+	current_slot = -1;
+	sequence = 0;
+	dirty = 0;
+}
+
+/* Apply the newest valid stored configuration over the defaults of
+ * sensors_init(), before the tasks start. FAILURE: nothing stored or
+ * nothing valid, the defaults stay.
+ * */
+int CONFIG_Load(void) {
+	int best = -1;
+	uint32_t best_sequence = 0;
+
+	if (store_flash == NULL || sizeof(config_blob) > store_flash->slot_size) {
+		return FAILURE;
+	}
+
+	for (int slot = 0; slot < CONFIG_SLOTS; slot++) {
+		if (read_slot(slot) != SUCCESS) {
+			continue;
+		}
+		// wrap-safe: newer if ahead by less than half the range
+		if (best < 0 || (int32_t)(buffer.blob.sequence - best_sequence) > 0) {
+			best = slot;
+			best_sequence = buffer.blob.sequence;
+		}
+	}
+	if (best < 0 || read_slot(best) != SUCCESS) {
+		return FAILURE;
+	}
+
+	const config_data *data = &buffer.blob.data;
+	for (int i = 0; i < SENSOR_COUNT; i++) {
+		SENSOR_Configure(i, &data->ctrl[i]);
+		output_mode[i] = data->output_mode[i];
+	}
+	scheduler_scheme = data->scheme;
+
+	current_slot = best;
+	sequence = best_sequence;
+	return SUCCESS;
+}
+
+/* Write the running configuration to the slot not holding the newest one */
+int CONFIG_Save(void) {
+	config_blob *blob = &buffer.blob;
+	int slot = current_slot < 0 ? 0 : (current_slot + 1) % CONFIG_SLOTS;
+
+	if (store_flash == NULL || sizeof(config_blob) > store_flash->slot_size) {
+		return FAILURE;
+	}
+	// a change from here on is not in this copy and sets it again
+	dirty = 0;
+
+	memset(&buffer, 0xFF, sizeof(buffer));
+	memset(blob, 0, sizeof(*blob));
+	for (int i = 0; i < SENSOR_COUNT; i++) {
+		SENSOR_GetConfig(i, &blob->data.ctrl[i]);
+		blob->data.output_mode[i] = output_mode[i];
+	}
+	blob->data.scheme = scheduler_scheme;
+	blob->magic = CONFIG_MAGIC;
+	blob->version = CONFIG_VERSION;
+	blob->size = sizeof(config_data);
+	blob->sequence = sequence + 1;
+	blob->crc = blob_crc(blob);
+
+	if (store_flash->erase(slot) != SUCCESS
+			|| store_flash->write(slot, 0, buffer.words, sizeof(buffer.words)) != SUCCESS) {
+		dirty = 1;		// still unsaved, the console tries again
+		return FAILURE;
+	}
+
+	// read back, the slot only counts once it validates
+	uint32_t crc = blob->crc;
+	if (read_slot(slot) != SUCCESS || buffer.blob.crc != crc) {
+		dirty = 1;
+		return FAILURE;
+	}
+	current_slot = slot;
+	sequence++;
+	return SUCCESS;
+}
+
+/* Called on every runtime change, the console saves once they stop (CONFIG_SAVE_DELAY_MS) */
+void CONFIG_Changed(void) {
+	dirty = 1;
+}
+
+int CONFIG_Pending(void) {
+	return dirty;
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * config_store.h
+ *
+ * Purpose: Declare the persistent configuration store.
+ * Content:
+ * Stored configuration layout and version, flash access interface
+ * (internal flash in config_flash.c, RAM or file stand-ins on a host),
+ * load/save functions.
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include "sensors.h"
+
+// set to 0 to always boot with the defaults of sensors_init()
+#ifndef CONFIG_ENABLE
+#define CONFIG_ENABLE 1
+#endif
+
+#define CONFIG_MAGIC 0x43464731u	// "CFG1"
+
+// layout of config_data, increment on any change of it or of sensor_ctrl_data
+#define CONFIG_VERSION 1
+
+// the console saves this long after the last change, a tuning session costs one write
+#define CONFIG_SAVE_DELAY_MS 10000
+
+#define CONFIG_SLOTS 2
+
+typedef struct {
+	sensor_ctrl_data ctrl[SENSOR_COUNT];	// effective_interval is not restored
+	int32_t scheme;
+	int32_t output_mode[SENSOR_COUNT];
+} config_data;
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t size;			// sizeof(config_data)
+	uint32_t sequence;		// +1 per save, the newest valid slot is loaded
+	uint32_t crc;			// CRC-32 of the header up to here and the data
+	config_data data;
+} config_blob;
+
+/* Flash behind the store, one erasable page per slot.
+ * Writes are at offsets and sizes multiple of 8 into an erased slot.
+ * The functions return SUCCESS or FAILURE.
+ * */
+typedef struct {
+	uint32_t slot_size;
+	int (*erase)(int slot);
+	int (*write)(int slot, uint32_t offset, const void *data, uint32_t size);
+	int (*read)(int slot, uint32_t offset, void *data, uint32_t size);
+} config_flash;
+
+// last two pages of flash bank 2 (config_flash.c)
+extern const config_flash config_flash_internal;
+/* Called first in NMI_Handler() of stm32l4xx_it.c, which returns at once
+ * on SUCCESS: the NMI was the ECC error of a slot cut off while programmed
+ * */
+int CONFIG_FlashNMI(void);
+
+#if CONFIG_ENABLE
+void CONFIG_Init(const config_flash *flash);
+int CONFIG_Load(void);
+int CONFIG_Save(void);
+void CONFIG_Changed(void);
+int CONFIG_Pending(void);
+uint32_t CONFIG_Crc32(const void *data, uint32_t size, uint32_t crc);
+#else
+#define CONFIG_Init(flash) ((void)0)
+#define CONFIG_Load() (FAILURE)
+#define CONFIG_Save() (FAILURE)
+#define CONFIG_Changed() ((void)0)
+#define CONFIG_Pending() (0)
+#endif
+
+#endif
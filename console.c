@@ -0,0 +1,453 @@
+/*
+ * console.c
+ *
+ * Purpose: Change the configuration at runtime from the serial terminal.
+ * Content:
+ * USART1 reception by DMA into a circular buffer, woken on idle line.
+ * Line assembly and command parser: get/set of sensor_ctrl, scheduler
+ * scheme, output mode and on demand system monitor report.
+ *
+ * USART1 was set up TX_RX but nothing read it, so every interval or limit
+ * change was a reflash. The DMA (DMA2 channel 7, DMA1 channel 5 carries
+ * I2C2 RX) writes the received bytes into rx_buffer on its own; the UART
+ * idle line and the half/full buffer events only pass the write position
+ * to vConsoleTask, which never blocks the other tasks and takes whole
+ * lines out of the buffer. A set command checks all its values against
+ * each other first and hands a complete sensor_ctrl copy to the sensor
+ * (SENSOR_Configure), which applies it between two samples: a sample is
+ * never processed with half of the new values. Changes are written to
+ * flash (config_store.c) CONFIG_SAVE_DELAY_MS after the last one, or at
+ * once with save.
+ *
+ * 	help
+ * 	get <sensor> [field]
+ * 	set <sensor> <field> <value> [<field> <value>...]
+ * 	scheme [random|full|predictive]
+ * 	output <sensor|all> [raw|summary|sliding]
+ * 	save
+ * 	time [hh:mm:ss]		RTC time of day, the seasonal anomaly detector needs it
+ * 	alarms				conditions seen by the alarm manager (alarm_mgr.c)
+ * 	stats
+ * 	wcet				execution times for tools/schedulability.py
+ * 	trace				event trace for tools/trace2chrome.py
+ */
+
+#include "console.h"
+#include "scheduler.h"
+#include "sysmon.h"
+#include "supervisor.h"
+#include "config_store.h"
+#include "trace.h"
+#include "alarm_mgr.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#if CONSOLE_ENABLE
+
+typedef enum {
+	FIELD_INT = 0,
+	FIELD_FLOAT,
+	FIELD_READ_ONLY		// int, set by the firmware (adaptive.c)
+} field_kind;
+
+typedef struct {
+	const char *name;
+	size_t offset;
+	field_kind kind;
+} ctrl_field;
+
+static const ctrl_field fields[] = {
+	{ "interval",           offsetof(sensor_ctrl_data, interval),           FIELD_INT },
+	{ "min_interval",       offsetof(sensor_ctrl_data, min_interval),       FIELD_INT },
+	{ "max_interval",       offsetof(sensor_ctrl_data, max_interval),       FIELD_INT },
+	{ "effective_interval", offsetof(sensor_ctrl_data, effective_interval), FIELD_READ_ONLY },
+	{ "threshold_up",       offsetof(sensor_ctrl_data, threshold_up),       FIELD_FLOAT },
+	{ "threshold_down",     offsetof(sensor_ctrl_data, threshold_down),     FIELD_FLOAT },
+	{ "rate_limit",         offsetof(sensor_ctrl_data, rate_limit),         FIELD_FLOAT },
+	{ "deadband_abs",       offsetof(sensor_ctrl_data, deadband_abs),       FIELD_FLOAT },
+	{ "deadband_rel",       offsetof(sensor_ctrl_data, deadband_rel),       FIELD_FLOAT },
+	{ "max_silence",        offsetof(sensor_ctrl_data, max_silence),        FIELD_INT },
+};
+
+#define FIELD_COUNT (sizeof(fields) / sizeof(fields[0]))
+
+static const char *const scheme_name[] = { "random", "full", "predictive" };
+static const char *const output_mode_name[OUTPUT_MODES] = { "raw", "summary", "sliding" };
+
+#define MAX_TOKENS 12
+
+static UART_HandleTypeDef *const console_uart = &huart1;
+static DMA_HandleTypeDef hdma_console_rx;
+static uint8_t rx_buffer[CONSOLE_RX_SIZE];
+static TaskHandle_t console_task;
+static volatile uint8_t restarted;		// the DMA started over at rx_buffer[0]
+
+/* Receive into rx_buffer until stopped, the DMA wraps around by itself */
+static int start_reception(void) {
+	return HAL_UARTEx_ReceiveToIdle_DMA(console_uart, rx_buffer, CONSOLE_RX_SIZE) == HAL_OK ? SUCCESS : FAILURE;
+}
+
+/* USART1 is already initialised by main.c, only the RX DMA is added */
+int CONSOLE_Init(void) {
+	// USART1_RX: DMA2 channel 7, request 2
+	__HAL_RCC_DMA2_CLK_ENABLE();
+	hdma_console_rx.Instance = DMA2_Channel7;
+	hdma_console_rx.Init.Request = DMA_REQUEST_2;
+	hdma_console_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	hdma_console_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma_console_rx.Init.MemInc = DMA_MINC_ENABLE;
+	hdma_console_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_console_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	hdma_console_rx.Init.Mode = DMA_CIRCULAR;
+	hdma_console_rx.Init.Priority = DMA_PRIORITY_LOW;
+	if (HAL_DMA_Init(&hdma_console_rx) != HAL_OK) {
+		return FAILURE;
+	}
+	__HAL_LINKDMA(console_uart, hdmarx, hdma_console_rx);
+
+	// must not be above configMAX_SYSCALL_INTERRUPT_PRIORITY, the callback uses the FreeRTOS API
+	HAL_NVIC_SetPriority(DMA2_Channel7_IRQn, 7, 0);
+	HAL_NVIC_EnableIRQ(DMA2_Channel7_IRQn);
+	HAL_NVIC_SetPriority(USART1_IRQn, 7, 0);
+	HAL_NVIC_EnableIRQ(USART1_IRQn);
+
+	return start_reception();
+}
+
+/* Idle line, half and full buffer: Size is the DMA write position */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size) {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if (huart == console_uart && console_task != NULL) {
+		xTaskNotifyFromISR(console_task, Size, eSetValueWithOverwrite, &xHigherPriorityTaskWoken);
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/* Noise, framing or overrun error: the HAL stopped the reception, which
+ * starts over at the beginning of rx_buffer; the task drops what it had
+ * read up to there instead of walking through the old bytes again
+ * */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if (huart == console_uart) {
+		restarted = 1;
+		start_reception();
+		if (console_task != NULL) {
+			xTaskNotifyFromISR(console_task, 0, eSetValueWithOverwrite, &xHigherPriorityTaskWoken);
+		}
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/* Called by USART1_IRQHandler() in stm32l4xx_it.c (console.h) */
+void CONSOLE_IRQHandler(void) {
+	HAL_UART_IRQHandler(console_uart);
+}
+
+/* Called by DMA2_Channel7_IRQHandler() in stm32l4xx_it.c */
+void CONSOLE_DMA_IRQHandler(void) {
+	HAL_DMA_IRQHandler(&hdma_console_rx);
+}
+
+/***********************************************
+ * Command parser
+ ***********************************************/
+static void reply(const char *format, ...) {
+	char message[MAX_MESSAGE_LENGTH];
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+	send_uart_message(message);
+}
+
+static int find_sensor(const char *name) {
+	for (int i = 0; i < SENSOR_COUNT; i++) {
+		if (strcasecmp(name, sensor_name[i]) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static const ctrl_field *find_field(const char *name) {
+	for (uint32_t i = 0; i < FIELD_COUNT; i++) {
+		if (strcasecmp(name, fields[i].name) == 0) {
+			return &fields[i];
+		}
+	}
+	return NULL;
+}
+
+static void print_field(int sensor, const ctrl_field *f) {
+	const char *base = (const char *)sensor_ctrl[sensor];
+
+	if (f->kind == FIELD_FLOAT) {
+		reply("%s %s %.4g\r\n", sensor_name[sensor], f->name, *(const float *)(base + f->offset));
+	}else{
+		reply("%s %s %d\r\n", sensor_name[sensor], f->name, *(const int *)(base + f->offset));
+	}
+}
+
+/* Parse text into the field of ctrl, SUCCESS if it is a number (that fits an int) */
+static int parse_field(sensor_ctrl_data *ctrl, const ctrl_field *f, const char *text) {
+	char *base = (char *)ctrl;
+	char *end;
+
+	if (f->kind == FIELD_FLOAT) {
+		float value = strtof(text, &end);
+		if (end == text || *end != '\0') {
+			return FAILURE;
+		}
+		*(float *)(base + f->offset) = value;
+	}else{
+		long value;
+
+		errno = 0;
+		value = strtol(text, &end, 10);
+		if (end == text || *end != '\0' || errno == ERANGE || value < INT_MIN || value > INT_MAX) {
+			return FAILURE;
+		}
+		*(int *)(base + f->offset) = (int)value;
+	}
+	return SUCCESS;
+}
+
+static void cmd_get(int argc, char **argv) {
+	int sensor = argc > 1 ? find_sensor(argv[1]) : -1;
+
+	if (sensor < 0) {
+		reply("ERR get <sensor> [field]\r\n");
+		return;
+	}
+	if (argc > 2) {
+		const ctrl_field *f = find_field(argv[2]);
+		if (f == NULL) {
+			reply("ERR unknown field %s\r\n", argv[2]);
+			return;
+		}
+		print_field(sensor, f);
+		return;
+	}
+	for (uint32_t i = 0; i < FIELD_COUNT; i++) {
+		print_field(sensor, &fields[i]);
+	}
+}
+
+static void cmd_set(int argc, char **argv) {
+	int sensor = argc > 1 ? find_sensor(argv[1]) : -1;
+	sensor_ctrl_data ctrl;
+	const char *error;
+
+	if (sensor < 0 || argc < 4 || argc % 2 != 0) {
+		reply("ERR set <sensor> <field> <value> [<field> <value>...]\r\n");
+		return;
+	}
+
+	SENSOR_GetConfig(sensor, &ctrl);
+	for (int i = 2; i < argc; i += 2) {
+		const ctrl_field *f = find_field(argv[i]);
+		if (f == NULL || f->kind == FIELD_READ_ONLY) {
+			reply("ERR cannot set %s\r\n", argv[i]);
+			return;
+		}
+		if (parse_field(&ctrl, f, argv[i + 1]) != SUCCESS) {
+			reply("ERR %s is not a number\r\n", argv[i + 1]);
+			return;
+		}
+	}
+	error = SENSOR_CheckConfig(&ctrl);
+	if (error != NULL) {
+		reply("ERR %s\r\n", error);
+		return;
+	}
+
+	SENSOR_Configure(sensor, &ctrl);
+	CONFIG_Changed();
+	reply("OK %s, applied before its next sample\r\n", sensor_name[sensor]);
+}
+
+static void cmd_scheme(int argc, char **argv) {
+	if (argc > 1) {
+		int scheme = -1;
+		for (int i = 0; i < (int)(sizeof(scheme_name) / sizeof(scheme_name[0])); i++) {
+			if (strcasecmp(argv[1], scheme_name[i]) == 0) {
+				scheme = i;
+			}
+		}
+		if (scheme < 0) {
+			reply("ERR scheme random|full|predictive\r\n");
+			return;
+		}
+		scheduler_scheme = scheme;
+		CONFIG_Changed();
+	}
+	reply("scheme %s\r\n", scheme_name[scheduler_scheme]);
+}
+
+static void cmd_output(int argc, char **argv) {
+	int first = 0, last = SENSOR_COUNT - 1;
+
+	if (argc < 2) {
+		reply("ERR output <sensor|all> [raw|summary|sliding]\r\n");
+		return;
+	}
+	if (strcasecmp(argv[1], "all") != 0) {
+		first = last = find_sensor(argv[1]);
+		if (first < 0) {
+			reply("ERR unknown sensor %s\r\n", argv[1]);
+			return;
+		}
+	}
+	if (argc > 2) {
+		int mode;
+		if (strcasecmp(argv[2], "raw") == 0) {
+			mode = OUTPUT_RAW;
+		}else if (strcasecmp(argv[2], "summary") == 0) {
+			mode = OUTPUT_SUMMARY;
+		}else if (strcasecmp(argv[2], "sliding") == 0) {
+			mode = OUTPUT_SLIDING;
+		}else{
+			reply("ERR output mode raw|summary|sliding\r\n");
+			return;
+		}
+		for (int i = first; i <= last; i++) {
+			output_mode[i] = mode;
+		}
+		CONFIG_Changed();
+	}
+	for (int i = first; i <= last; i++) {
+		reply("%s output %s\r\n", sensor_name[i], output_mode_name[output_mode[i]]);
+	}
+}
+
+static void cmd_time(int argc, char **argv) {
+	RTC_TimeTypeDef time;
+	RTC_DateTypeDef date;
+	int hours, minutes, seconds;
+	char end;
+
+	if (argc > 1) {
+		if (sscanf(argv[1], "%d:%d:%d%c", &hours, &minutes, &seconds, &end) != 3
+				|| rtc_set_time(hours, minutes, seconds) != SUCCESS) {
+			reply("ERR time hh:mm:ss\r\n");
+			return;
+		}
+	}
+	HAL_RTC_GetTime(&hrtc, &time, RTC_FORMAT_BIN);
+	HAL_RTC_GetDate(&hrtc, &date, RTC_FORMAT_BIN);
+	reply("time %02d:%02d:%02d%s\r\n", time.Hours, time.Minutes, time.Seconds,
+			rtc_time_valid() ? "" : " since power-up, not set");
+}
+
+/* One line per condition, copied entry by entry (ALARM_Export) */
+static void cmd_alarms(void) {
+	alarm_entry e;
+	int n = 0;
+
+	for (int i = 0; i < ALARM_ENTRIES; i++) {
+		if (ALARM_Export(i, &e) != SUCCESS) {
+			continue;
+		}
+		reply("%s %s %s raised %lu x%lu\r\n", sensor_name[e.sensor], e.what,
+				e.active ? "active" : "clear", (unsigned long)e.raised, (unsigned long)e.suppressed);
+		n++;
+	}
+	reply("alarms %d of %d conditions\r\n", n, ALARM_ENTRIES);
+}
+
+static void execute(char *line) {
+	char *argv[MAX_TOKENS];
+	char *rest;
+	int argc = 0;
+
+	for (char *token = strtok_r(line, " \t", &rest); token != NULL && argc < MAX_TOKENS; token = strtok_r(NULL, " \t", &rest)) {
+		argv[argc++] = token;
+	}
+	if (argc == 0) {
+		return;
+	}
+
+	if (strcasecmp(argv[0], "get") == 0) {
+		cmd_get(argc, argv);
+	}else if (strcasecmp(argv[0], "set") == 0) {
+		cmd_set(argc, argv);
+	}else if (strcasecmp(argv[0], "scheme") == 0) {
+		cmd_scheme(argc, argv);
+	}else if (strcasecmp(argv[0], "output") == 0) {
+		cmd_output(argc, argv);
+	}else if (strcasecmp(argv[0], "save") == 0) {
+		reply(CONFIG_Save() == SUCCESS ? "OK saved\r\n" : "ERR flash write failed\r\n");
+	}else if (strcasecmp(argv[0], "time") == 0) {
+		cmd_time(argc, argv);
+	}else if (strcasecmp(argv[0], "alarms") == 0) {
+		cmd_alarms();
+	}else if (strcasecmp(argv[0], "stats") == 0) {
+		SYSMON_Request();
+		reply("OK\r\n");
+	}else if (strcasecmp(argv[0], "wcet") == 0) {
+		SUPERVISOR_Dump();
+	}else if (strcasecmp(argv[0], "trace") == 0) {
+		TRACE_Dump();
+	}else{
+		reply("get <sensor> [field] | set <sensor> <field> <value>...\r\n");
+		reply("scheme [name] | output <sensor|all> [mode] | save\r\n");
+		reply("time [hh:mm:ss] | alarms | stats | wcet | trace\r\n");
+		reply("sensors Acl Gyr Mag Temp Humid Press\r\n");
+	}
+}
+
+/* Woken with the DMA write position, executes every complete line up to it */
+void vConsoleTask(void *pvParameters) {
+	char line[CONSOLE_LINE_MAX];
+	int length = 0, overflow = 0;
+	uint32_t read = 0, write;
+
+	console_task = xTaskGetCurrentTaskHandle();
+
+	for (;;) {
+		TickType_t timeout = CONFIG_Pending() ? pdMS_TO_TICKS(CONFIG_SAVE_DELAY_MS) : portMAX_DELAY;
+		if (xTaskNotifyWait(0, 0xFFFFFFFF, &write, timeout) != pdTRUE) {
+			// no input since the last change, store the configuration
+			reply(CONFIG_Save() == SUCCESS ? "Configuration saved\r\n" : "ERR configuration not saved\r\n");
+			continue;
+		}
+		write %= CONSOLE_RX_SIZE;
+		if (restarted) {
+			restarted = 0;
+			read = 0;
+			length = 0;
+			overflow = 0;
+		}
+
+		while (read != write) {
+			char c = rx_buffer[read];
+			read = (read + 1) % CONSOLE_RX_SIZE;
+
+			if (c == '\r' || c == '\n') {
+				line[length] = '\0';
+				if (overflow) {
+					reply("ERR line longer than %d\r\n", CONSOLE_LINE_MAX - 1);
+				}else{
+					execute(line);
+				}
+				length = 0;
+				overflow = 0;
+			}else if (length < CONSOLE_LINE_MAX - 1) {
+				line[length++] = c;
+			}else{
+				overflow = 1;
+			}
+		}
+	}
+}
+
+#endif
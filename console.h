@@ -0,0 +1,44 @@
+/*
+ * console.h
+ *
+ * Purpose: Declare the runtime configuration console.
+ * Content:
+ * Build options, USART1 RX set-up and the console task.
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "sensors.h"
+
+// set to 0 to leave USART1 RX unused, as before
+#ifndef CONSOLE_ENABLE
+#define CONSOLE_ENABLE 1
+#endif
+
+// DMA circular receive buffer, must hold what arrives while the task is busy
+#define CONSOLE_RX_SIZE 256
+
+// longest command line, longer lines are discarded
+#define CONSOLE_LINE_MAX 64
+
+// same priority as UART_Task, commands are not urgent
+#define CONSOLE_TASK_PRIORITY 1
+
+int CONSOLE_Init(void);
+void vConsoleTask(void *pvParameters);
+
+/* Interrupt handlers of the reception, the vectors stay in the generated
+ * stm32l4xx_it.c: call CONSOLE_IRQHandler() from USART1_IRQHandler() in
+ * place of HAL_UART_IRQHandler(&huart1), and add DMA2_Channel7_IRQHandler()
+ * calling CONSOLE_DMA_IRQHandler() (README, "Set up the project")
+ * */
+#if CONSOLE_ENABLE
+void CONSOLE_IRQHandler(void);
+void CONSOLE_DMA_IRQHandler(void);
+#else
+#define CONSOLE_IRQHandler() HAL_UART_IRQHandler(&huart1)
+#define CONSOLE_DMA_IRQHandler() ((void)0)
+#endif
+
+#endif
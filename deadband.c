@@ -0,0 +1,77 @@
+/*
+ * deadband.c
+ *
+ * Purpose: Store environmental readings only when they change.
+ * Content:
+ * Absolute and relative deadband around the last stored value,
+ * max-silence heartbeat, suppressed reading counters and report.
+ *
+ * Temperature, humidity and pressure hardly move between two samples, yet
+ * every reading went through the FIFO, the scheduler and the UART. A
+ * reading is stored when it leaves the band of the last stored value or
+ * when nothing was stored for max_silence ms; the record carries the
+ * number of readings dropped before it (Data.skipped). The host holds each
+ * value until the next record, which is within the deadband of every
+ * dropped reading. Statistics, anomaly detection, adaptive sampling and
+ * the rules still see every reading: they run before this stage.
+ */
+
+#include "deadband.h"
+#include <math.h>
+#include <string.h>
+
+typedef struct {
+	float last;				// last stored value
+	uint32_t last_us;		// TIMING_Micros() of its sample
+	uint16_t skipped;		// readings dropped since
+	uint8_t valid;
+	uint32_t stored;		// totals for the report
+	uint32_t dropped;
+} deadband_state;
+
+static deadband_state state[SENSOR_COUNT];
+
+void DEADBAND_Init(void) {
+	memset(state, 0, sizeof(state));
+}
+
+/* Band of the last stored value: the larger of the absolute and relative width */
+static float band(const sensor_ctrl_data *ctrl, float last) {
+	float rel = ctrl->deadband_rel * fabsf(last);
+	return rel > ctrl->deadband_abs ? rel : ctrl->deadband_abs;
+}
+
+int DEADBAND_Check(sensor_id sensor, float value, uint32_t t_sample, uint16_t *skipped) {
+	const sensor_ctrl_data *ctrl = sensor_ctrl[sensor];
+	deadband_state *st = &state[sensor];
+
+	if (DEADBAND_ENABLE && st->valid
+			&& fabsf(value - st->last) <= band(ctrl, st->last)
+			&& (ctrl->max_silence <= 0 || t_sample - st->last_us < (uint32_t)ctrl->max_silence * 1000)) {
+		if (st->skipped < 0xFFFF) {
+			st->skipped++;
+		}
+		st->dropped++;
+		return FAILURE;
+	}
+
+	*skipped = st->skipped;
+	st->last = value;
+	st->last_us = t_sample;
+	st->skipped = 0;
+	st->valid = 1;
+	st->stored++;
+	return SUCCESS;
+}
+
+/* Stored and received readings of the environmental sensors since start */
+void DEADBAND_Report(void) {
+	char message[MAX_MESSAGE_LENGTH];
+	const deadband_state *st = &state[SENSOR_TEMP];
+
+	snprintf(message, sizeof(message), "Deadband %s %lu/%lu %s %lu/%lu %s %lu/%lu\r\n",
+			sensor_name[SENSOR_TEMP], (unsigned long)st[0].stored, (unsigned long)(st[0].stored + st[0].dropped),
+			sensor_name[SENSOR_HUMID], (unsigned long)st[1].stored, (unsigned long)(st[1].stored + st[1].dropped),
+			sensor_name[SENSOR_PRESS], (unsigned long)st[2].stored, (unsigned long)(st[2].stored + st[2].dropped));
+	send_uart_message(message);
+}
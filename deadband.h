@@ -0,0 +1,24 @@
+/*
+ * deadband.h
+ *
+ * Purpose: Declare the report-on-change stage of the environmental sensors.
+ * Content:
+ * Build option and the functions called between processing and FIFO_Write.
+ */
+
+#ifndef DEADBAND_H
+#define DEADBAND_H
+
+#include "sensors.h"
+
+// 0 stores every reading, as before
+#ifndef DEADBAND_ENABLE
+#define DEADBAND_ENABLE 1
+#endif
+
+void DEADBAND_Init(void);
+// SUCCESS if the reading is to be stored, *skipped: readings dropped since the last stored one
+int DEADBAND_Check(sensor_id sensor, float value, uint32_t t_sample, uint16_t *skipped);
+void DEADBAND_Report(void);
+
+#endif
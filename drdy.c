@@ -0,0 +1,372 @@
+/*
+ * drdy.c
+ *
+ * Purpose: Sample the sensors when their data is ready instead of on a delay loop.
+ * Content:
+ * Data-ready output configuration of the LSM6DSL, LIS3MDL, HTS221 and LPS22HB.
+ * EXTI routing of the data-ready lines and the ISR -> task notifications.
+ * A simulated interrupt source driven by FreeRTOS timers for host builds,
+ * whose callbacks run in the timer service task and notify from there.
+ *
+ * The LSM6DSL runs continuously with pulsed data-ready on INT1, the ISR
+ * divides the pulses down to each sensor interval so the accel and gyro
+ * tasks wake exactly once per sample, locked to the sensor clock.
+ * The LIS3MDL, HTS221 and LPS22HB latch their data-ready line until read,
+ * so they run one-shot: the task starts a conversion at its exact release
+ * time and reads the result as soon as the line rises.
+ * The HTS221 line serves two tasks and only falls once both temperature
+ * and humidity are read: a task released while a conversion is running
+ * waits for that one, the edge wakes the first waiting task, which reads
+ * both outputs (sensors.c), and DRDY_HandOver() then wakes the other one
+ * with its value already read.
+ *
+ * The EXTI vectors stay in the generated stm32l4xx_it.c and call
+ * DRDY_EXTI9_5_IRQHandler() and DRDY_EXTI15_10_IRQHandler().
+ */
+
+#include "drdy.h"
+#include "imu_fifo.h"
+#include "i2c_bus.h"
+#include "filter.h"
+#include "timers.h"
+
+#define LSM6DSL_ADDR			0xD4
+#define LSM6DSL_DRDY_PULSE_CFG	0x0B
+#define LSM6DSL_INT1_CTRL		0x0D
+#define LSM6DSL_CTRL1_XL		0x10
+#define LSM6DSL_CTRL2_G			0x11
+#define LSM6DSL_DRDY_PULSED		0x80
+#define LSM6DSL_INT1_DRDY_XL_G	0x03
+#define LSM6DSL_ODR_52HZ		0x30
+#define LSM6DSL_FS_G_2000		0x0C
+
+#define LIS3MDL_ADDR			0x3C
+#define LIS3MDL_CTRL_REG3		0x22
+#define LIS3MDL_SINGLE			0x01
+
+#define HTS221_ADDR				0xBE
+#define HTS221_CTRL_REG1		0x20
+#define HTS221_CTRL_REG2		0x21
+#define HTS221_CTRL_REG3		0x22
+#define HTS221_PD_BDU_ONESHOT	0x84
+#define HTS221_ONE_SHOT			0x01
+#define HTS221_DRDY_EN			0x04
+
+#define LPS22HB_ADDR			0xBA
+#define LPS22HB_CTRL_REG1		0x10
+#define LPS22HB_CTRL_REG2		0x11
+#define LPS22HB_CTRL_REG3		0x12
+#define LPS22HB_BDU_ONESHOT		0x02
+#define LPS22HB_ADD_INC_ONE_SHOT 0x11
+#define LPS22HB_DRDY			0x04
+
+// simulated conversion times of the one-shot sensors
+#define SIM_LIS3MDL_MS			10
+#define SIM_HTS221_MS			15
+#define SIM_LPS22HB_MS			40
+
+typedef struct {
+	TaskHandle_t task;
+	volatile uint8_t armed;		// one-shot conversion requested, waiting for the line
+	volatile uint8_t delivered;	// woken by DRDY_HandOver(), the sample is already read
+	uint32_t edges;				// data-ready pulses since the last notification
+	uint32_t missed;			// waits that timed out
+} drdy_state;
+
+static const drdy_line sensor_line[SENSOR_COUNT] = {
+	DRDY_LINE_LSM6DSL,	// accel
+	DRDY_LINE_LSM6DSL,	// gyro
+	DRDY_LINE_LIS3MDL,	// mag
+	DRDY_LINE_HTS221,	// temp
+	DRDY_LINE_HTS221,	// humid
+	DRDY_LINE_LPS22HB	// press
+};
+
+static drdy_state state[SENSOR_COUNT];
+
+#if DRDY_SIMULATED
+static TimerHandle_t sim_timer[DRDY_LINE_COUNT];
+
+static uint32_t due_sensors(drdy_line line);
+
+/* Runs in the timer service task, not in an interrupt */
+static void sim_timer_callback(TimerHandle_t xTimer) {
+	uint32_t due = due_sensors((drdy_line)(uintptr_t)pvTimerGetTimerID(xTimer));
+
+	for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+		if (due & (1u << sensor)) {
+			xTaskNotifyGive(state[sensor].task);
+		}
+	}
+}
+#endif
+
+/* Start a one-shot conversion, the line rises when the result is ready */
+static void start_conversion(drdy_line line) {
+#if DRDY_SIMULATED
+	xTimerStart(sim_timer[line], 0);
+#else
+	switch (line) {
+		case DRDY_LINE_LIS3MDL:
+			I2C_BUS_Write(LIS3MDL_ADDR, LIS3MDL_CTRL_REG3, LIS3MDL_SINGLE, I2C_PRIO_NORMAL);
+			break;
+		case DRDY_LINE_HTS221:
+			I2C_BUS_Write(HTS221_ADDR, HTS221_CTRL_REG2, HTS221_ONE_SHOT, I2C_PRIO_LOW);
+			break;
+		case DRDY_LINE_LPS22HB:
+			I2C_BUS_Write(LPS22HB_ADDR, LPS22HB_CTRL_REG2, LPS22HB_ADD_INC_ONE_SHOT, I2C_PRIO_LOW);
+			break;
+		default:
+			break;
+	}
+#endif
+}
+
+#if !DRDY_SIMULATED
+static void exti_init(GPIO_TypeDef *port, uint16_t pin) {
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	GPIO_InitStruct.Pin = pin;
+	GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	HAL_GPIO_Init(port, &GPIO_InitStruct);
+}
+#endif
+
+/* Switch the sensors to data-ready operation, after sensors_init() */
+int DRDY_Init(void) {
+#if DRDY_SIMULATED
+	sim_timer[DRDY_LINE_LSM6DSL] = xTimerCreate("DRDY LSM6DSL", pdMS_TO_TICKS(1000 / DRDY_MOTION_ODR_HZ),
+			pdTRUE, (void*)DRDY_LINE_LSM6DSL, sim_timer_callback);
+	sim_timer[DRDY_LINE_LIS3MDL] = xTimerCreate("DRDY LIS3MDL", pdMS_TO_TICKS(SIM_LIS3MDL_MS),
+			pdFALSE, (void*)DRDY_LINE_LIS3MDL, sim_timer_callback);
+	sim_timer[DRDY_LINE_HTS221] = xTimerCreate("DRDY HTS221", pdMS_TO_TICKS(SIM_HTS221_MS),
+			pdFALSE, (void*)DRDY_LINE_HTS221, sim_timer_callback);
+	sim_timer[DRDY_LINE_LPS22HB] = xTimerCreate("DRDY LPS22HB", pdMS_TO_TICKS(SIM_LPS22HB_MS),
+			pdFALSE, (void*)DRDY_LINE_LPS22HB, sim_timer_callback);
+
+	for (int line = 0; line < DRDY_LINE_COUNT; line++) {
+		if (sim_timer[line] == NULL) {
+			return FAILURE;
+		}
+	}
+	xTimerStart(sim_timer[DRDY_LINE_LSM6DSL], 0);
+#else
+	// LSM6DSL: fixed ODR so the ISR can divide it, 75 us data-ready pulses on INT1
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_CTRL1_XL, LSM6DSL_ODR_52HZ);
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_CTRL2_G, LSM6DSL_ODR_52HZ | LSM6DSL_FS_G_2000);
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_DRDY_PULSE_CFG, LSM6DSL_DRDY_PULSED);
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_INT1_CTRL, LSM6DSL_INT1_DRDY_XL_G);
+
+	// HTS221 and LPS22HB: power down between one-shot conversions, DRDY output enabled
+	SENSOR_IO_Write(HTS221_ADDR, HTS221_CTRL_REG1, HTS221_PD_BDU_ONESHOT);
+	SENSOR_IO_Write(HTS221_ADDR, HTS221_CTRL_REG3, HTS221_DRDY_EN);
+	SENSOR_IO_Write(LPS22HB_ADDR, LPS22HB_CTRL_REG1, LPS22HB_BDU_ONESHOT);
+	SENSOR_IO_Write(LPS22HB_ADDR, LPS22HB_CTRL_REG3, LPS22HB_DRDY);
+
+	// LIS3MDL DRDY is always enabled, the task requests single conversions
+
+	__HAL_RCC_GPIOC_CLK_ENABLE();
+	__HAL_RCC_GPIOD_CLK_ENABLE();
+	exti_init(LSM6DSL_INT1_EXTI11_GPIO_Port, LSM6DSL_INT1_EXTI11_Pin);
+	exti_init(LSM3MDL_DRDY_EXTI8_GPIO_Port, LSM3MDL_DRDY_EXTI8_Pin);
+	exti_init(HTS221_DRDY_EXTI15_GPIO_Port, HTS221_DRDY_EXTI15_Pin);
+	exti_init(LPS22HB_INT_DRDY_EXTI0_GPIO_Port, LPS22HB_INT_DRDY_EXTI0_Pin);
+
+	// must not be above configMAX_SYSCALL_INTERRUPT_PRIORITY, the ISRs use the FreeRTOS API
+	HAL_NVIC_SetPriority(EXTI15_10_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+	HAL_NVIC_SetPriority(EXTI9_5_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(EXTI9_5_IRQn);
+#endif
+
+	return SUCCESS;
+}
+
+/* Register the calling task as the consumer of the sensor's data-ready events */
+void DRDY_Attach(sensor_id sensor) {
+	state[sensor].task = xTaskGetCurrentTaskHandle();
+}
+
+/* Another task waits for a conversion of the line, call with interrupts masked */
+static int line_armed(drdy_line line) {
+	for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+		if (sensor_line[sensor] == line && state[sensor].armed) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Block until the next sample of the sensor is ready.
+ * One-shot sensors are released at exact multiples of their interval,
+ * returns FAILURE if the line did not rise within two intervals.
+ * */
+int DRDY_Wait(sensor_id sensor, TickType_t *xLastWakeTime) {
+	drdy_state *st = &state[sensor];
+	drdy_line line = sensor_line[sensor];
+	TickType_t timeout = pdMS_TO_TICKS(2 * SENSOR_ReadInterval(sensor));
+
+	if (line != DRDY_LINE_LSM6DSL) {
+		vTaskDelayUntil(xLastWakeTime, pdMS_TO_TICKS(SENSOR_ReadInterval(sensor)));
+
+		// a wake-up that came after the last timeout is not this conversion
+		ulTaskNotifyTake(pdTRUE, 0);
+
+		// a conversion started for the other task of the line serves this one too
+		taskENTER_CRITICAL();
+		int running = line_armed(line);
+		st->armed = 1;
+		st->delivered = 0;
+		taskEXIT_CRITICAL();
+		if (!running) {
+			start_conversion(line);
+		}
+	}
+
+	if (ulTaskNotifyTake(pdTRUE, timeout) == 0) {
+		taskENTER_CRITICAL();
+		st->armed = 0;
+		taskEXIT_CRITICAL();
+		st->missed++;
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+/* Whether the sample of the sensor was already read by the other task of
+ * its line (DRDY_HandOver()), in which case the caller must not read it.
+ * Clears the indication.
+ * */
+int DRDY_Delivered(sensor_id sensor) {
+	int delivered;
+
+	taskENTER_CRITICAL();
+	delivered = state[sensor].delivered;
+	state[sensor].delivered = 0;
+	taskEXIT_CRITICAL();
+	return delivered;
+}
+
+/* The caller has read all outputs behind the line of its sensor: wake the
+ * other tasks waiting on that conversion, their samples are read as well
+ * */
+void DRDY_HandOver(sensor_id sensor) {
+	drdy_line line = sensor_line[sensor];
+
+	if (line == DRDY_LINE_LSM6DSL) {
+		return;
+	}
+	for (int other = 0; other < SENSOR_COUNT; other++) {
+		drdy_state *st = &state[other];
+		int wake = 0;
+
+		taskENTER_CRITICAL();
+		if (other != sensor && sensor_line[other] == line && st->armed) {
+			st->armed = 0;
+			st->delivered = 1;
+			wake = 1;
+		}
+		taskEXIT_CRITICAL();
+		if (wake) {
+			xTaskNotifyGive(st->task);
+		}
+	}
+}
+
+uint32_t DRDY_Missed(sensor_id sensor) {
+	return state[sensor].missed;
+}
+
+/* Waits that timed out since start-up, one line for the periodic report */
+void DRDY_Report(void) {
+	char message[MAX_MESSAGE_LENGTH];
+
+	snprintf(message, sizeof(message), "DRDY missed Acl %lu Gyr %lu Mag %lu Temp %lu Hum %lu Prs %lu\r\n",
+			(unsigned long)state[SENSOR_ACCEL].missed, (unsigned long)state[SENSOR_GYRO].missed,
+			(unsigned long)state[SENSOR_MAG].missed, (unsigned long)state[SENSOR_TEMP].missed,
+			(unsigned long)state[SENSOR_HUMID].missed, (unsigned long)state[SENSOR_PRESS].missed);
+	send_uart_message(message);
+}
+
+/* Bit mask of the sensors whose sample is ready after an edge of the line */
+static uint32_t due_sensors(drdy_line line) {
+	uint32_t due = 0;
+
+	for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+		drdy_state *st = &state[sensor];
+
+		if (sensor_line[sensor] != line || st->task == NULL) {
+			continue;
+		}
+
+		if (line == DRDY_LINE_LSM6DSL) {
+			// divide the ODR down to the interval without a division in the ISR
+			st->edges++;
+			if (st->edges * 1000 * FILTER_Ratio(sensor) < (uint32_t)sensor_ctrl[sensor]->effective_interval * DRDY_MOTION_ODR_HZ) {
+				continue;
+			}
+			st->edges = 0;
+		}else if (!st->armed) {
+			continue;
+		}else if (due) {
+			// one task reads the outputs and hands the conversion over
+			continue;
+		}
+
+		st->armed = 0;
+		due |= 1u << sensor;
+	}
+	return due;
+}
+
+/* A data-ready line rose: called from the EXTI callback */
+void DRDY_LineEvent(drdy_line line, BaseType_t *pxHigherPriorityTaskWoken) {
+	uint32_t due = due_sensors(line);
+
+	for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+		if (due & (1u << sensor)) {
+			vTaskNotifyGiveFromISR(state[sensor].task, pxHigherPriorityTaskWoken);
+		}
+	}
+}
+
+#if ACQ_MODE != ACQ_MODE_POLL && !DRDY_SIMULATED
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	switch (GPIO_Pin) {
+		case LSM6DSL_INT1_EXTI11_Pin:
+#if ACQ_MODE == ACQ_MODE_HWFIFO
+			IMU_FIFO_IRQHandler(&xHigherPriorityTaskWoken);
+#else
+			DRDY_LineEvent(DRDY_LINE_LSM6DSL, &xHigherPriorityTaskWoken);
+#endif
+			break;
+		case LSM3MDL_DRDY_EXTI8_Pin:
+			DRDY_LineEvent(DRDY_LINE_LIS3MDL, &xHigherPriorityTaskWoken);
+			break;
+		case HTS221_DRDY_EXTI15_Pin:
+			DRDY_LineEvent(DRDY_LINE_HTS221, &xHigherPriorityTaskWoken);
+			break;
+		case LPS22HB_INT_DRDY_EXTI0_Pin:
+			DRDY_LineEvent(DRDY_LINE_LPS22HB, &xHigherPriorityTaskWoken);
+			break;
+		default:
+			break;
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/* Called by EXTI15_10_IRQHandler() in stm32l4xx_it.c (drdy.h) */
+void DRDY_EXTI15_10_IRQHandler(void) {
+	HAL_GPIO_EXTI_IRQHandler(LPS22HB_INT_DRDY_EXTI0_Pin);
+	HAL_GPIO_EXTI_IRQHandler(LSM6DSL_INT1_EXTI11_Pin);
+	HAL_GPIO_EXTI_IRQHandler(HTS221_DRDY_EXTI15_Pin);
+}
+
+/* Called by EXTI9_5_IRQHandler() in stm32l4xx_it.c */
+void DRDY_EXTI9_5_IRQHandler(void) {
+	HAL_GPIO_EXTI_IRQHandler(LSM3MDL_DRDY_EXTI8_Pin);
+}
+#endif
@@ -0,0 +1,53 @@
+/*
+ * drdy.h
+ *
+ * Purpose: Declare the interrupt driven (data-ready) acquisition.
+ * Content:
+ * Data-ready line definitions, wait/attach functions for the sensor tasks
+ * and the line event entry point shared by the EXTI ISRs and the simulator.
+ */
+
+#ifndef DRDY_H
+#define DRDY_H
+
+#include "sensors.h"
+
+// 1: data-ready edges come from FreeRTOS timers instead of EXTI (Linux host)
+#ifndef DRDY_SIMULATED
+#define DRDY_SIMULATED 0
+#endif
+
+// LSM6DSL accelerometer and gyroscope ODR while in data-ready mode
+#define DRDY_MOTION_ODR_HZ 52
+
+typedef enum {
+	DRDY_LINE_LSM6DSL = 0,	// INT1, PD11, accel+gyro data ready (pulsed, free running)
+	DRDY_LINE_LIS3MDL,		// DRDY, PC8, single conversion
+	DRDY_LINE_HTS221,		// DRDY, PD15, one-shot (temperature and humidity)
+	DRDY_LINE_LPS22HB,		// INT_DRDY, PD10, one-shot
+	DRDY_LINE_COUNT
+} drdy_line;
+
+int DRDY_Init(void);
+void DRDY_Attach(sensor_id sensor);
+int DRDY_Wait(sensor_id sensor, TickType_t *xLastWakeTime);
+uint32_t DRDY_Missed(sensor_id sensor);
+void DRDY_Report(void);
+int DRDY_Delivered(sensor_id sensor);
+void DRDY_HandOver(sensor_id sensor);
+void DRDY_LineEvent(drdy_line line, BaseType_t *pxHigherPriorityTaskWoken);
+
+/* Interrupt handlers of the data-ready lines, the vectors stay in the
+ * generated stm32l4xx_it.c: add EXTI9_5_IRQHandler() calling
+ * DRDY_EXTI9_5_IRQHandler() and EXTI15_10_IRQHandler() calling
+ * DRDY_EXTI15_10_IRQHandler() (README, "Set up the project")
+ * */
+#if ACQ_MODE != ACQ_MODE_POLL && !DRDY_SIMULATED
+void DRDY_EXTI15_10_IRQHandler(void);
+void DRDY_EXTI9_5_IRQHandler(void);
+#else
+#define DRDY_EXTI15_10_IRQHandler() ((void)0)
+#define DRDY_EXTI9_5_IRQHandler() ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * dsp_kernels.c
+ *
+ * Purpose: Single precision and fixed point kernels for the sample path.
+ * Content:
+ * Raw int16 to float conversion, squared magnitudes, norms and the
+ * sqrt free band test, with CMSIS-DSP / Cortex-M4 SIMD versions and
+ * portable C fallbacks.
+ * Cycle per sample benchmark against the former double precision path.
+ *
+ * The Cortex-M4F FPU is single precision only: a double literal such as
+ * 9.8 or a call to sqrt() makes the whole expression software emulated.
+ * Everything here stays in float or integer, and thresholds are compared
+ * on squared magnitudes so no square root is needed per sample.
+ */
+
+#include "dsp_kernels.h"
+#include "timing.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if DSP_USE_CMSIS
+#include "arm_math.h"
+#endif
+
+void DSP_Convert_i16(const int16_t *raw, float *out, uint32_t n, float scale) {
+#if DSP_USE_CMSIS
+	// q15 -> float divides by 32768, folded into the scale
+	arm_q15_to_float((q15_t*)raw, out, n);
+	arm_scale_f32(out, scale * 32768.0f, out, n);
+#else
+	for (uint32_t i = 0; i < n; i++) {
+		out[i] = raw[i] * scale;
+	}
+#endif
+}
+
+void DSP_Scale_f32(const float *in, float *out, uint32_t n, float scale) {
+#if DSP_USE_CMSIS
+	arm_scale_f32((float32_t*)in, scale, out, n);
+#else
+	for (uint32_t i = 0; i < n; i++) {
+		out[i] = in[i] * scale;
+	}
+#endif
+}
+
+float DSP_MagSq_f32(const float *xyz) {
+	return xyz[0] * xyz[0] + xyz[1] * xyz[1] + xyz[2] * xyz[2];
+}
+
+uint32_t DSP_MagSq_i16(const int16_t *xyz) {
+#if defined(__ARM_FEATURE_DSP)
+	// x*x + y*y in one dual 16 bit multiply-accumulate, 64 bit so -32768 cannot overflow
+	uint32_t xy;
+	memcpy(&xy, xyz, sizeof(xy));
+	return (uint32_t)__SMLALD(xy, xy, (int32_t)xyz[2] * xyz[2]);
+#else
+	return (uint32_t)((int32_t)xyz[0] * xyz[0]) + (uint32_t)((int32_t)xyz[1] * xyz[1])
+			+ (uint32_t)((int32_t)xyz[2] * xyz[2]);
+#endif
+}
+
+void DSP_MagSqBatch_f32(const float *xyz, float *out, uint32_t n) {
+	for (uint32_t i = 0; i < n; i++, xyz += 3) {
+		out[i] = xyz[0] * xyz[0] + xyz[1] * xyz[1] + xyz[2] * xyz[2];
+	}
+}
+
+void DSP_MagSqBatch_i16(const int16_t *xyz, uint32_t *out, uint32_t n) {
+	for (uint32_t i = 0; i < n; i++, xyz += 3) {
+		out[i] = DSP_MagSq_i16(xyz);
+	}
+}
+
+float DSP_Norm_f32(const float *xyz) {
+#if DSP_USE_CMSIS
+	float32_t norm;
+	arm_sqrt_f32(DSP_MagSq_f32(xyz), &norm);
+	return norm;
+#else
+	return sqrtf(DSP_MagSq_f32(xyz));
+#endif
+}
+
+int DSP_OutsideBand(float mag_sq, float low, float high) {
+	// a magnitude is never negative: a negative high is always exceeded, a negative low never undercut
+	if (high < 0 || mag_sq > high * high) {
+		return 1;
+	}
+	return low > 0 && mag_sq < low * low;
+}
+
+#if DSP_BENCHMARK
+/***********************************************
+ * Benchmark: cycles per 3 axis sample of
+ * 	conversion + threshold test, per variant
+ ***********************************************/
+static int16_t bench_raw[3 * DSP_BENCH_SAMPLES];
+static float bench_xyz[3 * DSP_BENCH_SAMPLES];
+static float bench_mag_sq[DSP_BENCH_SAMPLES];
+static uint32_t bench_mag_sq_i16[DSP_BENCH_SAMPLES];
+static volatile int bench_sink;
+
+static void bench_report(const char *name, uint32_t cycles) {
+	char message[MAX_MESSAGE_LENGTH];
+	uint32_t per_sample = cycles * 100 / DSP_BENCH_SAMPLES;
+
+	snprintf(message, sizeof(message), "DSP %-6s %lu.%02lu cyc/smp\r\n", name, per_sample / 100, per_sample % 100);
+	send_uart_message(message);
+}
+
+void DSP_Benchmark(void) {
+	const float scale = 9.8f / 1000.0f;
+	const float high = 11.0f;
+	uint32_t start, raw_high_sq;
+	int alarms;
+
+	for (int i = 0; i < 3 * DSP_BENCH_SAMPLES; i++) {
+		bench_raw[i] = (int16_t)(((i * 7919) & 0x7FFF) - 0x4000);
+	}
+
+	send_uart_message(DSP_USE_CMSIS ? "DSP kernels: CMSIS-DSP\r\n" : "DSP kernels: portable C\r\n");
+
+	// former sensor task code: double conversion and sqrt()
+	alarms = 0;
+	start = TIMING_Cycles();
+	for (int i = 0; i < DSP_BENCH_SAMPLES; i++) {
+		double x = (float)bench_raw[3 * i] * 9.8 / 1000.0f;
+		double y = (float)bench_raw[3 * i + 1] * 9.8 / 1000.0f;
+		double z = (float)bench_raw[3 * i + 2] * 9.8 / 1000.0f;
+		alarms += sqrt(x * x + y * y + z * z) > high;
+	}
+	bench_report("double", TIMING_Cycles() - start);
+	bench_sink = alarms;
+
+	// single precision, still with a square root per sample
+	alarms = 0;
+	start = TIMING_Cycles();
+	for (int i = 0; i < DSP_BENCH_SAMPLES; i++) {
+		float xyz[3] = { bench_raw[3 * i] * scale, bench_raw[3 * i + 1] * scale, bench_raw[3 * i + 2] * scale };
+		alarms += sqrtf(DSP_MagSq_f32(xyz)) > high;
+	}
+	bench_report("float", TIMING_Cycles() - start);
+	bench_sink = alarms;
+
+	// batch kernels, squared magnitude test
+	alarms = 0;
+	start = TIMING_Cycles();
+	DSP_Convert_i16(bench_raw, bench_xyz, 3 * DSP_BENCH_SAMPLES, scale);
+	DSP_MagSqBatch_f32(bench_xyz, bench_mag_sq, DSP_BENCH_SAMPLES);
+	for (int i = 0; i < DSP_BENCH_SAMPLES; i++) {
+		alarms += DSP_OutsideBand(bench_mag_sq[i], -high, high);
+	}
+	bench_report("f32 sq", TIMING_Cycles() - start);
+	bench_sink = alarms;
+
+	// fixed point on the raw values, threshold converted once to raw units
+	alarms = 0;
+	raw_high_sq = (uint32_t)((high / scale) * (high / scale));
+	start = TIMING_Cycles();
+	DSP_MagSqBatch_i16(bench_raw, bench_mag_sq_i16, DSP_BENCH_SAMPLES);
+	for (int i = 0; i < DSP_BENCH_SAMPLES; i++) {
+		alarms += bench_mag_sq_i16[i] > raw_high_sq;
+	}
+	bench_report("i16 sq", TIMING_Cycles() - start);
+	bench_sink = alarms;
+}
+#endif
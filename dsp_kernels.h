@@ -0,0 +1,57 @@
+/*
+ * dsp_kernels.h
+ *
+ * Purpose: Declare the sample conversion and feature kernels.
+ * Content:
+ * Batch raw to physical conversion, squared magnitude and norm of 3 axis
+ * vectors, threshold test without sqrt, cycle benchmark of the kernels.
+ */
+
+#ifndef DSP_KERNELS_H
+#define DSP_KERNELS_H
+
+#include "main.h"
+
+/* Build with ARM_MATH_CM4 (and CMSIS-DSP linked) to use the CMSIS-DSP
+ * kernels, the portable C versions are used otherwise (host builds).
+ * */
+#if defined(ARM_MATH_CM4)
+#define DSP_USE_CMSIS 1
+#else
+#define DSP_USE_CMSIS 0
+#endif
+
+// 1 runs DSP_Benchmark() once when the scheduler task starts
+#ifndef DSP_BENCHMARK
+#define DSP_BENCHMARK 0
+#endif
+
+// samples per kernel in the benchmark
+#define DSP_BENCH_SAMPLES 192
+
+// out[i] = raw[i] * scale, n values
+void DSP_Convert_i16(const int16_t *raw, float *out, uint32_t n, float scale);
+// out[i] = in[i] * scale, n values
+void DSP_Scale_f32(const float *in, float *out, uint32_t n, float scale);
+
+// x*x + y*y + z*z of one vector
+float DSP_MagSq_f32(const float *xyz);
+uint32_t DSP_MagSq_i16(const int16_t *xyz);
+// squared magnitudes of n vectors stored x,y,z,x,y,z...
+void DSP_MagSqBatch_f32(const float *xyz, float *out, uint32_t n);
+void DSP_MagSqBatch_i16(const int16_t *xyz, uint32_t *out, uint32_t n);
+// euclidean norm of one vector
+float DSP_Norm_f32(const float *xyz);
+
+/* 1 if the magnitude whose square is mag_sq is above high or below low,
+ * the same test as (magnitude > high || magnitude < low) without the sqrt
+ * */
+int DSP_OutsideBand(float mag_sq, float low, float high);
+
+#if DSP_BENCHMARK
+void DSP_Benchmark(void);
+#else
+#define DSP_Benchmark()
+#endif
+
+#endif
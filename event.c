@@ -0,0 +1,177 @@
+/*
+ * event.c
+ *
+ * Purpose: Respond to critical events outside the sampling loops.
+ * Content:
+ * Event record queue and xTaskNotify bits (ACCEL_NOTIFICATION ...
+ * PRESS_NOTIFICATION_LOW) towards vCriticalEventTask.
+ * Response actions: actuator hook, LEDs, detection to response latency
+ * (LAT_STAGE_ALARM); alarm lane output filtered by alarm_mgr.c.
+ *
+ * Formatting and transmitting an alarm took the detecting sensor task
+ * several milliseconds, during which it did not sample. Detectors now fill
+ * a record and post it; the highest priority task wakes on the notification
+ * bit of the sensor, runs the actuator hook first and prints the alarm on
+ * the alarm lane (send_uart_alarm), ahead of the queued sample lines.
+ */
+
+#include "event.h"
+#include "rules.h"
+#include "alarm_mgr.h"
+#include "latency.h"
+#include "timing.h"
+#include <string.h>
+
+static event_record queue[EVENT_QUEUE_SIZE];
+static int head, count;
+static uint32_t dropped;
+static TaskHandle_t event_task;
+
+void EVENT_Init(void) {
+	head = 0;
+	count = 0;
+	dropped = 0;
+}
+
+/* The notification bit of sensors.h for the sensor and direction */
+static uint32_t notification(const event_record *event) {
+	switch (event->sensor) {
+		case SENSOR_ACCEL:	return ACCEL_NOTIFICATION;
+		case SENSOR_GYRO:	return GYRO_NOTIFICATION;
+		case SENSOR_MAG:	return MAG_NOTIFICATION;
+		case SENSOR_TEMP:	return event->high ? TEMP_NOTIFICATION_HIGH : TEMP_NOTIFICATION_LOW;
+		case SENSOR_HUMID:	return event->high ? HUMID_NOTIFICATION_HIGH : HUMID_NOTIFICATION_LOW;
+		default:			return event->high ? PRESS_NOTIFICATION_HIGH : PRESS_NOTIFICATION_LOW;
+	}
+}
+
+/* Time stamp the record, queue it and wake the critical event task.
+ * Called from task context, returns FAILURE if the queue is full.
+ * */
+int EVENT_Post(event_record *event) {
+	int status = SUCCESS;
+
+	event->t_detect = TIMING_Micros();
+	event->Hours = sTime.Hours;
+	event->Minutes = sTime.Minutes;
+	event->Seconds = sTime.Seconds;
+	event->milliSeconds = milliseconds;
+
+	taskENTER_CRITICAL();
+	if (count < EVENT_QUEUE_SIZE) {
+		queue[(head + count) % EVENT_QUEUE_SIZE] = *event;
+		count++;
+	}else{
+		dropped++;
+		status = FAILURE;
+	}
+	taskEXIT_CRITICAL();
+
+	// before the task started, it drains the queue once running
+	if (status == SUCCESS && event_task != NULL) {
+		xTaskNotify(event_task, notification(event), eSetBits);
+	}
+	return status;
+}
+
+int EVENT_Pending(void) {
+	return count;
+}
+
+static int take(event_record *event) {
+	int status = FAILURE;
+
+	taskENTER_CRITICAL();
+	if (count > 0) {
+		*event = queue[head];
+		head = (head + 1) % EVENT_QUEUE_SIZE;
+		count--;
+		status = SUCCESS;
+	}
+	taskEXIT_CRITICAL();
+	return status;
+}
+
+__weak void EVENT_Actuator(const event_record *event) {
+	(void)event;
+}
+
+/* Response actions, for every event */
+static void respond(const event_record *event) {
+	EVENT_Actuator(event);
+
+	// orange while any rule is tripped
+	if (event->type == EVENT_TRIP || event->type == EVENT_CLEAR) {
+		if (RULES_ActiveCount() > 0) {
+			LEDG_Off();
+			LEDO_On();
+		}else{
+			LEDG_On();
+			LEDO_Off();
+		}
+	}
+
+	LAT_Record(event->sensor, LAT_STAGE_ALARM, TIMING_Micros() - event->t_detect);
+}
+
+/* Alarm lines of the events the alarm manager lets through */
+static void print(const event_record *event) {
+	char message[MAX_MESSAGE_LENGTH];
+	int n;
+
+	n = snprintf(message, sizeof(message), "%02d:%02d:%02d:%03d ",
+			event->Hours, event->Minutes, event->Seconds, event->milliSeconds);
+	switch (event->type) {
+		case EVENT_TRIP:
+			snprintf(message + n, sizeof(message) - n, "Abnormal %s reading\r", event->what);
+			break;
+		case EVENT_CLEAR:
+			snprintf(message + n, sizeof(message) - n, "%s reading back to normal\r\n\r\n", event->what);
+			break;
+		case EVENT_PATTERN:
+			snprintf(message + n, sizeof(message) - n, "Pattern %s\r", event->what);
+			break;
+		default:
+			snprintf(message + n, sizeof(message) - n, "Anomaly %s %s %.1f at %.2f\r",
+					sensor_name[event->sensor], event->what, event->score, event->value);
+			break;
+	}
+	send_uart_alarm(message);
+
+	if (event->action != NULL) {
+		snprintf(message, sizeof(message), "%s\r\n\r\n", event->action);
+		send_uart_alarm(message);
+	}
+}
+
+void vCriticalEventTask(void *pvParameters) {
+	event_record event;
+	uint32_t bits, lost, reported = 0;
+	char message[MAX_MESSAGE_LENGTH];
+
+	event_task = xTaskGetCurrentTaskHandle();
+
+	for (;;) {
+		while (take(&event) == SUCCESS) {
+			respond(&event);
+			if (ALARM_Filter(&event) == ALARM_PRINT) {
+				print(&event);
+			}
+		}
+		// clears that held, summaries of the suppressed repeats
+		while (ALARM_Due(&event) == SUCCESS) {
+			print(&event);
+		}
+		ALARM_Summary();
+
+		lost = dropped;
+		if (lost != reported) {
+			snprintf(message, sizeof(message), "%lu alarm events dropped, event queue full\r\n", (unsigned long)(lost - reported));
+			send_uart_alarm(message);
+			reported = lost;
+		}
+
+		// the bits tell which sensors posted, the records are all in the queue
+		xTaskNotifyWait(0, 0xFFFFFFFFu, &bits, pdMS_TO_TICKS(EVENT_IDLE_MS));
+	}
+}
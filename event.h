@@ -0,0 +1,53 @@
+/*
+ * event.h
+ *
+ * Purpose: Declare the critical event path.
+ * Content:
+ * Event record posted by the detectors, posting function and the actuator
+ * hook run by vCriticalEventTask.
+ */
+
+#ifndef EVENT_H
+#define EVENT_H
+
+#include "sensors.h"
+
+// records waiting for vCriticalEventTask, a full queue drops the new event
+#define EVENT_QUEUE_SIZE 16
+
+// above the I2C bus manager, nothing delays the response to an alarm
+#define EVENT_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+
+// longest sleep of the task without events, for the deferred clears and summaries
+#define EVENT_IDLE_MS 1000
+
+typedef enum {
+	EVENT_TRIP = 0,		// a rule tripped (rules.c)
+	EVENT_CLEAR,		// a rule cleared
+	EVENT_ANOMALY,		// a detector started firing (anomaly.c)
+	EVENT_PATTERN		// a cross-sensor pattern started matching (cep.c)
+} event_type;
+
+typedef struct {
+	uint32_t t_detect;		// TIMING_Micros() when posted
+	const char *what;		// static text: rule, detector or pattern name
+	const char *action;		// static text, NULL: none
+	float value;
+	float score;			// EVENT_ANOMALY: detector score
+	uint8_t sensor;
+	uint8_t type;			// event_type
+	uint8_t high;			// above the normal range (HIGH/LOW notification bit)
+	uint8_t Hours;			// RTC time of the detection
+	uint8_t Minutes;
+	uint8_t Seconds;
+	uint16_t milliSeconds;
+} event_record;
+
+void EVENT_Init(void);
+int EVENT_Post(event_record *event);
+// records waiting for the task
+int EVENT_Pending(void);
+// response hook of the cooling, pump, valve... drivers, the default does nothing
+void EVENT_Actuator(const event_record *event);
+
+#endif
@@ -19,6 +19,7 @@
  */
 
 #include "fifo.h"
+#include "trace.h"
 
 #define SUCCESS 1
 #define FAILURE 0
@@ -28,15 +29,23 @@ void FIFO_Init(FIFO* fifoPtr) {
 	fifoPtr->head = 0;
 	fifoPtr->tail = 0;
 	fifoPtr->count = 0;
+	fifoPtr->peak = 0;
+	fifoPtr->lost = 0;
 }
 
 int FIFO_Write(FIFO* fifoPtr, Data value) {
     if (fifoPtr->count == fifoPtr->size) {
+        fifoPtr->lost++;
+        TRACE_Record(TRACE_FIFO_OVERFLOW, fifoPtr->id, fifoPtr->count);
         return FAILURE;  // FIFO is full
     }
     fifoPtr->data[fifoPtr->head] = value;
     fifoPtr->head = (fifoPtr->head + 1) % fifoPtr->size;
     fifoPtr->count++;
+    if (fifoPtr->count > fifoPtr->peak) {
+        fifoPtr->peak = fifoPtr->count;
+    }
+    TRACE_Record(TRACE_FIFO_WRITE, fifoPtr->id, fifoPtr->count);
     return SUCCESS;
 }
 
@@ -47,6 +56,7 @@ int FIFO_Read(FIFO* fifoPtr, Data* value) {
     *value = fifoPtr->data[fifoPtr->tail];
     fifoPtr->tail = (fifoPtr->tail + 1) % fifoPtr->size;
     fifoPtr->count--;
+    TRACE_Record(TRACE_FIFO_READ, fifoPtr->id, fifoPtr->count);
     return SUCCESS;
 }
 
@@ -54,15 +64,23 @@ void FIFO_Init_3Axis(FIFO3Axis* fifoPtr) {
 	fifoPtr->head = 0;
 	fifoPtr->tail = 0;
 	fifoPtr->count = 0;
+	fifoPtr->peak = 0;
+	fifoPtr->lost = 0;
 }
 
 int FIFO_Write_3Axis(FIFO3Axis* fifoPtr, Data3Axis value) {
     if (fifoPtr->count == fifoPtr->size) {
+        fifoPtr->lost++;
+        TRACE_Record(TRACE_FIFO_OVERFLOW, fifoPtr->id, fifoPtr->count);
         return FAILURE;  // FIFO is full
     }
     fifoPtr->data[fifoPtr->head] = value;
     fifoPtr->head = (fifoPtr->head + 1) % fifoPtr->size;
     fifoPtr->count++;
+    if (fifoPtr->count > fifoPtr->peak) {
+        fifoPtr->peak = fifoPtr->count;
+    }
+    TRACE_Record(TRACE_FIFO_WRITE, fifoPtr->id, fifoPtr->count);
     return SUCCESS;
 }
 
@@ -73,6 +91,7 @@ int FIFO_Read_3Axis(FIFO3Axis* fifoPtr, Data3Axis* value) {
     *value = fifoPtr->data[fifoPtr->tail];
     fifoPtr->tail = (fifoPtr->tail + 1) % fifoPtr->size;
     fifoPtr->count--;
+    TRACE_Record(TRACE_FIFO_READ, fifoPtr->id, fifoPtr->count);
     return SUCCESS;
 }
 
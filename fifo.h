@@ -34,6 +34,8 @@ typedef struct {
 	uint8_t Minutes;
 	uint8_t Seconds;
 	uint32_t milliSeconds;
+	uint32_t timestamp;		// TIMING_Micros() when written to the FIFO
+	uint16_t skipped;		// readings dropped by the deadband before this one
     float value;
 } Data;
 
@@ -42,6 +44,7 @@ typedef struct {
 	uint8_t Minutes;
 	uint8_t Seconds;
 	uint32_t milliSeconds;
+	uint32_t timestamp;		// TIMING_Micros() when written to the FIFO
     float x;
     float y;
     float z;
@@ -53,6 +56,9 @@ typedef struct {
     int tail;
     int count;
     int size;
+    int peak;		// highest count since reset (sysmon.c)
+    int lost;		// writes refused while full, since reset (sysmon.c)
+    uint8_t id;		// sensor index in the trace events (trace.c)
 } FIFO;
 
 typedef struct {
@@ -61,6 +67,9 @@ typedef struct {
     int tail;
     int count;
     int size;
+    int peak;
+    int lost;
+    uint8_t id;
 } FIFO3Axis;
 
 // Function prototypes
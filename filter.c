@@ -0,0 +1,412 @@
+/*
+ * filter.c
+ *
+ * Purpose: Turn several noisy readings into one clean sample.
+ * Content:
+ * Per sensor oversampling ratio and filter configuration.
+ * Windowed-sinc FIR and CIC decimator design, block decimation
+ * (CMSIS-DSP arm_fir_decimate_f32, portable C otherwise).
+ * Median of the last 3 or 5 readings against single reading spikes.
+ * Frequency response self test against reference tones.
+ *
+ * A sensor configured with ratio R is read R times per effective_interval
+ * (SENSOR_ReadInterval()), and the readings of each interval form one
+ * block for the decimator, which produces the sample that goes on to the
+ * statistics, rules and FIFO. Only the environmental sensors are
+ * decimated: the motion readings go on as they are, a lowpass would take
+ * the vibration and the shocks out before the rules, anomaly detectors and
+ * CEP patterns see them, and delay them by half its taps. The first reading
+ * of a sensor primes the history and is passed on as its first sample,
+ * instead of waiting for a whole interval of readings.
+ * The decimator only evaluates the taps at the output instants (polyphase
+ * form), over a contiguous history so the inner loop is a plain dot
+ * product.
+ * The CIC runs in its FIR form (the cascade of boxcars as coefficients):
+ * float integrators would lose resolution as they grow without bound, and
+ * the response is the same.
+ */
+
+#include "filter.h"
+#include "dsp_kernels.h"
+#include <math.h>
+#include <string.h>
+
+#if DSP_USE_CMSIS
+#include "arm_math.h"
+#endif
+
+#define FILTER_PI 3.14159265f
+#define FILTER_MEDIAN_MAX 5
+
+// decimator channels: 1 per environmental sensor, 3 more per motion sensor given a decimator
+#define FILTER_CHANNELS 3
+
+typedef struct {
+	uint8_t ratio;		// readings per sample
+	uint8_t type;		// filter_type
+	uint8_t order;		// FIR: taps per phase, CIC: stages
+	uint8_t median;		// 0, 3 or 5 readings
+} filter_config;
+
+static const filter_config config[SENSOR_COUNT] = {
+#if FILTER_ENABLE
+	// vibration and shocks are the signal here, see above
+	[SENSOR_ACCEL] = { 1, FILTER_NONE, 0, 0 },
+	[SENSOR_GYRO]  = { 1, FILTER_NONE, 0, 0 },
+	[SENSOR_MAG]   = { 1, FILTER_NONE, 0, 0 },
+	[SENSOR_TEMP]  = { 4, FILTER_CIC, 3, 3 },
+	[SENSOR_HUMID] = { 4, FILTER_CIC, 3, 3 },
+	[SENSOR_PRESS] = { 4, FILTER_CIC, 3, 3 },
+#else
+	[SENSOR_ACCEL] = { 1, FILTER_NONE, 0, 0 },
+	[SENSOR_GYRO]  = { 1, FILTER_NONE, 0, 0 },
+	[SENSOR_MAG]   = { 1, FILTER_NONE, 0, 0 },
+	[SENSOR_TEMP]  = { 1, FILTER_NONE, 0, 0 },
+	[SENSOR_HUMID] = { 1, FILTER_NONE, 0, 0 },
+	[SENSOR_PRESS] = { 1, FILTER_NONE, 0, 0 },
+#endif
+};
+
+typedef struct {
+	const float *coeff;
+	int taps;
+	int ratio;
+	float *state;		// taps - 1 previous readings followed by the current block
+#if DSP_USE_CMSIS
+	arm_fir_decimate_instance_f32 fir;
+#endif
+	int primed;
+	float window[FILTER_MEDIAN_MAX];	// last readings for the median
+	uint8_t median;
+	uint8_t fill;
+	uint8_t pos;
+} filter_channel;
+
+typedef struct {
+	float coeff[FILTER_MAX_TAPS];
+	int taps;			// 0: no decimator
+	int ratio;
+	int axes;
+	int pending;		// readings in the current block
+	filter_channel channel[3];
+	float block[3][FILTER_MAX_RATIO];
+} filter_sensor;
+
+static filter_sensor filters[SENSOR_COUNT];
+static float state_mem[FILTER_CHANNELS][FILTER_MAX_TAPS + FILTER_MAX_RATIO - 1];
+
+/* Hamming windowed sinc, cutoff at FILTER_FIR_CUTOFF of the output Nyquist */
+static int design_fir(float *coeff, int ratio, int order) {
+	int taps = ratio * order;
+	float fc = FILTER_FIR_CUTOFF * 0.5f / ratio;	// cycles per reading
+	float sum = 0;
+
+	for (int i = 0; i < taps; i++) {
+		float t = i - (taps - 1) / 2.0f;
+		float sinc = t != 0 ? sinf(2 * FILTER_PI * fc * t) / (FILTER_PI * t) : 2 * fc;
+		coeff[i] = sinc * (0.54f - 0.46f * cosf(2 * FILTER_PI * i / (taps - 1)));
+		sum += coeff[i];
+	}
+	for (int i = 0; i < taps; i++) {
+		coeff[i] /= sum;	// unity gain at DC
+	}
+	return taps;
+}
+
+/* Impulse response of an order stage CIC: order boxcars of ratio ones
+ * convolved, divided by the DC gain ratio^order
+ * */
+static int design_cic(float *coeff, int ratio, int order) {
+	int taps = 1;
+	float sum = 0;
+
+	coeff[0] = 1;
+	for (int stage = 0; stage < order; stage++) {
+		int len = taps + ratio - 1;
+		// in place from the end, coeff[i] only needs the old coeff[0..i]
+		for (int i = len - 1; i >= 0; i--) {
+			float acc = 0;
+			for (int j = 0; j < ratio; j++) {
+				if (i - j >= 0 && i - j < taps) {
+					acc += coeff[i - j];
+				}
+			}
+			coeff[i] = acc;
+		}
+		taps = len;
+	}
+	for (int i = 0; i < taps; i++) {
+		sum += coeff[i];
+	}
+	for (int i = 0; i < taps; i++) {
+		coeff[i] /= sum;
+	}
+	return taps;
+}
+
+/* Coefficients of the configuration, number of taps (0 for FILTER_NONE) */
+static int design(int type, float *coeff, int ratio, int order) {
+	switch (type) {
+	case FILTER_FIR:
+		if (ratio * order > FILTER_MAX_TAPS) {
+			order = FILTER_MAX_TAPS / ratio;
+		}
+		return design_fir(coeff, ratio, order);
+	case FILTER_CIC:
+		if (order * (ratio - 1) + 1 > FILTER_MAX_TAPS) {
+			order = (FILTER_MAX_TAPS - 1) / (ratio - 1);
+		}
+		return design_cic(coeff, ratio, order);
+	default:
+		return 0;
+	}
+}
+
+/* block: readings per decimate() call, a multiple of the ratio */
+static void channel_init(filter_channel *ch, const float *coeff, int taps, int ratio, float *state, int block) {
+	ch->coeff = coeff;
+	ch->taps = taps;
+	ch->ratio = ratio;
+	ch->state = state;
+	ch->primed = 0;
+	memset(state, 0, (taps + block - 1) * sizeof(float));
+#if DSP_USE_CMSIS
+	arm_fir_decimate_init_f32(&ch->fir, taps, ratio, coeff, state, block);
+#endif
+}
+
+/* n readings (a multiple of the ratio) in, n / ratio samples out */
+static void decimate(filter_channel *ch, const float *in, float *out, int n) {
+#if DSP_USE_CMSIS
+	arm_fir_decimate_f32(&ch->fir, (float*)in, out, n);
+#else
+	float *state = ch->state;
+	const float *coeff = ch->coeff;
+	int taps = ch->taps;
+
+	memcpy(&state[taps - 1], in, n * sizeof(float));
+	for (int i = ch->ratio - 1; i < n; i += ch->ratio) {
+		// the taps readings ending at reading i start at state[i]
+		const float *x = &state[i];
+		float acc = 0;
+		for (int k = 0; k < taps; k++) {
+			acc += coeff[k] * x[k];
+		}
+		*out++ = acc;
+	}
+	memmove(state, &state[n], (taps - 1) * sizeof(float));
+#endif
+}
+
+/* Median of the last ch->median readings (fewer until the window is full) */
+static float median(filter_channel *ch, float value) {
+	float sorted[FILTER_MEDIAN_MAX];
+
+	if (ch->median == 0) {
+		return value;
+	}
+
+	ch->window[ch->pos] = value;
+	ch->pos = (ch->pos + 1) % ch->median;
+	if (ch->fill < ch->median) {
+		ch->fill++;
+	}
+
+	for (int i = 0; i < ch->fill; i++) {
+		float v = ch->window[i];
+		int j = i;
+		for (; j > 0 && sorted[j - 1] > v; j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = v;
+	}
+	return sorted[ch->fill / 2];
+}
+
+void FILTER_Init(void) {
+	int next = 0;
+
+	memset(filters, 0, sizeof(filters));
+	for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+		const filter_config *cfg = &config[sensor];
+		filter_sensor *f = &filters[sensor];
+
+		f->axes = sensor < SENSOR_TEMP ? 3 : 1;
+		f->ratio = cfg->type == FILTER_NONE ? 1 : cfg->ratio;
+		f->taps = design(cfg->type, f->coeff, f->ratio, cfg->order);
+
+		for (int axis = 0; axis < f->axes; axis++) {
+			filter_channel *ch = &f->channel[axis];
+			if (f->taps > 0) {
+				channel_init(ch, f->coeff, f->taps, f->ratio, state_mem[next++], f->ratio);
+			}
+			ch->median = cfg->median;
+		}
+	}
+}
+
+int FILTER_Ratio(sensor_id sensor) {
+	return filters[sensor].ratio > 0 ? filters[sensor].ratio : 1;
+}
+
+int FILTER_Push(sensor_id sensor, const float *in, float *out) {
+	filter_sensor *f = &filters[sensor];
+
+	// the first reading fills the history and goes out undecimated
+	if (f->taps > 0 && !f->channel[0].primed) {
+		for (int axis = 0; axis < f->axes; axis++) {
+			filter_channel *ch = &f->channel[axis];
+			out[axis] = median(ch, in[axis]);
+			for (int i = 0; i < f->taps - 1; i++) {
+				ch->state[i] = out[axis];
+			}
+			ch->primed = 1;
+		}
+		return SUCCESS;
+	}
+
+	for (int axis = 0; axis < f->axes; axis++) {
+		f->block[axis][f->pending] = median(&f->channel[axis], in[axis]);
+	}
+	if (++f->pending < f->ratio) {
+		return FAILURE;
+	}
+	f->pending = 0;
+
+	for (int axis = 0; axis < f->axes; axis++) {
+		filter_channel *ch = &f->channel[axis];
+
+		if (f->taps == 0) {
+			out[axis] = f->block[axis][0];
+			continue;
+		}
+		decimate(ch, f->block[axis], &out[axis], f->ratio);
+	}
+	return SUCCESS;
+}
+
+#if FILTER_SELFTEST
+/***********************************************
+ * Self test:
+ * 	decimate tones with a whole number of periods
+ * 	per DFT block, compare the amplitude of the
+ * 	aliased output tone with |H(f)| of the taps
+ * 	and with the design limits.
+ ***********************************************/
+#define TEST_RATIO		4
+#define TEST_FIR_ORDER	8
+#define TEST_CIC_ORDER	3
+#define TEST_BLOCK		64		// readings per decimate() call
+#define TEST_SETTLE		32		// samples dropped before the DFT, >= taps / TEST_RATIO
+#define TEST_OUTPUTS	64		// DFT length in samples
+#define TEST_TOLERANCE	1e-3f
+
+static float test_coeff[FILTER_MAX_TAPS];
+static float test_state[FILTER_MAX_TAPS + TEST_BLOCK - 1];
+static float test_in[TEST_BLOCK];
+static float test_out[TEST_SETTLE + TEST_OUTPUTS];
+
+/* tone k: k periods per TEST_OUTPUTS samples, i.e. k / (TEST_OUTPUTS * TEST_RATIO) cycles per reading */
+static const struct {
+	uint8_t type;
+	uint8_t k;
+	float min, max;
+} test_point[] = {
+	{ FILTER_FIR, 0,  0.99f, 1.01f },
+	{ FILTER_FIR, 8,  0.95f, 1.05f },	// half the output Nyquist
+	{ FILTER_FIR, 40, 0, 0.01f },		// 1.25x the output Nyquist, aliases onto k = 24
+	{ FILTER_FIR, 80, 0, 0.01f },
+	{ FILTER_CIC, 0,  0.99f, 1.01f },
+	{ FILTER_CIC, 8,  0.85f, 1.0f },	// passband droop
+	{ FILTER_CIC, 64, 0, 0.001f },		// null at the output rate, aliases onto DC
+	{ FILTER_CIC, 72, 0, 0.01f },		// aliases onto k = 8
+};
+
+/* |H(f)| of the taps, f in cycles per reading */
+static float response(const float *coeff, int taps, float f) {
+	float re = 0, im = 0;
+
+	for (int i = 0; i < taps; i++) {
+		re += coeff[i] * cosf(2 * FILTER_PI * f * i);
+		im -= coeff[i] * sinf(2 * FILTER_PI * f * i);
+	}
+	return sqrtf(re * re + im * im);
+}
+
+/* Amplitude of the decimated cosine tone k */
+static float measure(filter_channel *ch, int k) {
+	const int period = TEST_OUTPUTS * TEST_RATIO;
+	int bin = k % TEST_OUTPUTS;
+	float re = 0, im = 0;
+	int n = 0;
+
+	if (bin > TEST_OUTPUTS / 2) {
+		bin = TEST_OUTPUTS - bin;
+	}
+
+	channel_init(ch, ch->coeff, ch->taps, TEST_RATIO, test_state, TEST_BLOCK);
+	for (int out = 0; out < TEST_SETTLE + TEST_OUTPUTS; out += TEST_BLOCK / TEST_RATIO) {
+		for (int i = 0; i < TEST_BLOCK; i++, n++) {
+			test_in[i] = cosf(2 * FILTER_PI * ((k * n) % period) / period);
+		}
+		decimate(ch, test_in, &test_out[out], TEST_BLOCK);
+	}
+
+	for (int m = 0; m < TEST_OUTPUTS; m++) {
+		float angle = 2 * FILTER_PI * ((bin * m) % TEST_OUTPUTS) / TEST_OUTPUTS;
+		re += test_out[TEST_SETTLE + m] * cosf(angle);
+		im -= test_out[TEST_SETTLE + m] * sinf(angle);
+	}
+	return (bin == 0 ? 1.0f : 2.0f) * sqrtf(re * re + im * im) / TEST_OUTPUTS;
+}
+
+/* A single reading spike must not reach the median output */
+static int test_median(void) {
+	static const float readings[] = { 1, 1, 1, 9, 1, 1, -7, 1 };
+	filter_channel ch;
+	int status = SUCCESS;
+
+	memset(&ch, 0, sizeof(ch));
+	ch.median = 3;
+	for (unsigned i = 0; i < sizeof(readings) / sizeof(readings[0]); i++) {
+		if (median(&ch, readings[i]) != 1) {
+			status = FAILURE;
+		}
+	}
+	return status;
+}
+
+int FILTER_SelfTest(void) {
+	char message[MAX_MESSAGE_LENGTH];
+	filter_channel ch;
+	int status = SUCCESS;
+
+	for (unsigned i = 0; i < sizeof(test_point) / sizeof(test_point[0]); i++) {
+		int type = test_point[i].type;
+		int taps = design(type, test_coeff, TEST_RATIO, type == FILTER_FIR ? TEST_FIR_ORDER : TEST_CIC_ORDER);
+		float ref, gain;
+		int ok;
+
+		ch.coeff = test_coeff;
+		ch.taps = taps;
+		ref = response(test_coeff, taps, (float)test_point[i].k / (TEST_OUTPUTS * TEST_RATIO));
+		gain = measure(&ch, test_point[i].k);
+		ok = fabsf(gain - ref) <= TEST_TOLERANCE && ref >= test_point[i].min && ref <= test_point[i].max;
+		if (!ok) {
+			status = FAILURE;
+		}
+
+		snprintf(message, sizeof(message), "Filter %s R%d k%d gain %.4f ref %.4f %s\r\n",
+				type == FILTER_FIR ? "FIR" : "CIC", TEST_RATIO, test_point[i].k, gain, ref, ok ? "ok" : "FAIL");
+		send_uart_message(message);
+	}
+
+	if (test_median() != SUCCESS) {
+		status = FAILURE;
+		send_uart_message("Filter median FAIL\r\n");
+	}
+
+	send_uart_message(status == SUCCESS ? "Filter self test passed\r\n" : "Filter self test FAILED\r\n");
+	return status;
+}
+#endif
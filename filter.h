@@ -0,0 +1,52 @@
+/*
+ * filter.h
+ *
+ * Purpose: Declare the oversampling and decimation filter pipeline.
+ * Content:
+ * Build options, filter types and limits, per reading push, decimation
+ * ratio and the frequency response self test.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "sensors.h"
+
+// 0 takes every reading as one sample, as before
+#ifndef FILTER_ENABLE
+#define FILTER_ENABLE 1
+#endif
+
+// 1 runs FILTER_SelfTest() once when the scheduler task starts
+#ifndef FILTER_SELFTEST
+#define FILTER_SELFTEST 0
+#endif
+
+// limits of the per sensor configuration in filter.c
+#define FILTER_MAX_RATIO 8
+#define FILTER_MAX_TAPS 64
+
+// FIR passband edge, fraction of the output Nyquist frequency
+#define FILTER_FIR_CUTOFF 0.8f
+
+typedef enum {
+	FILTER_NONE = 0,	// no decimation, ratio 1
+	FILTER_FIR,			// windowed-sinc lowpass, order taps per phase
+	FILTER_CIC			// cascaded integrator-comb, order stages
+} filter_type;
+
+void FILTER_Init(void);
+// readings taken per output sample
+int FILTER_Ratio(sensor_id sensor);
+/* One reading (3 values for the 3 axis sensors), SUCCESS when it completed
+ * an output sample, written to out (may be the same array as in)
+ * */
+int FILTER_Push(sensor_id sensor, const float *in, float *out);
+
+#if FILTER_SELFTEST
+int FILTER_SelfTest(void);
+#else
+#define FILTER_SelfTest()
+#endif
+
+#endif
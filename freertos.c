@@ -25,6 +25,7 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "timing.h"
 
 /* USER CODE END Includes */
 
@@ -50,11 +51,23 @@
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN FunctionPrototypes */
+void configureTimerForRunTimeStats(void);
+unsigned long getRunTimeCounterValue(void);
 
 /* USER CODE END FunctionPrototypes */
 
 /* Private application code --------------------------------------------------*/
 /* USER CODE BEGIN Application */
+/* Run time stats clock (configGENERATE_RUN_TIME_STATS), for sysmon.c.
+ * The DWT counter already runs, TIMING_Init() is called before the kernel
+ * starts. Microseconds wrap after ~71 min, the reports use differences only.
+ * */
+void configureTimerForRunTimeStats(void) {
+}
+
+unsigned long getRunTimeCounterValue(void) {
+	return TIMING_Micros();
+}
 
 /* USER CODE END Application */
 
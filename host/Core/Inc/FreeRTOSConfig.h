@@ -0,0 +1,87 @@
+/*
+ * FreeRTOSConfig.h
+ *
+ * Purpose: Configure the FreeRTOS POSIX port for the host build.
+ * Content:
+ * Kernel options matching the ones CubeMX generates for the board, with
+ * the sizes the POSIX port needs.
+ *
+ * Each task is a pthread and the tick a SIGALRM of the process, at the
+ * board's 1 kHz. Everything the sources check at compile time (trace
+ * facility, run time stats, two notification slots for the I2C bus
+ * manager, timers for the simulated data-ready lines) is set as on the
+ * target, so the firmware builds unchanged.
+ */
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include <stdint.h>
+
+#define configUSE_PREEMPTION					1
+#define configUSE_TIME_SLICING					1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION	0
+#define configTICK_TYPE_WIDTH_IN_BITS			TICK_TYPE_WIDTH_32_BITS
+#define configTICK_RATE_HZ						((TickType_t)1000)
+#define configCPU_CLOCK_HZ						((unsigned long)80000000)
+#define configMAX_PRIORITIES					7
+#define configMAX_TASK_NAME_LEN					16
+#define configIDLE_SHOULD_YIELD					1
+
+// the POSIX port runs each task on its own pthread stack, these are only the TCB side
+#define configMINIMAL_STACK_SIZE				((unsigned short)1024)
+#define configTOTAL_HEAP_SIZE					((size_t)(512 * 1024))
+
+#define configSUPPORT_STATIC_ALLOCATION			1
+#define configSUPPORT_DYNAMIC_ALLOCATION		1
+
+#define configUSE_IDLE_HOOK						1
+#define configUSE_TICK_HOOK						1
+#define configUSE_MALLOC_FAILED_HOOK			0
+#define configCHECK_FOR_STACK_OVERFLOW			0
+
+#define configUSE_MUTEXES						1
+#define configUSE_RECURSIVE_MUTEXES				1
+#define configUSE_COUNTING_SEMAPHORES			1
+#define configQUEUE_REGISTRY_SIZE				8
+#define configUSE_TASK_NOTIFICATIONS			1
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES	2
+
+#define configUSE_TRACE_FACILITY				1
+#define configUSE_STATS_FORMATTING_FUNCTIONS	1
+#define configGENERATE_RUN_TIME_STATS			1
+
+// same clock as on the target (freertos.c), TIMING_Micros() is CLOCK_MONOTONIC here
+void configureTimerForRunTimeStats(void);
+unsigned long getRunTimeCounterValue(void);
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS	configureTimerForRunTimeStats
+#define portGET_RUN_TIME_COUNTER_VALUE			getRunTimeCounterValue
+
+#define configUSE_TIMERS						1
+#define configTIMER_TASK_PRIORITY				2
+#define configTIMER_QUEUE_LENGTH				10
+#define configTIMER_TASK_STACK_DEPTH			configMINIMAL_STACK_SIZE
+
+#define configUSE_CO_ROUTINES					0
+
+#define INCLUDE_vTaskPrioritySet				1
+#define INCLUDE_uxTaskPriorityGet				1
+#define INCLUDE_vTaskDelete						1
+#define INCLUDE_vTaskSuspend					1
+#define INCLUDE_vTaskDelayUntil					1
+#define INCLUDE_xTaskDelayUntil					1
+#define INCLUDE_vTaskDelay						1
+#define INCLUDE_xTaskGetSchedulerState			1
+#define INCLUDE_xTaskGetCurrentTaskHandle		1
+#define INCLUDE_uxTaskGetStackHighWaterMark		1
+#define INCLUDE_xTaskGetIdleTaskHandle			1
+#define INCLUDE_eTaskGetState					1
+#define INCLUDE_xTimerPendFunctionCall			1
+
+void vAssertCalled(const char *file, unsigned long line);
+#define configASSERT(x) if ((x) == 0) vAssertCalled(__FILE__, __LINE__)
+
+// event trace hooks (trace.c), included as in the board's FreeRTOSConfig.h
+#include "../../../trace.h"
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * cmsis_os.h
+ *
+ * Purpose: Stand-in for the CMSIS-RTOS v2 wrapper in the host build.
+ * Content:
+ * The one call main.c makes, implemented by host_rtos.c.
+ */
+
+#ifndef CMSIS_OS_H
+#define CMSIS_OS_H
+
+typedef enum {
+	osOK = 0,
+	osError = -1
+} osStatus_t;
+
+osStatus_t osKernelInitialize(void);
+
+#endif
@@ -0,0 +1,357 @@
+/*
+ * stm32l4xx_hal.h
+ *
+ * Purpose: Stand-in for the STM32L4 HAL in the host build.
+ * Content:
+ * The handle types, constants and functions of the HAL that the firmware
+ * uses, with the CMSIS core intrinsics it needs. Implemented by host_hal.c.
+ *
+ * Only what the sources reference is declared. Peripheral instances are
+ * distinct dummy addresses, so handle comparisons still work. The types
+ * keep the field names of the real HAL, not its layout.
+ */
+
+#ifndef STM32L4XX_HAL_H
+#define STM32L4XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __weak __attribute__((weak))
+
+typedef enum {
+	HAL_OK = 0,
+	HAL_ERROR,
+	HAL_BUSY,
+	HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+typedef enum {
+	RESET = 0,
+	SET = 1
+} FlagStatus;
+
+/* Core ----------------------------------------------------------------------*/
+typedef int IRQn_Type;
+
+#define EXTI9_5_IRQn			23
+#define TIM1_UP_TIM16_IRQn		25
+#define I2C2_EV_IRQn			33
+#define I2C2_ER_IRQn			34
+#define USART1_IRQn				37
+#define EXTI15_10_IRQn			40
+#define DMA1_Channel5_IRQn		15
+#define DMA2_Channel7_IRQn		69
+
+#define __CLZ(x)				((uint8_t)__builtin_clz(x))
+
+extern uint32_t SystemCoreClock;
+
+void SystemInit(void);
+HAL_StatusTypeDef HAL_Init(void);
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority);
+void HAL_IncTick(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+void HAL_SuspendTick(void);
+void HAL_ResumeTick(void);
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+
+#define __HAL_DBGMCU_FREEZE_IWDG()	((void)0)
+
+/* RCC / PWR -----------------------------------------------------------------*/
+typedef struct {
+	uint32_t PLLState, PLLSource, PLLM, PLLN, PLLP, PLLQ, PLLR;
+} RCC_PLLInitTypeDef;
+
+typedef struct {
+	uint32_t OscillatorType, HSEState, LSEState, HSIState, HSICalibrationValue;
+	uint32_t LSIState, MSIState, MSICalibrationValue, MSIClockRange;
+	RCC_PLLInitTypeDef PLL;
+} RCC_OscInitTypeDef;
+
+typedef struct {
+	uint32_t ClockType, SYSCLKSource, AHBCLKDivider, APB1CLKDivider, APB2CLKDivider;
+} RCC_ClkInitTypeDef;
+
+typedef struct {
+	uint32_t PLLSAI1Source, PLLSAI1M, PLLSAI1N, PLLSAI1P, PLLSAI1Q, PLLSAI1R, PLLSAI1ClockOut;
+} RCC_PLLSAI1InitTypeDef;
+
+typedef struct {
+	uint32_t PeriphClockSelection;
+	uint32_t Usart1ClockSelection, Usart3ClockSelection, I2c2ClockSelection;
+	uint32_t Dfsdm1ClockSelection, RTCClockSelection, UsbClockSelection;
+	RCC_PLLSAI1InitTypeDef PLLSAI1;
+} RCC_PeriphCLKInitTypeDef;
+
+#define RCC_OSCILLATORTYPE_LSI		0x08u
+#define RCC_OSCILLATORTYPE_LSE		0x04u
+#define RCC_OSCILLATORTYPE_MSI		0x10u
+#define RCC_LSE_ON					1u
+#define RCC_LSI_ON					1u
+#define RCC_MSI_ON					1u
+#define RCC_MSIRANGE_6				0x60u
+#define RCC_PLL_ON					2u
+#define RCC_PLLSOURCE_MSI			1u
+#define RCC_PLLP_DIV7				7u
+#define RCC_PLLQ_DIV2				2u
+#define RCC_PLLR_DIV2				2u
+#define RCC_CLOCKTYPE_SYSCLK		0x01u
+#define RCC_CLOCKTYPE_HCLK			0x02u
+#define RCC_CLOCKTYPE_PCLK1			0x04u
+#define RCC_CLOCKTYPE_PCLK2			0x08u
+#define RCC_SYSCLKSOURCE_PLLCLK		3u
+#define RCC_SYSCLK_DIV1				0u
+#define RCC_HCLK_DIV1				0u
+#define RCC_HCLK_DIV16				7u
+#define RCC_PERIPHCLK_USART1		0x0001u
+#define RCC_PERIPHCLK_USART3		0x0004u
+#define RCC_PERIPHCLK_I2C2			0x0080u
+#define RCC_PERIPHCLK_DFSDM1		0x0800u
+#define RCC_PERIPHCLK_USB			0x2000u
+#define RCC_PERIPHCLK_RTC			0x20000u
+#define RCC_USART1CLKSOURCE_PCLK2	0u
+#define RCC_USART3CLKSOURCE_PCLK1	0u
+#define RCC_I2C2CLKSOURCE_PCLK1		0u
+#define RCC_DFSDM1CLKSOURCE_PCLK	0u
+#define RCC_RTCCLKSOURCE_LSI		2u
+#define RCC_USBCLKSOURCE_PLLSAI1	1u
+#define RCC_PLLSAI1_48M2CLK			0x100000u
+#define RCC_LSEDRIVE_LOW			0u
+#define RCC_FLAG_IWDGRST			0x7Du
+#define FLASH_LATENCY_4				4u
+#define PWR_REGULATOR_VOLTAGE_SCALE1 0x200u
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct);
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency);
+void HAL_RCC_GetClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t *pFLatency);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig(RCC_PeriphCLKInitTypeDef *PeriphClkInit);
+void HAL_RCCEx_EnableMSIPLLMode(void);
+void HAL_PWR_EnableBkUpAccess(void);
+HAL_StatusTypeDef HAL_PWREx_ControlVoltageScaling(uint32_t VoltageScaling);
+
+#define __HAL_RCC_LSEDRIVE_CONFIG(drive)	((void)(drive))
+#define __HAL_RCC_GET_FLAG(flag)			0
+#define __HAL_RCC_CLEAR_RESET_FLAGS()		((void)0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()		((void)0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE()		((void)0)
+#define __HAL_RCC_GPIOD_CLK_ENABLE()		((void)0)
+#define __HAL_RCC_DMA1_CLK_ENABLE()			((void)0)
+#define __HAL_RCC_DMA2_CLK_ENABLE()			((void)0)
+#define __HAL_RCC_TIM1_CLK_ENABLE()			((void)0)
+
+/* GPIO ----------------------------------------------------------------------*/
+typedef struct {
+	uint32_t ODR;
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef host_gpio[5];
+#define GPIOA	(&host_gpio[0])
+#define GPIOB	(&host_gpio[1])
+#define GPIOC	(&host_gpio[2])
+#define GPIOD	(&host_gpio[3])
+#define GPIOE	(&host_gpio[4])
+
+typedef struct {
+	uint32_t Pin, Mode, Pull, Speed, Alternate;
+} GPIO_InitTypeDef;
+
+typedef enum {
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0		0x0001u
+#define GPIO_PIN_1		0x0002u
+#define GPIO_PIN_2		0x0004u
+#define GPIO_PIN_3		0x0008u
+#define GPIO_PIN_4		0x0010u
+#define GPIO_PIN_5		0x0020u
+#define GPIO_PIN_6		0x0040u
+#define GPIO_PIN_7		0x0080u
+#define GPIO_PIN_8		0x0100u
+#define GPIO_PIN_9		0x0200u
+#define GPIO_PIN_10		0x0400u
+#define GPIO_PIN_11		0x0800u
+#define GPIO_PIN_12		0x1000u
+#define GPIO_PIN_13		0x2000u
+#define GPIO_PIN_14		0x4000u
+#define GPIO_PIN_15		0x8000u
+
+#define GPIO_MODE_OUTPUT_PP		0x01u
+#define GPIO_MODE_IT_RISING		0x10110000u
+#define GPIO_NOPULL				0u
+#define GPIO_SPEED_FREQ_LOW		0u
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin);
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+
+/* DMA -----------------------------------------------------------------------*/
+typedef struct {
+	void *Instance;
+	struct {
+		uint32_t Request, Direction, PeriphInc, MemInc;
+		uint32_t PeriphDataAlignment, MemDataAlignment, Mode, Priority;
+	} Init;
+	void *Parent;
+} DMA_HandleTypeDef;
+
+#define DMA1_Channel5	((void *)0x40020058u)
+#define DMA2_Channel7	((void *)0x40020480u)
+
+#define DMA_REQUEST_2			2u
+#define DMA_REQUEST_3			3u
+#define DMA_PERIPH_TO_MEMORY	0u
+#define DMA_PINC_DISABLE		0u
+#define DMA_MINC_ENABLE			0x80u
+#define DMA_PDATAALIGN_BYTE		0u
+#define DMA_MDATAALIGN_BYTE		0u
+#define DMA_NORMAL				0u
+#define DMA_CIRCULAR			0x20u
+#define DMA_PRIORITY_LOW		0u
+#define DMA_PRIORITY_HIGH		0x2000u
+#define DMA_IT_HT				0x04u
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma);
+
+#define __HAL_LINKDMA(handle, field, dma)	do { (handle)->field = &(dma); (dma).Parent = (handle); } while (0)
+#define __HAL_DMA_DISABLE_IT(handle, it)	((void)(handle))
+
+/* UART ----------------------------------------------------------------------*/
+typedef struct {
+	void *Instance;
+	struct {
+		uint32_t BaudRate, WordLength, StopBits, Parity, Mode, HwFlowCtl, OverSampling, OneBitSampling;
+	} Init;
+	struct {
+		uint32_t AdvFeatureInit;
+	} AdvancedInit;
+	DMA_HandleTypeDef *hdmarx;
+} UART_HandleTypeDef;
+
+#define USART1	((void *)0x40013800u)
+
+#define UART_WORDLENGTH_8B			0u
+#define UART_STOPBITS_1				0u
+#define UART_PARITY_NONE			0u
+#define UART_MODE_TX_RX				0x0Cu
+#define UART_HWCONTROL_NONE			0u
+#define UART_OVERSAMPLING_16		0u
+#define UART_ONE_BIT_SAMPLE_DISABLE	0u
+#define UART_ADVFEATURE_NO_INIT		0u
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart);
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+
+/* RTC -----------------------------------------------------------------------*/
+typedef struct {
+	uint8_t Hours, Minutes, Seconds, TimeFormat;
+	uint32_t SubSeconds, SecondFraction, DayLightSaving, StoreOperation;
+} RTC_TimeTypeDef;
+
+typedef struct {
+	uint8_t WeekDay, Month, Date, Year;
+} RTC_DateTypeDef;
+
+typedef struct {
+	void *Instance;
+	struct {
+		uint32_t HourFormat, AsynchPrediv, SynchPrediv, OutPut, OutPutRemap, OutPutPolarity, OutPutType;
+	} Init;
+} RTC_HandleTypeDef;
+
+#define RTC		((void *)0x40002800u)
+
+#define RTC_FORMAT_BIN				0u
+#define RTC_HOURFORMAT_24			0u
+#define RTC_OUTPUT_DISABLE			0u
+#define RTC_OUTPUT_REMAP_NONE		0u
+#define RTC_OUTPUT_POLARITY_HIGH	0u
+#define RTC_OUTPUT_TYPE_OPENDRAIN	0u
+#define RTC_DAYLIGHTSAVING_NONE		0u
+#define RTC_STOREOPERATION_RESET	0u
+#define RTC_WEEKDAY_MONDAY			1u
+#define RTC_MONTH_JANUARY			1u
+#define RTC_BKP_DR0					0u
+
+HAL_StatusTypeDef HAL_RTC_Init(RTC_HandleTypeDef *hrtc);
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format);
+uint32_t HAL_RTCEx_BKUPRead(RTC_HandleTypeDef *hrtc, uint32_t BackupRegister);
+void HAL_RTCEx_BKUPWrite(RTC_HandleTypeDef *hrtc, uint32_t BackupRegister, uint32_t Data);
+
+/* TIM -----------------------------------------------------------------------*/
+typedef struct {
+	void *Instance;
+} TIM_HandleTypeDef;
+
+#define TIM1	((void *)0x40012C00u)
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
+
+/* I2C -----------------------------------------------------------------------*/
+typedef struct {
+	void *Instance;
+	struct {
+		uint32_t Timing, OwnAddress1, AddressingMode, DualAddressMode;
+		uint32_t OwnAddress2, OwnAddress2Masks, GeneralCallMode, NoStretchMode;
+	} Init;
+	DMA_HandleTypeDef *hdmarx;
+} I2C_HandleTypeDef;
+
+#define I2C2	((void *)0x40005800u)
+
+#define I2C_MEMADD_SIZE_8BIT		1u
+#define I2C_ADDRESSINGMODE_7BIT		1u
+#define I2C_DUALADDRESS_DISABLE		0u
+#define I2C_OA2_NOMASK				0u
+#define I2C_GENERALCALL_DISABLE		0u
+#define I2C_NOSTRETCH_DISABLE		0u
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Abort_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress);
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c);
+
+/* IWDG ----------------------------------------------------------------------*/
+typedef struct {
+	void *Instance;
+	struct {
+		uint32_t Prescaler, Reload, Window;
+	} Init;
+} IWDG_HandleTypeDef;
+
+#define IWDG	((void *)0x40003000u)
+
+#define IWDG_PRESCALER_64		4u
+#define IWDG_WINDOW_DISABLE		0x0FFFu
+
+HAL_StatusTypeDef HAL_IWDG_Init(IWDG_HandleTypeDef *hiwdg);
+HAL_StatusTypeDef HAL_IWDG_Refresh(IWDG_HandleTypeDef *hiwdg);
+
+#endif
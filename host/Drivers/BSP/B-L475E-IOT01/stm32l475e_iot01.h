@@ -0,0 +1,24 @@
+/*
+ * stm32l475e_iot01.h
+ *
+ * Purpose: Stand-in for the board support package in the host build.
+ * Content:
+ * Sensor register access of the BSP, implemented by host_bsp.c.
+ *
+ * There is no register model: writes are accepted and ignored, reads
+ * return 0. The sensor values come from the BSP driver calls of the
+ * per-sensor headers.
+ */
+
+#ifndef STM32L475E_IOT01_H
+#define STM32L475E_IOT01_H
+
+#include "stm32l4xx_hal.h"
+
+void SENSOR_IO_Init(void);
+void SENSOR_IO_Write(uint8_t Addr, uint8_t Reg, uint8_t Value);
+uint8_t SENSOR_IO_Read(uint8_t Addr, uint8_t Reg);
+uint16_t SENSOR_IO_ReadMultiple(uint8_t Addr, uint8_t Reg, uint8_t *Buffer, uint16_t Length);
+void SENSOR_IO_WriteMultiple(uint8_t Addr, uint8_t Reg, uint8_t *Buffer, uint16_t Length);
+
+#endif
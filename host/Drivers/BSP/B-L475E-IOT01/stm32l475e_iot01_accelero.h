@@ -0,0 +1,26 @@
+/*
+ * stm32l475e_iot01_accelero.h
+ *
+ * Purpose: Stand-in for the BSP accelerometer driver in the host build.
+ * Content:
+ * Same calls and units as the BSP, synthetic values from host_bsp.c.
+ */
+
+#ifndef STM32L475E_IOT01_ACCELERO_H
+#define STM32L475E_IOT01_ACCELERO_H
+
+#include "stm32l475e_iot01.h"
+
+typedef enum {
+	ACCELERO_OK = 0,
+	ACCELERO_ERROR = 1,
+	ACCELERO_TIMEOUT = 2
+} ACCELERO_StatusTypeDef;
+
+ACCELERO_StatusTypeDef BSP_ACCELERO_Init(void);
+void BSP_ACCELERO_DeInit(void);
+void BSP_ACCELERO_LowPower(uint16_t status);
+// mg
+void BSP_ACCELERO_AccGetXYZ(int16_t *pDataXYZ);
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ * stm32l475e_iot01_gyro.h
+ *
+ * Purpose: Stand-in for the BSP gyroscope driver in the host build.
+ * Content:
+ * Same calls and units as the BSP, synthetic values from host_bsp.c.
+ */
+
+#ifndef STM32L475E_IOT01_GYRO_H
+#define STM32L475E_IOT01_GYRO_H
+
+#include "stm32l475e_iot01.h"
+
+typedef enum {
+	GYRO_OK = 0,
+	GYRO_ERROR = 1,
+	GYRO_TIMEOUT = 2
+} GYRO_StatusTypeDef;
+
+uint8_t BSP_GYRO_Init(void);
+void BSP_GYRO_DeInit(void);
+void BSP_GYRO_LowPower(uint16_t status);
+// mdps
+void BSP_GYRO_GetXYZ(float *pfData);
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * stm32l475e_iot01_hsensor.h
+ *
+ * Purpose: Stand-in for the BSP humidity driver in the host build.
+ * Content:
+ * Same calls and units as the BSP, synthetic values from host_bsp.c.
+ */
+
+#ifndef STM32L475E_IOT01_HSENSOR_H
+#define STM32L475E_IOT01_HSENSOR_H
+
+#include "stm32l475e_iot01.h"
+
+typedef enum {
+	HSENSOR_OK = 0,
+	HSENSOR_ERROR
+} HSENSOR_Status_TypDef;
+
+uint32_t BSP_HSENSOR_Init(void);
+// %rH
+float BSP_HSENSOR_ReadHumidity(void);
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ * stm32l475e_iot01_magneto.h
+ *
+ * Purpose: Stand-in for the BSP magnetometer driver in the host build.
+ * Content:
+ * Same calls and units as the BSP, synthetic values from host_bsp.c.
+ */
+
+#ifndef STM32L475E_IOT01_MAGNETO_H
+#define STM32L475E_IOT01_MAGNETO_H
+
+#include "stm32l475e_iot01.h"
+
+typedef enum {
+	MAGNETO_OK = 0,
+	MAGNETO_ERROR = 1,
+	MAGNETO_TIMEOUT = 2
+} MAGNETO_StatusTypeDef;
+
+MAGNETO_StatusTypeDef BSP_MAGNETO_Init(void);
+void BSP_MAGNETO_DeInit(void);
+void BSP_MAGNETO_LowPower(uint16_t status);
+// mgauss
+void BSP_MAGNETO_GetXYZ(int16_t *pDataXYZ);
+
+#endif
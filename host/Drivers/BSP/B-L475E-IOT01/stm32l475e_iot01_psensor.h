@@ -0,0 +1,23 @@
+/*
+ * stm32l475e_iot01_psensor.h
+ *
+ * Purpose: Stand-in for the BSP pressure driver in the host build.
+ * Content:
+ * Same calls and units as the BSP, synthetic values from host_bsp.c.
+ */
+
+#ifndef STM32L475E_IOT01_PSENSOR_H
+#define STM32L475E_IOT01_PSENSOR_H
+
+#include "stm32l475e_iot01.h"
+
+typedef enum {
+	PSENSOR_OK = 0,
+	PSENSOR_ERROR
+} PSENSOR_Status_TypDef;
+
+uint32_t BSP_PSENSOR_Init(void);
+// hPa
+float BSP_PSENSOR_ReadPressure(void);
+
+#endif
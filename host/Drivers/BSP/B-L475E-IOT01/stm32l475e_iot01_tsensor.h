@@ -0,0 +1,23 @@
+/*
+ * stm32l475e_iot01_tsensor.h
+ *
+ * Purpose: Stand-in for the BSP temperature driver in the host build.
+ * Content:
+ * Same calls and units as the BSP, synthetic values from host_bsp.c.
+ */
+
+#ifndef STM32L475E_IOT01_TSENSOR_H
+#define STM32L475E_IOT01_TSENSOR_H
+
+#include "stm32l475e_iot01.h"
+
+typedef enum {
+	TSENSOR_OK = 0,
+	TSENSOR_ERROR
+} TSENSOR_Status_TypDef;
+
+uint32_t BSP_TSENSOR_Init(void);
+// degC
+float BSP_TSENSOR_ReadTemp(void);
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * bench_main.c
+ *
+ * Purpose: Run the benchmark suite (bench.c) on the host.
+ * Content:
+ * Command line, result table, JSON results file, stand-ins for the kernel
+ * and UART calls the suite makes.
+ *
+ * 	sensor_bench [--out results.json] [--lines]
+ * The table and the file give nanoseconds per operation: median, mean,
+ * standard deviation and minimum over BENCH_REPEATS repetitions. The file
+ * follows the Google Benchmark JSON layout (one aggregate entry per
+ * statistic), so its tools work on it as well as tools/bench_compare.py.
+ * --lines prints the target's BENCH lines instead, in cycles of the
+ * nominal SystemCoreClock, to check the capture parser.
+ * There is no scheduler here, so suspending it is a no-op.
+ */
+
+#include "bench.h"
+#include "timing.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT "unknown"
+#endif
+
+static FILE *json;
+static int json_entries;
+
+void vTaskSuspendAll(void) {
+}
+
+BaseType_t xTaskResumeAll(void) {
+	return pdFALSE;
+}
+
+void send_uart_message(const char *message) {
+	fputs(message, stdout);
+}
+
+static double to_ns(float cycles) {
+	return cycles * 1e9 / SystemCoreClock;
+}
+
+static void json_entry(const bench_result *result, const char *aggregate, float cycles) {
+	fprintf(json, "%s\n    {\n"
+			"      \"name\": \"%s_%s\",\n"
+			"      \"run_name\": \"%s\",\n"
+			"      \"run_type\": \"aggregate\",\n"
+			"      \"aggregate_name\": \"%s\",\n"
+			"      \"repetitions\": %u,\n"
+			"      \"threads\": 1,\n"
+			"      \"iterations\": %u,\n"
+			"      \"real_time\": %.3f,\n"
+			"      \"cpu_time\": %.3f,\n"
+			"      \"time_unit\": \"ns\"\n"
+			"    }",
+			json_entries++ ? "," : "", result->name, aggregate, result->name, aggregate,
+			(unsigned)result->repeats, (unsigned)result->ops, to_ns(cycles), to_ns(cycles));
+}
+
+static void report(const bench_result *result) {
+	printf("%-20s %10.1f ns %10.1f ns %9.1f ns %10.1f ns %7ux%u\n", result->name,
+			to_ns(result->median), to_ns(result->mean), to_ns(result->stddev), to_ns(result->min),
+			(unsigned)result->repeats, (unsigned)result->ops);
+	if (json != NULL) {
+		json_entry(result, "median", result->median);
+		json_entry(result, "mean", result->mean);
+		json_entry(result, "stddev", result->stddev);
+		json_entry(result, "min", result->min);
+	}
+}
+
+int main(int argc, char **argv) {
+	const char *out = NULL;
+	int lines = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+			out = argv[++i];
+		}else if (strcmp(argv[i], "--lines") == 0) {
+			lines = 1;
+		}else{
+			fprintf(stderr, "usage: %s [--out results.json] [--lines]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	TIMING_Init();
+	if (lines) {
+		BENCH_Run(BENCH_Print);
+		return 0;
+	}
+
+	if (out != NULL) {
+		char date[32];
+		time_t now = time(NULL);
+
+		json = fopen(out, "w");
+		if (json == NULL) {
+			perror(out);
+			return 1;
+		}
+		strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+		fprintf(json, "{\n  \"context\": {\n"
+				"    \"date\": \"%s\",\n"
+				"    \"executable\": \"%s\",\n"
+				"    \"commit\": \"%s\",\n"
+				"    \"target\": \"host\"\n"
+				"  },\n  \"benchmarks\": [", date, argv[0], BENCH_COMMIT);
+	}
+
+	printf("%-20s %13s %13s %12s %13s %9s\n", "Benchmark", "Median", "Mean", "StdDev", "Min", "Reps x Ops");
+	BENCH_Run(report);
+
+	if (json != NULL) {
+		fprintf(json, "\n  ]\n}\n");
+		fclose(json);
+	}
+	return 0;
+}
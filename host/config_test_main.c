@@ -0,0 +1,181 @@
+/*
+ * config_test_main.c
+ *
+ * Purpose: Check the A/B fallback of the configuration store (config_store.c) on the host.
+ * Content:
+ * RAM flash with fault injection, stand-ins for the sensor and scheduler
+ * configuration, test cases, exit status for ctest.
+ *
+ * 	config_selftest
+ * Each case corrupts what a reset in the middle of a save, a worn cell or
+ * an older firmware would leave in a slot, and checks which configuration
+ * CONFIG_Load() takes. Exits with 1 when a case fails.
+ */
+
+#include "config_store.h"
+#include "scheduler.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_PAGE_SIZE 2048
+
+static uint8_t flash[CONFIG_SLOTS][TEST_PAGE_SIZE];
+static int fail_write;			// the next write fails
+static int fail_read_slot = -1;	// reads of this slot fail, as on an ECC error
+
+static sensor_ctrl_data ctrl[SENSOR_COUNT];
+volatile int output_mode[SENSOR_COUNT];
+volatile int scheduler_scheme;
+
+static int ram_erase(int slot) {
+	memset(flash[slot], 0xFF, TEST_PAGE_SIZE);
+	return SUCCESS;
+}
+
+static int ram_write(int slot, uint32_t offset, const void *data, uint32_t size) {
+	if ((offset | size) & 7 || offset + size > TEST_PAGE_SIZE || fail_write) {
+		return FAILURE;
+	}
+	memcpy(&flash[slot][offset], data, size);
+	return SUCCESS;
+}
+
+static int ram_read(int slot, uint32_t offset, void *data, uint32_t size) {
+	if (offset + size > TEST_PAGE_SIZE || slot == fail_read_slot) {
+		return FAILURE;
+	}
+	memcpy(data, &flash[slot][offset], size);
+	return SUCCESS;
+}
+
+static const config_flash ram_flash = {
+	.slot_size = TEST_PAGE_SIZE,
+	.erase = ram_erase,
+	.write = ram_write,
+	.read = ram_read,
+};
+
+void SENSOR_Configure(sensor_id sensor, const sensor_ctrl_data *data) {
+	ctrl[sensor] = *data;
+}
+
+void SENSOR_GetConfig(sensor_id sensor, sensor_ctrl_data *data) {
+	*data = ctrl[sensor];
+}
+
+const char *SENSOR_CheckConfig(const sensor_ctrl_data *data) {
+	return data->interval > 0 && data->threshold_down < data->threshold_up ? NULL : "invalid";
+}
+
+/* Fresh store: both slots erased, then saves with interval 100 (slot A) and 200 (slot B) */
+static int two_saves(void) {
+	int status = SUCCESS;
+
+	ram_erase(0);
+	ram_erase(1);
+	fail_write = 0;
+	fail_read_slot = -1;
+	CONFIG_Init(&ram_flash);
+	for (int i = 0; i < SENSOR_COUNT; i++) {
+		ctrl[i] = (sensor_ctrl_data){ .interval = 100, .threshold_up = 1, .threshold_down = 0 };
+		output_mode[i] = OUTPUT_RAW;
+	}
+	scheduler_scheme = 0;
+	if (CONFIG_Save() != SUCCESS) {
+		status = FAILURE;
+	}
+	ctrl[SENSOR_TEMP].interval = 200;
+	if (CONFIG_Save() != SUCCESS) {
+		status = FAILURE;
+	}
+	ctrl[SENSOR_TEMP].interval = 0;		// what the load must overwrite
+	return status;
+}
+
+/* Load into a fresh store, interval of Temp afterwards, 0 if nothing was loaded */
+static int load(void) {
+	CONFIG_Init(&ram_flash);
+	ctrl[SENSOR_TEMP].interval = 0;
+	return CONFIG_Load() == SUCCESS ? ctrl[SENSOR_TEMP].interval : 0;
+}
+
+static config_blob *slot_blob(int slot) {
+	return (config_blob *)flash[slot];
+}
+
+/* CRC of a slot edited on purpose, so that only the edited value is wrong */
+static void reseal(int slot) {
+	config_blob *blob = slot_blob(slot);
+	uint32_t crc = CONFIG_Crc32(blob, offsetof(config_blob, crc), 0);
+	blob->crc = CONFIG_Crc32(&blob->data, sizeof(blob->data), crc);
+}
+
+static int check(const char *name, int ok) {
+	printf("Config %s %s\n", name, ok ? "ok" : "FAIL");
+	return ok ? SUCCESS : FAILURE;
+}
+
+int main(void) {
+	int status = SUCCESS;
+
+	ram_erase(0);
+	ram_erase(1);
+	status &= check("erased flash gives the defaults", load() == 0);
+
+	status &= check("two saves", two_saves() == SUCCESS && load() == 200);
+
+	two_saves();
+	flash[1][offsetof(config_blob, data) + 4] ^= 0x01;
+	status &= check("data bit flip in B falls back to A", load() == 100);
+
+	two_saves();
+	slot_blob(1)->crc ^= 0x80000000u;
+	status &= check("bad CRC in B falls back to A", load() == 100);
+
+	two_saves();
+	memset(&flash[1][sizeof(config_blob) / 2 & ~7u], 0xFF, TEST_PAGE_SIZE - (sizeof(config_blob) / 2 & ~7u));
+	status &= check("B cut off half written falls back to A", load() == 100);
+
+	two_saves();
+	fail_read_slot = 1;
+	status &= check("ECC error reading B falls back to A", load() == 100);
+	fail_read_slot = -1;
+
+	two_saves();
+	slot_blob(0)->crc ^= 1;
+	slot_blob(1)->magic = 0;
+	status &= check("both slots bad gives the defaults", load() == 0);
+
+	two_saves();
+	slot_blob(1)->version = CONFIG_VERSION + 1;
+	reseal(1);
+	status &= check("other version in B falls back to A", load() == 100);
+
+	two_saves();
+	slot_blob(1)->data.output_mode[SENSOR_PRESS] = 7;
+	reseal(1);
+	status &= check("output mode out of range in B falls back to A", load() == 100);
+
+	two_saves();
+	slot_blob(1)->data.scheme = SCHEDULER_SCHEMES;
+	reseal(1);
+	status &= check("scheme out of range in B falls back to A", load() == 100);
+
+	two_saves();
+	slot_blob(1)->data.ctrl[SENSOR_ACCEL].interval = -5;
+	reseal(1);
+	status &= check("invalid sensor values in B fall back to A", load() == 100);
+
+	two_saves();
+	CONFIG_Changed();
+	fail_write = 1;
+	status &= check("failed save stays pending", CONFIG_Save() == FAILURE && CONFIG_Pending());
+	fail_write = 0;
+	status &= check("failed save keeps the last good slot", load() == 200);
+	CONFIG_Changed();
+	status &= check("save after a failure", CONFIG_Save() == SUCCESS && !CONFIG_Pending());
+
+	printf(status == SUCCESS ? "Config self test passed\n" : "Config self test FAILED\n");
+	return status == SUCCESS ? 0 : 1;
+}
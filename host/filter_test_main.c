@@ -0,0 +1,22 @@
+/*
+ * filter_test_main.c
+ *
+ * Purpose: Run the decimator self test (filter.c) on the host.
+ * Content:
+ * Stand-in for the UART call of the test, exit status for ctest.
+ *
+ * 	filter_selftest
+ * Prints the same lines as FILTER_SELFTEST=1 on the board, exits with 1
+ * when a tone or the median check is out of its limits.
+ */
+
+#include "filter.h"
+#include <stdio.h>
+
+void send_uart_message(const char *message) {
+	fputs(message, stdout);
+}
+
+int main(void) {
+	return FILTER_SelfTest() == SUCCESS ? 0 : 1;
+}
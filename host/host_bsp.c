@@ -0,0 +1,210 @@
+/*
+ * host_bsp.c
+ *
+ * Purpose: Simulated sensors behind the BSP calls in the host build.
+ * Content:
+ * Per-sensor synthetic signal (offset, sine, Gaussian noise, step),
+ * parsed from the environment, and the emulated duration of each read.
+ *
+ * Each sensor is configured by SIM_ACCEL, SIM_GYRO, SIM_MAG, SIM_TEMP,
+ * SIM_HUMID or SIM_PRESS, a comma separated list of key=value:
+ * 	base=v			offset of every axis (x=, y=, z= per axis)
+ * 	amp=v period=s	sine added to every axis
+ * 	noise=v			standard deviation of the Gaussian noise
+ * 	step_at=s step=v	offset added from that time on, e.g. to trip a rule
+ * 	read_us=n		time the blocking BSP read takes on the I2C bus
+ * in the units of the BSP call (mg, mdps, mgauss, degC, %rH, hPa), times
+ * in seconds since HAL_Init(). The defaults are a board lying still in an
+ * office, inside every threshold of sensors_init(). For example
+ * 	SIM_ACCEL="noise=20,step_at=30,step=1500" SIM_TEMP="amp=8,period=60"
+ */
+
+#include "host_sim.h"
+#include "stm32l475e_iot01_accelero.h"
+#include "stm32l475e_iot01_gyro.h"
+#include "stm32l475e_iot01_magneto.h"
+#include "stm32l475e_iot01_tsensor.h"
+#include "stm32l475e_iot01_hsensor.h"
+#include "stm32l475e_iot01_psensor.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	const char *env;
+	float base[3];
+	float amp, period, noise;
+	float step_at, step;
+	uint32_t read_us;
+	uint8_t parsed;
+} sim_signal;
+
+// read times: one multi-byte register read on the 400 kHz bus, conversions included
+static sim_signal accel_sim = { "SIM_ACCEL", { 0, 0, 1000 }, .read_us = 250 };
+static sim_signal gyro_sim = { "SIM_GYRO", { 0, 0, 0 }, .read_us = 250 };
+static sim_signal mag_sim = { "SIM_MAG", { 300, -200, 400 }, .read_us = 300 };
+static sim_signal temp_sim = { "SIM_TEMP", { 25 }, .read_us = 400 };
+static sim_signal humid_sim = { "SIM_HUMID", { 45 }, .read_us = 400 };
+static sim_signal press_sim = { "SIM_PRESS", { 980 }, .read_us = 300 };
+
+static uint64_t rng_state;
+
+/* xorshift64*, reproducible across hosts for a given SIM_SEED */
+static uint32_t rng_next(void) {
+	if (rng_state == 0) {
+		rng_state = (uint64_t)HOST_EnvLong("SIM_SEED", 1) * 0x9E3779B97F4A7C15ull | 1;
+	}
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return (uint32_t)((rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+/* Standard normal deviate, Box-Muller */
+static float gaussian(void) {
+	float u1 = (rng_next() + 1.0f) / 4294967296.0f;
+	float u2 = rng_next() / 4294967296.0f;
+
+	return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * (float)M_PI * u2);
+}
+
+static void parse(sim_signal *sim) {
+	const char *text = getenv(sim->env);
+	char spec[256], *save = NULL;
+
+	sim->parsed = 1;
+	if (text == NULL) {
+		return;
+	}
+	snprintf(spec, sizeof(spec), "%s", text);
+	for (char *item = strtok_r(spec, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+		char *eq = strchr(item, '=');
+		if (eq == NULL) {
+			fprintf(stderr, "%s: ignoring %s, expected key=value\n", sim->env, item);
+			continue;
+		}
+		*eq = '\0';
+		float value = strtof(eq + 1, NULL);
+		if (strcmp(item, "base") == 0) {
+			sim->base[0] = sim->base[1] = sim->base[2] = value;
+		}else if (strcmp(item, "x") == 0) {
+			sim->base[0] = value;
+		}else if (strcmp(item, "y") == 0) {
+			sim->base[1] = value;
+		}else if (strcmp(item, "z") == 0) {
+			sim->base[2] = value;
+		}else if (strcmp(item, "amp") == 0) {
+			sim->amp = value;
+		}else if (strcmp(item, "period") == 0) {
+			sim->period = value;
+		}else if (strcmp(item, "noise") == 0) {
+			sim->noise = value;
+		}else if (strcmp(item, "step_at") == 0) {
+			sim->step_at = value;
+		}else if (strcmp(item, "step") == 0) {
+			sim->step = value;
+		}else if (strcmp(item, "read_us") == 0) {
+			sim->read_us = (uint32_t)value;
+		}else{
+			fprintf(stderr, "%s: unknown key %s\n", sim->env, item);
+		}
+	}
+}
+
+/* Current value of each axis, after the read time has passed */
+static void sample(sim_signal *sim, float *out, int axes) {
+	if (!sim->parsed) {
+		parse(sim);
+	}
+	HOST_BusyWait(sim->read_us);
+
+	float t = HAL_GetTick() / 1000.0f;
+	float common = 0;
+	if (sim->amp != 0 && sim->period > 0) {
+		common += sim->amp * sinf(2.0f * (float)M_PI * t / sim->period);
+	}
+	if (sim->step != 0 && t >= sim->step_at) {
+		common += sim->step;
+	}
+	for (int i = 0; i < axes; i++) {
+		out[i] = sim->base[i] + common + (sim->noise != 0 ? sim->noise * gaussian() : 0);
+	}
+}
+
+static int16_t to_i16(float value) {
+	return value > 32767 ? 32767 : value < -32768 ? -32768 : (int16_t)lrintf(value);
+}
+
+ACCELERO_StatusTypeDef BSP_ACCELERO_Init(void) { parse(&accel_sim); return ACCELERO_OK; }
+void BSP_ACCELERO_DeInit(void) {}
+void BSP_ACCELERO_LowPower(uint16_t status) {}
+
+void BSP_ACCELERO_AccGetXYZ(int16_t *pDataXYZ) {
+	float xyz[3];
+
+	sample(&accel_sim, xyz, 3);
+	for (int i = 0; i < 3; i++) {
+		pDataXYZ[i] = to_i16(xyz[i]);
+	}
+}
+
+uint8_t BSP_GYRO_Init(void) { parse(&gyro_sim); return GYRO_OK; }
+void BSP_GYRO_DeInit(void) {}
+void BSP_GYRO_LowPower(uint16_t status) {}
+
+void BSP_GYRO_GetXYZ(float *pfData) {
+	sample(&gyro_sim, pfData, 3);
+}
+
+MAGNETO_StatusTypeDef BSP_MAGNETO_Init(void) { parse(&mag_sim); return MAGNETO_OK; }
+void BSP_MAGNETO_DeInit(void) {}
+void BSP_MAGNETO_LowPower(uint16_t status) {}
+
+void BSP_MAGNETO_GetXYZ(int16_t *pDataXYZ) {
+	float xyz[3];
+
+	sample(&mag_sim, xyz, 3);
+	for (int i = 0; i < 3; i++) {
+		pDataXYZ[i] = to_i16(xyz[i]);
+	}
+}
+
+uint32_t BSP_TSENSOR_Init(void) { parse(&temp_sim); return TSENSOR_OK; }
+
+float BSP_TSENSOR_ReadTemp(void) {
+	float value;
+
+	sample(&temp_sim, &value, 1);
+	return value;
+}
+
+uint32_t BSP_HSENSOR_Init(void) { parse(&humid_sim); return HSENSOR_OK; }
+
+float BSP_HSENSOR_ReadHumidity(void) {
+	float value;
+
+	sample(&humid_sim, &value, 1);
+	return value;
+}
+
+uint32_t BSP_PSENSOR_Init(void) { parse(&press_sim); return PSENSOR_OK; }
+
+float BSP_PSENSOR_ReadPressure(void) {
+	float value;
+
+	sample(&press_sim, &value, 1);
+	return value;
+}
+
+/* Register access: no register model, writes vanish and reads return 0 */
+void SENSOR_IO_Init(void) {}
+void SENSOR_IO_Write(uint8_t Addr, uint8_t Reg, uint8_t Value) {}
+uint8_t SENSOR_IO_Read(uint8_t Addr, uint8_t Reg) { return 0; }
+
+uint16_t SENSOR_IO_ReadMultiple(uint8_t Addr, uint8_t Reg, uint8_t *Buffer, uint16_t Length) {
+	memset(Buffer, 0, Length);
+	return 0;
+}
+
+void SENSOR_IO_WriteMultiple(uint8_t Addr, uint8_t Reg, uint8_t *Buffer, uint16_t Length) {}
@@ -0,0 +1,79 @@
+/*
+ * host_config_flash.c
+ *
+ * Purpose: File backend of the configuration store in the host build.
+ * Content:
+ * The two configuration pages of config_flash.c in a file (SIM_FLASH).
+ *
+ * Same page size, erased state and double word granularity as the
+ * internal flash, so CONFIG_Save() and CONFIG_Load() take the same paths.
+ * Delete the file to start from the defaults.
+ */
+
+#include "config_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_PAGE_SIZE 2048
+
+static FILE *open_flash(void) {
+	const char *path = getenv("SIM_FLASH");
+	FILE *file;
+
+	if (path == NULL || *path == '\0') {
+		path = "host_flash.bin";
+	}
+	file = fopen(path, "r+b");
+	if (file == NULL) {
+		// a new part is erased
+		uint8_t erased[HOST_PAGE_SIZE];
+		memset(erased, 0xFF, sizeof(erased));
+		file = fopen(path, "w+b");
+		for (int slot = 0; file != NULL && slot < CONFIG_SLOTS; slot++) {
+			fwrite(erased, 1, sizeof(erased), file);
+		}
+	}
+	return file;
+}
+
+static int file_access(int slot, uint32_t offset, void *data, uint32_t size, int write) {
+	FILE *file = open_flash();
+	int ok;
+
+	if (file == NULL) {
+		return FAILURE;
+	}
+	ok = fseek(file, (long)slot * HOST_PAGE_SIZE + offset, SEEK_SET) == 0
+			&& (write ? fwrite(data, 1, size, file) : fread(data, 1, size, file)) == size;
+	fclose(file);
+	return ok ? SUCCESS : FAILURE;
+}
+
+static int flash_erase(int slot) {
+	uint8_t erased[HOST_PAGE_SIZE];
+
+	memset(erased, 0xFF, sizeof(erased));
+	return file_access(slot, 0, erased, sizeof(erased), 1);
+}
+
+static int flash_write(int slot, uint32_t offset, const void *data, uint32_t size) {
+	if ((offset | size) & 7 || offset + size > HOST_PAGE_SIZE) {
+		return FAILURE;
+	}
+	return file_access(slot, offset, (void *)data, size, 1);
+}
+
+static int flash_read(int slot, uint32_t offset, void *data, uint32_t size) {
+	if (offset + size > HOST_PAGE_SIZE) {
+		return FAILURE;
+	}
+	return file_access(slot, offset, data, size, 0);
+}
+
+const config_flash config_flash_internal = {
+	.slot_size = HOST_PAGE_SIZE,
+	.erase = flash_erase,
+	.write = flash_write,
+	.read = flash_read,
+};
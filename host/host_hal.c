@@ -0,0 +1,205 @@
+/*
+ * host_hal.c
+ *
+ * Purpose: Host implementation of the HAL calls the firmware makes.
+ * Content:
+ * Millisecond tick, USART1 on stdout, a pty or a file, RTC on the host
+ * clock, GPIO output latches, accepting no-ops for clock, interrupt,
+ * DMA and watchdog setup.
+ *
+ * HAL_UART_Transmit blocks for the time the bytes take on the wire at
+ * SIM_UART_BAUD, like the polled transmit on the board, so the UART task
+ * and the alarm lane cost what they cost there. The register level I2C
+ * transfers fail: nothing models the sensor registers, which is why the
+ * hardware FIFO mode (imu_fifo.c) does not run on the host. The blocking
+ * BSP calls that the bus manager runs are simulated in host_bsp.c.
+ */
+
+#define _GNU_SOURCE		// posix_openpt
+#include "main.h"
+#include "host_sim.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+uint32_t SystemCoreClock = 80000000;
+GPIO_TypeDef host_gpio[5];
+
+static struct timespec hal_start;
+static int uart_fd = STDOUT_FILENO;
+static long uart_baud;
+
+long HOST_EnvLong(const char *name, long value) {
+	const char *text = getenv(name);
+
+	return text != NULL && *text != '\0' ? strtol(text, NULL, 0) : value;
+}
+
+/* Milliseconds since HAL_Init(), the TIM1 time base on the target */
+uint32_t HAL_GetTick(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((ts.tv_sec - hal_start.tv_sec) * 1000 + (ts.tv_nsec - hal_start.tv_nsec) / 1000000);
+}
+
+void HAL_Delay(uint32_t Delay) {
+	struct timespec ts = { Delay / 1000, (Delay % 1000) * 1000000L };
+
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+	}
+}
+
+static void uart_open(void) {
+	const char *target = getenv("SIM_UART");
+
+	uart_baud = HOST_EnvLong("SIM_UART_BAUD", 115200);
+	if (target == NULL || *target == '\0' || strcmp(target, "stdout") == 0) {
+		setvbuf(stdout, NULL, _IONBF, 0);
+		return;
+	}
+	if (strcmp(target, "pty") == 0) {
+		int fd = posix_openpt(O_RDWR | O_NOCTTY);
+		if (fd >= 0 && grantpt(fd) == 0 && unlockpt(fd) == 0) {
+			fprintf(stderr, "USART1 on %s\n", ptsname(fd));
+			uart_fd = fd;
+			return;
+		}
+	}else{
+		int fd = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd >= 0) {
+			uart_fd = fd;
+			return;
+		}
+	}
+	fprintf(stderr, "SIM_UART %s: %s, using stdout\n", target, strerror(errno));
+}
+
+HAL_StatusTypeDef HAL_Init(void) {
+	clock_gettime(CLOCK_MONOTONIC, &hal_start);
+	uart_open();
+	return HAL_OK;
+}
+
+/* 8N1: 10 bits per byte at the emulated baud rate */
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+	uint16_t sent = 0;
+
+	while (sent < Size) {
+		ssize_t n = write(uart_fd, pData + sent, Size - sent);
+		if (n < 0 && errno != EINTR) {
+			return HAL_ERROR;
+		}
+		if (n > 0) {
+			sent += n;
+		}
+	}
+	if (uart_baud > 0) {
+		HOST_BusyWait((uint32_t)(Size * 10000000ull / uart_baud));
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart) { return HAL_OK; }
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) { return HAL_ERROR; }
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart) {}
+
+/* RTC: the calendar set by MX_RTC_Init() advances with the host clock */
+static RTC_TimeTypeDef rtc_time;
+static RTC_DateTypeDef rtc_date;
+static uint32_t rtc_set_ms;
+static uint32_t rtc_backup[32];		// cleared at start, like the backup domain at power-up
+
+HAL_StatusTypeDef HAL_RTC_Init(RTC_HandleTypeDef *hrtc) { return HAL_OK; }
+
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format) {
+	rtc_time = *sTime;
+	rtc_set_ms = HAL_GetTick();
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format) {
+	rtc_date = *sDate;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format) {
+	uint32_t seconds = rtc_time.Hours * 3600u + rtc_time.Minutes * 60u + rtc_time.Seconds
+			+ (HAL_GetTick() - rtc_set_ms) / 1000;
+
+	*sTime = rtc_time;
+	sTime->Hours = (seconds / 3600) % 24;
+	sTime->Minutes = (seconds / 60) % 60;
+	sTime->Seconds = seconds % 60;
+	return HAL_OK;
+}
+
+// the date does not roll over, the firmware only prints the time
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format) {
+	*sDate = rtc_date;
+	return HAL_OK;
+}
+
+uint32_t HAL_RTCEx_BKUPRead(RTC_HandleTypeDef *hrtc, uint32_t BackupRegister) {
+	return rtc_backup[BackupRegister];
+}
+
+void HAL_RTCEx_BKUPWrite(RTC_HandleTypeDef *hrtc, uint32_t BackupRegister, uint32_t Data) {
+	rtc_backup[BackupRegister] = Data;
+}
+
+/* GPIO: outputs latch, inputs read back the latch */
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init) {}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+	if (PinState == GPIO_PIN_SET) {
+		GPIOx->ODR |= GPIO_Pin;
+	}else{
+		GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+	}
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+	GPIOx->ODR ^= GPIO_Pin;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+	return (GPIOx->ODR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin) {}
+
+/* I2C: no register model, see above */
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c) { return HAL_OK; }
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size) { return HAL_ERROR; }
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size) { return HAL_ERROR; }
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size) { return HAL_ERROR; }
+HAL_StatusTypeDef HAL_I2C_Master_Abort_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress) { return HAL_OK; }
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef *hi2c) {}
+void HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef *hi2c) {}
+
+/* Clocks, power, interrupts, DMA and the watchdog have nothing to do here */
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority) { return HAL_OK; }
+void HAL_IncTick(void) {}
+void HAL_SuspendTick(void) {}
+void HAL_ResumeTick(void) {}
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {}
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {}
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn) {}
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct) { return HAL_OK; }
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency) { return HAL_OK; }
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig(RCC_PeriphCLKInitTypeDef *PeriphClkInit) { return HAL_OK; }
+void HAL_RCCEx_EnableMSIPLLMode(void) {}
+void HAL_PWR_EnableBkUpAccess(void) {}
+HAL_StatusTypeDef HAL_PWREx_ControlVoltageScaling(uint32_t VoltageScaling) { return HAL_OK; }
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma) { return HAL_OK; }
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma) {}
+HAL_StatusTypeDef HAL_IWDG_Init(IWDG_HandleTypeDef *hiwdg) { return HAL_OK; }
+HAL_StatusTypeDef HAL_IWDG_Refresh(IWDG_HandleTypeDef *hiwdg) { return HAL_OK; }
@@ -0,0 +1,78 @@
+/*
+ * host_rtos.c
+ *
+ * Purpose: RTOS glue of the host build.
+ * Content:
+ * The CMSIS-RTOS initialisation main.c calls, the static memory of the
+ * idle and timer tasks (cmsis_os2.c provides it on the target), the idle
+ * hook, the timer ending a timed run, assertion handler.
+ *
+ * With SIM_SECONDS set the process exits with status 0 after that many
+ * seconds, so a CI job gets a bounded run and a capture to check. The
+ * timer is a plain pthread with every signal blocked: the POSIX port
+ * drives the tick with SIGALRM, which must only reach the task threads.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cmsis_os.h"
+#include "main.h"
+#include "host_sim.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static StaticTask_t idle_tcb;
+static StackType_t idle_stack[configMINIMAL_STACK_SIZE];
+static StaticTask_t timer_tcb;
+static StackType_t timer_stack[configTIMER_TASK_STACK_DEPTH];
+
+static void *stop_after(void *arg) {
+	long seconds = (long)arg;
+
+	while (HAL_GetTick() < (uint32_t)seconds * 1000) {
+		usleep(100000);
+	}
+	fflush(stdout);
+	exit(0);
+}
+
+osStatus_t osKernelInitialize(void) {
+	long seconds = HOST_EnvLong("SIM_SECONDS", 0);
+	sigset_t all, previous;
+	pthread_t thread;
+
+	if (seconds > 0) {
+		sigfillset(&all);
+		pthread_sigmask(SIG_SETMASK, &all, &previous);
+		pthread_create(&thread, NULL, stop_after, (void *)seconds);
+		pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	}
+	return osOK;
+}
+
+void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer,
+		configSTACK_DEPTH_TYPE *puxIdleTaskStackSize) {
+	*ppxIdleTaskTCBBuffer = &idle_tcb;
+	*ppxIdleTaskStackBuffer = idle_stack;
+	*puxIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+void vApplicationGetTimerTaskMemory(StaticTask_t **ppxTimerTaskTCBBuffer, StackType_t **ppxTimerTaskStackBuffer,
+		configSTACK_DEPTH_TYPE *puxTimerTaskStackSize) {
+	*ppxTimerTaskTCBBuffer = &timer_tcb;
+	*ppxTimerTaskStackBuffer = timer_stack;
+	*puxTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+
+/* Give the host CPU back while nothing is ready */
+void vApplicationIdleHook(void) {
+	usleep(1000);
+}
+
+void vAssertCalled(const char *file, unsigned long line) {
+	fprintf(stderr, "assertion failed at %s:%lu\n", file, line);
+	abort();
+}
@@ -0,0 +1,29 @@
+/*
+ * host_sim.h
+ *
+ * Purpose: Declare the helpers shared by the host stand-ins.
+ * Content:
+ * Environment lookups and the busy wait that emulates blocking peripherals.
+ *
+ * The simulation is configured from the environment, so a CI job or a
+ * benchmark script can vary the signals without rebuilding:
+ * 	SIM_UART		stdout (default), pty or a file to write USART1 to
+ * 	SIM_UART_BAUD	emulated line rate, 0 for no delay (default 115200)
+ * 	SIM_<SENSOR>	signal of a sensor, see host_bsp.c
+ * 	SIM_SEED		noise seed (default 1)
+ * 	SIM_FLASH		file behind the configuration flash (default host_flash.bin)
+ * 	SIM_SECONDS		run time, then exit with status 0 (default: forever)
+ */
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdint.h>
+
+// spin for the duration of a blocking transfer, preemptible by the tick
+void HOST_BusyWait(uint32_t us);
+
+// numeric environment variable, default when unset or empty
+long HOST_EnvLong(const char *name, long value);
+
+#endif
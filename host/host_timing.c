@@ -0,0 +1,43 @@
+/*
+ * host_timing.c
+ *
+ * Purpose: Host version of timing.c.
+ * Content:
+ * Cycle and microsecond clocks on CLOCK_MONOTONIC, busy wait.
+ *
+ * The cycles are counted at the target's SystemCoreClock, so code that
+ * converts cycles to time reads the same on both.
+ */
+
+#include "timing.h"
+#include "host_sim.h"
+#include <time.h>
+
+static uint64_t start_ns;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+void TIMING_Init(void) {
+	start_ns = now_ns();
+}
+
+uint32_t TIMING_Cycles(void) {
+	return (uint32_t)((now_ns() - start_ns) * (SystemCoreClock / 1000000) / 1000);
+}
+
+/* Microseconds since TIMING_Init(), wraps as on the target */
+uint32_t TIMING_Micros(void) {
+	return (uint32_t)((now_ns() - start_ns) / 1000);
+}
+
+void HOST_BusyWait(uint32_t us) {
+	uint64_t end = now_ns() + (uint64_t)us * 1000;
+
+	while (now_ns() < end) {
+	}
+}
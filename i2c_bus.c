@@ -0,0 +1,345 @@
+/*
+ * i2c_bus.c
+ *
+ * Purpose: Own the sensor I2C bus and serve transactions by priority.
+ * Content:
+ * Priority request queues and the bus manager task.
+ * Interrupt/DMA driven register reads and writes on I2C2.
+ * Per priority timing and queue depth statistics.
+ *
+ * Every bus access goes through vI2CBusTask, so there is no bus mutex any
+ * more: a task queues a request, the bus task takes the most urgent one,
+ * runs it and completes it with a task notification (I2C_BUS_NOTIFY_INDEX).
+ * The interrupts complete a transfer to the bus task on the same index,
+ * a timed out transfer is aborted and its late notification consumed.
+ * Register accesses run interrupt driven on our own handle of I2C2, BSP
+ * driver calls (BSP_*_Get/Read, which use the BSP's blocking handle of the
+ * same peripheral) are executed by the bus task as a whole.
+ * The I2C2 and DMA1 channel 5 vectors stay in the generated stm32l4xx_it.c
+ * and call I2C_BUS_EV/ER/DMA_IRQHandler().
+ */
+
+#include "i2c_bus.h"
+#include "timing.h"
+#include "trace.h"
+#include <string.h>
+
+#if configTASK_NOTIFICATION_ARRAY_ENTRIES <= I2C_BUS_NOTIFY_INDEX
+#error "I2C bus manager needs configTASK_NOTIFICATION_ARRAY_ENTRIES >= 2"
+#endif
+
+#define I2C_BUS_TIMING 0x00702681	// same timing as the BSP (DISCOVERY_I2Cx_TIMING)
+
+typedef enum {
+	I2C_OP_READ = 0,
+	I2C_OP_WRITE,
+	I2C_OP_CALL
+} i2c_op;
+
+// lives on the requester's stack until the request is completed
+typedef struct {
+	i2c_op op;
+	uint8_t addr;
+	uint8_t reg;
+	uint8_t *buf;
+	uint16_t len;
+	void (*function)(void *arg);
+	void *arg;
+	TaskHandle_t requester;
+	uint32_t t_submit;
+	int status;
+} i2c_request;
+
+static I2C_HandleTypeDef hi2c_bus;
+static DMA_HandleTypeDef hdma_i2c_rx;
+
+static QueueHandle_t request_queue[I2C_PRIO_COUNT];
+static SemaphoreHandle_t pending;
+static TaskHandle_t bus_task;
+static volatile int transfer_status;
+
+static i2c_bus_stats stats[I2C_PRIO_COUNT];
+static uint32_t busy_total_us;
+static uint32_t window_start_us;
+
+/* Second handle on the I2C2 peripheral that BSP's SENSOR_IO_Init() already
+ * configured (pins, clock, timing); only the interrupt/DMA plumbing is added.
+ * */
+int I2C_BUS_Init(void) {
+	hi2c_bus.Instance = I2C2;
+	hi2c_bus.Init.Timing = I2C_BUS_TIMING;
+	hi2c_bus.Init.OwnAddress1 = 0;
+	hi2c_bus.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+	hi2c_bus.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+	hi2c_bus.Init.OwnAddress2 = 0;
+	hi2c_bus.Init.OwnAddress2Masks = I2C_OA2_NOMASK;
+	hi2c_bus.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+	hi2c_bus.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+	if (HAL_I2C_Init(&hi2c_bus) != HAL_OK) {
+		return FAILURE;
+	}
+
+	// I2C2_RX: DMA1 channel 5, request 3
+	__HAL_RCC_DMA1_CLK_ENABLE();
+	hdma_i2c_rx.Instance = DMA1_Channel5;
+	hdma_i2c_rx.Init.Request = DMA_REQUEST_3;
+	hdma_i2c_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	hdma_i2c_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma_i2c_rx.Init.MemInc = DMA_MINC_ENABLE;
+	hdma_i2c_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_i2c_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	hdma_i2c_rx.Init.Mode = DMA_NORMAL;
+	hdma_i2c_rx.Init.Priority = DMA_PRIORITY_HIGH;
+	if (HAL_DMA_Init(&hdma_i2c_rx) != HAL_OK) {
+		return FAILURE;
+	}
+	__HAL_LINKDMA(&hi2c_bus, hdmarx, hdma_i2c_rx);
+
+	// must not be above configMAX_SYSCALL_INTERRUPT_PRIORITY, the callbacks use the FreeRTOS API
+	HAL_NVIC_SetPriority(I2C2_EV_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(I2C2_EV_IRQn);
+	HAL_NVIC_SetPriority(I2C2_ER_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(I2C2_ER_IRQn);
+	HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+
+	for (int prio = 0; prio < I2C_PRIO_COUNT; prio++) {
+		request_queue[prio] = xQueueCreate(I2C_BUS_QUEUE_SIZE, sizeof(i2c_request*));
+		if (request_queue[prio] == NULL) {
+			return FAILURE;
+		}
+	}
+	pending = xSemaphoreCreateCounting(I2C_PRIO_COUNT * I2C_BUS_QUEUE_SIZE, 0);
+	if (pending == NULL) {
+		return FAILURE;
+	}
+	TRACE_NameQueue("i2c_hi", request_queue[I2C_PRIO_HIGH]);
+	TRACE_NameQueue("i2c_mid", request_queue[I2C_PRIO_NORMAL]);
+	TRACE_NameQueue("i2c_lo", request_queue[I2C_PRIO_LOW]);
+
+	return SUCCESS;
+}
+
+/* Queue a request and sleep until the bus task completed it */
+static int submit(i2c_request *request, i2c_prio prio) {
+	request->requester = xTaskGetCurrentTaskHandle();
+	request->status = FAILURE;
+	request->t_submit = TIMING_Micros();
+
+	if (xQueueSend(request_queue[prio], &request, portMAX_DELAY) != pdPASS) {
+		return FAILURE;
+	}
+
+	UBaseType_t depth = uxQueueMessagesWaiting(request_queue[prio]);
+	if (depth > stats[prio].depth_max) {
+		stats[prio].depth_max = depth;
+	}
+
+	xSemaphoreGive(pending);
+	ulTaskNotifyTakeIndexed(I2C_BUS_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+
+	return request->status;
+}
+
+int I2C_BUS_Read(uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t len, i2c_prio prio) {
+	i2c_request request = { .op = I2C_OP_READ, .addr = addr, .reg = reg, .buf = buf, .len = len };
+
+	return submit(&request, prio);
+}
+
+int I2C_BUS_Write(uint8_t addr, uint8_t reg, uint8_t value, i2c_prio prio) {
+	i2c_request request = { .op = I2C_OP_WRITE, .addr = addr, .reg = reg, .buf = &value, .len = 1 };
+
+	return submit(&request, prio);
+}
+
+/* Run a BSP driver call (e.g. BSP_TSENSOR_ReadTemp) on the bus task */
+int I2C_BUS_Call(void (*function)(void *arg), void *arg, i2c_prio prio) {
+	i2c_request request = { .op = I2C_OP_CALL, .function = function, .arg = arg };
+
+	return submit(&request, prio);
+}
+
+static int transfer(i2c_request *request) {
+	HAL_StatusTypeDef status;
+
+	// completion of an earlier, timed out transfer
+	ulTaskNotifyTakeIndexed(I2C_BUS_NOTIFY_INDEX, pdTRUE, 0);
+
+	transfer_status = FAILURE;
+	if (request->op == I2C_OP_READ && request->len >= I2C_BUS_DMA_THRESHOLD) {
+		status = HAL_I2C_Mem_Read_DMA(&hi2c_bus, request->addr, request->reg, I2C_MEMADD_SIZE_8BIT,
+				request->buf, request->len);
+	}else if (request->op == I2C_OP_READ) {
+		status = HAL_I2C_Mem_Read_IT(&hi2c_bus, request->addr, request->reg, I2C_MEMADD_SIZE_8BIT,
+				request->buf, request->len);
+	}else{
+		status = HAL_I2C_Mem_Write_IT(&hi2c_bus, request->addr, request->reg, I2C_MEMADD_SIZE_8BIT,
+				request->buf, request->len);
+	}
+	if (status != HAL_OK) {
+		return FAILURE;
+	}
+
+	if (ulTaskNotifyTakeIndexed(I2C_BUS_NOTIFY_INDEX, pdTRUE, pdMS_TO_TICKS(I2C_BUS_TIMEOUT_MS)) == 0) {
+		/* A late completion or the abort notifies once more: it is taken
+		 * here, or dropped before the next transfer, so that one never
+		 * returns early with its buffer unfilled.
+		 * */
+		if (HAL_I2C_Master_Abort_IT(&hi2c_bus, request->addr) == HAL_OK) {
+			ulTaskNotifyTakeIndexed(I2C_BUS_NOTIFY_INDEX, pdTRUE, pdMS_TO_TICKS(I2C_BUS_TIMEOUT_MS));
+		}
+		return FAILURE;
+	}
+	return transfer_status;
+}
+
+/***********************************************
+ * Bus manager task:
+ * 	serve queued transactions, most urgent
+ * 	priority first, FIFO within a priority.
+ ***********************************************/
+void vI2CBusTask(void *pvParameters) {
+	i2c_request *request;
+
+	bus_task = xTaskGetCurrentTaskHandle();
+	window_start_us = TIMING_Micros();
+
+	for (;;) {
+		xSemaphoreTake(pending, portMAX_DELAY);
+
+		int prio;
+		for (prio = 0; prio < I2C_PRIO_COUNT; prio++) {
+			if (xQueueReceive(request_queue[prio], &request, 0) == pdPASS) {
+				break;
+			}
+		}
+		if (prio == I2C_PRIO_COUNT) {
+			continue;
+		}
+
+		uint32_t t_start = TIMING_Micros();
+		TRACE_Record(TRACE_I2C_START, prio, request->op == I2C_OP_CALL ? 0 : request->addr);
+
+		if (request->op == I2C_OP_CALL) {
+			request->function(request->arg);
+			request->status = SUCCESS;
+		}else{
+			request->status = transfer(request);
+		}
+
+		TRACE_Record(TRACE_I2C_DONE, prio, request->status);
+		uint32_t t_end = TIMING_Micros();
+		uint32_t wait = t_start - request->t_submit;
+		uint32_t busy = t_end - t_start;
+		i2c_bus_stats *st = &stats[prio];
+
+		st->count++;
+		if (request->status != SUCCESS) { st->errors++; }
+		st->wait_sum_us += wait;
+		if (wait > st->wait_max_us) { st->wait_max_us = wait; }
+		st->busy_sum_us += busy;
+		if (busy > st->busy_max_us) { st->busy_max_us = busy; }
+		busy_total_us += busy;
+
+		xTaskNotifyGiveIndexed(request->requester, I2C_BUS_NOTIFY_INDEX);
+	}
+}
+
+void I2C_BUS_GetStats(i2c_prio prio, i2c_bus_stats *out) {
+	taskENTER_CRITICAL();
+	*out = stats[prio];
+	taskEXIT_CRITICAL();
+}
+
+/* Bus busy time since the last report, in 0.1 % */
+uint32_t I2C_BUS_Utilization(void) {
+	uint32_t window = TIMING_Micros() - window_start_us;
+
+	if (window == 0) {
+		return 0;
+	}
+	return (uint32_t)((uint64_t)busy_total_us * 1000 / window);
+}
+
+/* One line per priority:
+ * 	<prio> n=<count> err=<errors> wait <avg>/<max> busy <avg>/<max> q<depth_max>
+ * times in microseconds, then the bus utilization. Counters restart afterwards.
+ * */
+void I2C_BUS_Report(void) {
+	static const char *const prio_name[I2C_PRIO_COUNT] = { "hi", "mid", "lo" };
+	char message[MAX_MESSAGE_LENGTH];
+	i2c_bus_stats st;
+
+	for (int prio = 0; prio < I2C_PRIO_COUNT; prio++) {
+		I2C_BUS_GetStats(prio, &st);
+		if (st.count == 0) {
+			continue;
+		}
+		snprintf(message, sizeof(message), "I2C %s n=%lu err=%lu wait %lu/%lu busy %lu/%lu q%lu\r\n",
+				prio_name[prio], (unsigned long)st.count, (unsigned long)st.errors,
+				(unsigned long)(st.wait_sum_us / st.count), (unsigned long)st.wait_max_us,
+				(unsigned long)(st.busy_sum_us / st.count), (unsigned long)st.busy_max_us, (unsigned long)st.depth_max);
+		send_uart_message(message);
+	}
+
+	uint32_t utilization = I2C_BUS_Utilization();
+	snprintf(message, sizeof(message), "I2C bus busy %lu.%lu%%\r\n",
+			(unsigned long)(utilization / 10), (unsigned long)(utilization % 10));
+	send_uart_message(message);
+
+	taskENTER_CRITICAL();
+	memset(stats, 0, sizeof(stats));
+	busy_total_us = 0;
+	window_start_us = TIMING_Micros();
+	taskEXIT_CRITICAL();
+}
+
+static void complete_from_isr(int status) {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	transfer_status = status;
+	if (bus_task != NULL) {
+		vTaskNotifyGiveIndexedFromISR(bus_task, I2C_BUS_NOTIFY_INDEX, &xHigherPriorityTaskWoken);
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+	if (hi2c == &hi2c_bus) {
+		complete_from_isr(SUCCESS);
+	}
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c) {
+	if (hi2c == &hi2c_bus) {
+		complete_from_isr(SUCCESS);
+	}
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+	if (hi2c == &hi2c_bus) {
+		complete_from_isr(FAILURE);
+	}
+}
+
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c) {
+	if (hi2c == &hi2c_bus) {
+		complete_from_isr(FAILURE);
+	}
+}
+
+/* Called by I2C2_EV_IRQHandler() in stm32l4xx_it.c (i2c_bus.h) */
+void I2C_BUS_EV_IRQHandler(void) {
+	HAL_I2C_EV_IRQHandler(&hi2c_bus);
+}
+
+/* Called by I2C2_ER_IRQHandler() in stm32l4xx_it.c */
+void I2C_BUS_ER_IRQHandler(void) {
+	HAL_I2C_ER_IRQHandler(&hi2c_bus);
+}
+
+/* Called by DMA1_Channel5_IRQHandler() in stm32l4xx_it.c */
+void I2C_BUS_DMA_IRQHandler(void) {
+	HAL_DMA_IRQHandler(&hdma_i2c_rx);
+}
@@ -0,0 +1,64 @@
+/*
+ * i2c_bus.h
+ *
+ * Purpose: Declare the I2C bus manager.
+ * Content:
+ * Transaction priorities, request functions for the sensor code,
+ * bus manager task and statistics.
+ */
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include "sensors.h"
+
+// task notification index used to complete a request and, on the bus task, a transfer;
+// index 0 stays free for data-ready events
+#define I2C_BUS_NOTIFY_INDEX 1
+
+// pending requests per priority
+#define I2C_BUS_QUEUE_SIZE 8
+
+// reads of at least this many bytes use DMA instead of one interrupt per byte
+#define I2C_BUS_DMA_THRESHOLD 16
+
+// a transaction not completed within this time is aborted and counted as error
+#define I2C_BUS_TIMEOUT_MS 20
+
+typedef enum {
+	I2C_PRIO_HIGH = 0,		// high rate motion sensors
+	I2C_PRIO_NORMAL,
+	I2C_PRIO_LOW,			// slow environmental sensors
+	I2C_PRIO_COUNT
+} i2c_prio;
+
+typedef struct {
+	uint32_t count;			// completed transactions
+	uint32_t errors;		// failed or timed out transactions
+	uint32_t wait_sum_us;	// submit -> start of transaction
+	uint32_t wait_max_us;
+	uint32_t busy_sum_us;	// start -> end of transaction
+	uint32_t busy_max_us;
+	uint32_t depth_max;		// deepest the queue of this priority has been
+} i2c_bus_stats;
+
+int I2C_BUS_Init(void);
+void vI2CBusTask(void *pvParameters);
+
+int I2C_BUS_Read(uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t len, i2c_prio prio);
+int I2C_BUS_Write(uint8_t addr, uint8_t reg, uint8_t value, i2c_prio prio);
+int I2C_BUS_Call(void (*function)(void *arg), void *arg, i2c_prio prio);
+
+/* Interrupt handlers of the transfers, the vectors stay in the generated
+ * stm32l4xx_it.c: add I2C2_EV_IRQHandler(), I2C2_ER_IRQHandler() and
+ * DMA1_Channel5_IRQHandler() calling these (README, "Set up the project")
+ * */
+void I2C_BUS_EV_IRQHandler(void);
+void I2C_BUS_ER_IRQHandler(void);
+void I2C_BUS_DMA_IRQHandler(void);
+
+void I2C_BUS_GetStats(i2c_prio prio, i2c_bus_stats *stats);
+uint32_t I2C_BUS_Utilization(void);
+void I2C_BUS_Report(void);
+
+#endif
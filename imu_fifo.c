@@ -0,0 +1,359 @@
+/*
+ * imu_fifo.c
+ *
+ * Purpose: Acquire accelerometer, gyroscope and magnetometer data in blocks.
+ * Content:
+ * LSM6DSL FIFO and output data rate configuration.
+ * Watermark interrupt (INT1) handling and burst I2C reads of whole FIFO blocks.
+ * Magnetometer burst read of all three axes in the same wake.
+ *
+ * Used instead of vAccelSensorTask, vGyroSensorTask and vMagSensorTask when
+ * ACQ_MODE is ACQ_MODE_HWFIFO: one I2C transaction moves up to
+ * IMU_FIFO_WATERMARK accel+gyro sample sets instead of one sample per wake.
+ * The LIS3MDL has no FIFO, it is read with a single 6 byte burst per block.
+ * Statistics, detectors and the spectrum see every sample set; the software
+ * FIFOs get one sample per block, the mean of its sets stamped at the
+ * middle of the block, which is all the scheduler can print. Samples that
+ * do not fit are counted (FIFO lost in the system monitor report) instead
+ * of printed from here.
+ */
+
+#include "imu_fifo.h"
+#include "latency.h"
+#include "timing.h"
+#include "i2c_bus.h"
+#include "dsp_kernels.h"
+#include "boot_profile.h"
+#include "supervisor.h"
+#include "rules.h"
+#include "stats.h"
+#include "anomaly.h"
+#include "vibration.h"
+#include "cep.h"
+#include <math.h>
+#include <string.h>
+
+#define LSM6DSL_ADDR			0xD4	// LSM6DSL_ACC_GYRO_I2C_ADDRESS_LOW
+#define LSM6DSL_FIFO_CTRL1		0x06
+#define LSM6DSL_FIFO_CTRL2		0x07
+#define LSM6DSL_FIFO_CTRL3		0x08
+#define LSM6DSL_FIFO_CTRL5		0x0A
+#define LSM6DSL_INT1_CTRL		0x0D
+#define LSM6DSL_CTRL1_XL		0x10
+#define LSM6DSL_CTRL2_G			0x11
+#define LSM6DSL_CTRL3_C			0x12
+#define LSM6DSL_FIFO_STATUS1	0x3A
+#define LSM6DSL_FIFO_DATA_OUT_L	0x3E
+
+#define LSM6DSL_CTRL3_BDU		0x40
+#define LSM6DSL_CTRL3_IF_INC	0x04
+#define LSM6DSL_FIFO_CONTINUOUS	0x06
+#define LSM6DSL_INT1_FTH		0x08
+#define LSM6DSL_DEC_NONE		0x09	// gyro and accel both in the FIFO, no decimation
+#define LSM6DSL_FS_XL_2G		0x00
+#define LSM6DSL_FS_G_2000		0x0C
+#define LSM6DSL_STATUS2_OVER_RUN 0x40
+
+#define LIS3MDL_ADDR			0x3C	// LIS3MDL_MAG_I2C_ADDRESS_HIGH
+#define LIS3MDL_OUT_X_L			0x28
+#define LIS3MDL_AUTO_INCREMENT	0x80
+
+// one FIFO pattern: gyro X/Y/Z then accel X/Y/Z, 16 bit words
+#define WORDS_PER_SET			6
+
+// sensitivities of the full scales selected above and by BSP_MAGNETO_Init()
+#define ACCEL_MG_PER_LSB		0.061f
+#define GYRO_MDPS_PER_LSB		70.0f
+#define MAG_MGAUSS_PER_LSB		0.14f
+#define GRAVITY					9.8f
+
+// the LSM6DSL FIFO may hold up to two watermarks when the block is read
+#define MAX_SETS				(IMU_FIFO_WATERMARK * 2)
+
+static TaskHandle_t imu_task;
+static uint8_t block[MAX_SETS * WORDS_PER_SET * 2];
+
+// converted block, x,y,z per set, and its squared magnitudes
+static float accel_xyz[MAX_SETS * 3];
+static float gyro_xyz[MAX_SETS * 3];
+static float accel_sq[MAX_SETS];
+static float gyro_sq[MAX_SETS];
+
+static Data3Axis accel_buffer[IMU_SW_FIFO_SIZE];
+static Data3Axis gyro_buffer[IMU_SW_FIFO_SIZE];
+static Data3Axis mag_buffer[IMU_SW_FIFO_SIZE];
+
+// blocks the LSM6DSL FIFO overran before it was read
+static volatile int overruns;
+
+/* LSM6DSL ODR field for a rate in Hz, rounded up to the next supported rate */
+static uint8_t odr_code(int hz) {
+	static const int rates[] = { 13, 26, 52, 104, 208, 416, 833, 1660, 3330, 6660 };
+
+	for (int i = 0; i < (int)(sizeof(rates) / sizeof(rates[0])); i++) {
+		if (hz <= rates[i]) {
+			return i + 1;
+		}
+	}
+	return 10;
+}
+
+/* Configure the LSM6DSL after BSP_ACCELERO_Init()/BSP_GYRO_Init():
+ * 	both ODRs and the FIFO ODR at IMU_FIFO_ODR_HZ,
+ * 	continuous FIFO mode, INT1 on FIFO threshold,
+ * 	EXTI on the INT1 line (PD11).
+ * */
+int IMU_FIFO_Init(void) {
+	uint8_t odr = odr_code(IMU_FIFO_ODR_HZ);
+	uint16_t threshold = IMU_FIFO_WATERMARK * WORDS_PER_SET;
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	accel_fifo.data = accel_buffer;
+	accel_fifo.size = IMU_SW_FIFO_SIZE;
+	accel_fifo.id = SENSOR_ACCEL;
+	FIFO_Init_3Axis(&accel_fifo);
+	gyro_fifo.data = gyro_buffer;
+	gyro_fifo.size = IMU_SW_FIFO_SIZE;
+	gyro_fifo.id = SENSOR_GYRO;
+	FIFO_Init_3Axis(&gyro_fifo);
+	mag_fifo.data = mag_buffer;
+	mag_fifo.size = IMU_SW_FIFO_SIZE;
+	mag_fifo.id = SENSOR_MAG;
+	FIFO_Init_3Axis(&mag_fifo);
+
+	VIB_Init(IMU_FIFO_ODR_HZ);
+
+	// one software FIFO sample per block, read by the predictive scheduler
+	accel.interval = 1000 * IMU_FIFO_WATERMARK / IMU_FIFO_ODR_HZ + 1;
+	gyro.interval = accel.interval;
+	mag.interval = accel.interval;
+
+	// paced by the sensor, not adapted
+	accel.min_interval = gyro.min_interval = mag.min_interval = 0;
+	accel.effective_interval = accel.interval;
+	gyro.effective_interval = gyro.interval;
+	mag.effective_interval = mag.interval;
+
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_CTRL3_C, LSM6DSL_CTRL3_BDU | LSM6DSL_CTRL3_IF_INC);
+
+	// bypass mode empties the FIFO before it is reconfigured
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_FIFO_CTRL5, 0x00);
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_CTRL1_XL, (odr << 4) | LSM6DSL_FS_XL_2G);
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_CTRL2_G, (odr << 4) | LSM6DSL_FS_G_2000);
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_FIFO_CTRL1, threshold & 0xFF);
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_FIFO_CTRL2, (threshold >> 8) & 0x07);
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_FIFO_CTRL3, LSM6DSL_DEC_NONE);
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_INT1_CTRL, LSM6DSL_INT1_FTH);
+	SENSOR_IO_Write(LSM6DSL_ADDR, LSM6DSL_FIFO_CTRL5, (odr << 3) | LSM6DSL_FIFO_CONTINUOUS);
+
+	__HAL_RCC_GPIOD_CLK_ENABLE();
+	GPIO_InitStruct.Pin = LSM6DSL_INT1_EXTI11_Pin;
+	GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	HAL_GPIO_Init(LSM6DSL_INT1_EXTI11_GPIO_Port, &GPIO_InitStruct);
+
+	// must not be above configMAX_SYSCALL_INTERRUPT_PRIORITY, the ISR uses the FreeRTOS API
+	HAL_NVIC_SetPriority(LSM6DSL_INT1_EXTI11_EXTI_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(LSM6DSL_INT1_EXTI11_EXTI_IRQn);
+
+	return SUCCESS;
+}
+
+/* Called from the EXTI callback (drdy.c) when INT1 rises (FIFO above watermark) */
+void IMU_FIFO_IRQHandler(BaseType_t *pxHigherPriorityTaskWoken) {
+	if (imu_task != NULL) {
+		vTaskNotifyGiveFromISR(imu_task, pxHigherPriorityTaskWoken);
+	}
+}
+
+/* RTC time stamp of a sample taken ms_ago milliseconds before now */
+static void stamp(Data3Axis *data, uint32_t ms_ago) {
+	int32_t ms = sTime.Hours * 3600000L + sTime.Minutes * 60000L + sTime.Seconds * 1000L
+			+ milliseconds - (int32_t)ms_ago;
+
+	if (ms < 0) {
+		ms += 24 * 3600000L;
+	}
+	data->Hours = ms / 3600000L;
+	data->Minutes = (ms / 60000L) % 60;
+	data->Seconds = (ms / 1000L) % 60;
+	data->milliSeconds = ms % 1000L;
+}
+
+static int16_t word_at(const uint8_t *bytes, int index) {
+	return (int16_t)(bytes[2 * index] | (bytes[2 * index + 1] << 8));
+}
+
+/* A full FIFO counts the sample as lost (sysmon.c) */
+static void store(FIFO3Axis *fifo, sensor_id sensor, Data3Axis *data, uint32_t t_sample) {
+	data->timestamp = TIMING_Micros();
+	if (FIFO_Write_3Axis(fifo, *data)) {
+		LAT_Record(sensor, LAT_STAGE_SAMPLE_TO_FIFO, data->timestamp - t_sample);
+		BOOT_FirstSample(sensor);
+	}
+}
+
+/* Mean of the block's sets, stamped at the middle of the block */
+static void store_mean(FIFO3Axis *fifo, sensor_id sensor, Data3Axis *sum, int sets, float period_ms,
+		uint32_t t_sample) {
+	sum->x /= sets;
+	sum->y /= sets;
+	sum->z /= sets;
+	stamp(sum, (uint32_t)((sets - 1) * period_ms / 2));
+	store(fifo, sensor, sum, t_sample);
+}
+
+/* LSM6DSL FIFO overruns since the last call (system monitor report) */
+int IMU_FIFO_TakeOverruns(void) {
+	int count = overruns;
+
+	overruns -= count;
+	return count;
+}
+
+/***********************************************
+ * Motion acquisition task:
+ * 	sleep until the LSM6DSL FIFO reaches its
+ * 	watermark, then move the whole FIFO content
+ * 	with one burst read.
+ ***********************************************/
+void vImuFifoTask(void *pvParameters) {
+	// expected time between two watermarks, doubled as timeout in case an edge is missed
+	const TickType_t block_ticks = pdMS_TO_TICKS(1000 * IMU_FIFO_WATERMARK / IMU_FIFO_ODR_HZ + 1);
+	const float period_ms = 1000.0f / IMU_FIFO_ODR_HZ;
+
+	uint8_t status[4];
+	uint8_t mag_raw[6];
+	Data3Axis mag_data;
+	Data3Axis accel_sum, gyro_sum;
+	uint32_t t_sample;
+
+	imu_task = xTaskGetCurrentTaskHandle();
+	int supervised_id = SUPERVISOR_Register("IMU", 1, 3 * SUPERVISOR_SENSOR_BUDGET_US);
+
+	for (;;) {
+		// one watermark interrupt per block
+		SUPERVISOR_End(supervised_id, xTaskGetTickCount() + block_ticks, block_ticks);
+		ulTaskNotifyTake(pdTRUE, 2 * block_ticks);
+		SUPERVISOR_Begin(supervised_id);
+
+		// between two blocks, console changes of the motion sensors
+		SENSOR_ApplyConfig(SENSOR_ACCEL);
+		SENSOR_ApplyConfig(SENSOR_GYRO);
+		SENSOR_ApplyConfig(SENSOR_MAG);
+
+		int sets = 0;
+
+		// FIFO_STATUS1..4: unread words, flags, position in the gyro/accel pattern
+		if (I2C_BUS_Read(LSM6DSL_ADDR, LSM6DSL_FIFO_STATUS1, status, sizeof(status), I2C_PRIO_HIGH) != SUCCESS) {
+			continue;
+		}
+
+		int words = status[0] | ((status[1] & 0x07) << 8);
+		int pattern = status[2] | ((status[3] & 0x03) << 8);
+		if (status[1] & LSM6DSL_STATUS2_OVER_RUN) {
+			overruns++;
+		}
+
+		/* re-align to the start of a pattern, the words read here are dropped;
+		 * if that read fails the position is unknown and the block is left
+		 * in the FIFO, the next wake reads the pattern position again
+		 * */
+		int skip = (WORDS_PER_SET - pattern) % WORDS_PER_SET;
+		if (skip > 0 && words >= skip) {
+			if (I2C_BUS_Read(LSM6DSL_ADDR, LSM6DSL_FIFO_DATA_OUT_L, block, 2 * skip, I2C_PRIO_HIGH) != SUCCESS) {
+				words = 0;
+			}else{
+				words -= skip;
+			}
+		}
+
+		sets = words / WORDS_PER_SET;
+		if (sets > MAX_SETS) {
+			sets = MAX_SETS;
+		}
+
+		/* FIFO_DATA_OUT_H rolls back to FIFO_DATA_OUT_L on the LSM6DSL,
+		 * so the whole block is a single auto-increment (DMA) read.
+		 * */
+		if (sets > 0 && I2C_BUS_Read(LSM6DSL_ADDR, LSM6DSL_FIFO_DATA_OUT_L, block,
+				sets * WORDS_PER_SET * 2, I2C_PRIO_HIGH) != SUCCESS) {
+			sets = 0;
+		}
+		int mag_ok = I2C_BUS_Read(LIS3MDL_ADDR, LIS3MDL_OUT_X_L | LIS3MDL_AUTO_INCREMENT, mag_raw,
+				sizeof(mag_raw), I2C_PRIO_NORMAL) == SUCCESS;
+		t_sample = TIMING_Micros();
+
+		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
+		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
+
+		float accel_max = 0, gyro_max = 0;
+		memset(&accel_sum, 0, sizeof(accel_sum));
+		memset(&gyro_sum, 0, sizeof(gyro_sum));
+
+		for (int i = 0; i < sets; i++) {
+			const uint8_t *set = &block[i * WORDS_PER_SET * 2];
+			float *g = &gyro_xyz[3 * i];
+			float *a = &accel_xyz[3 * i];
+
+			g[0] = word_at(set, 0) * GYRO_MDPS_PER_LSB / 1000.0f;
+			g[1] = word_at(set, 1) * GYRO_MDPS_PER_LSB / 1000.0f;
+			g[2] = word_at(set, 2) * GYRO_MDPS_PER_LSB / 1000.0f;
+			a[0] = word_at(set, 3) * ACCEL_MG_PER_LSB * GRAVITY / 1000.0f;
+			a[1] = word_at(set, 4) * ACCEL_MG_PER_LSB * GRAVITY / 1000.0f;
+			a[2] = word_at(set, 5) * ACCEL_MG_PER_LSB * GRAVITY / 1000.0f;
+			accel_sum.x += a[0];
+			accel_sum.y += a[1];
+			accel_sum.z += a[2];
+			gyro_sum.x += g[0];
+			gyro_sum.y += g[1];
+			gyro_sum.z += g[2];
+		}
+
+		// squared magnitudes of the whole block in one kernel call each
+		DSP_MagSqBatch_f32(accel_xyz, accel_sq, sets);
+		DSP_MagSqBatch_f32(gyro_xyz, gyro_sq, sets);
+
+		for (int i = 0; i < sets; i++) {
+			if (accel_sq[i] > accel_max) { accel_max = accel_sq[i]; }
+			if (gyro_sq[i] > gyro_max) { gyro_max = gyro_sq[i]; }
+			float a = sqrtf(accel_sq[i]);
+			float g = sqrtf(gyro_sq[i]);
+			STATS_Add(SENSOR_ACCEL, a);
+			STATS_Add(SENSOR_GYRO, g);
+			CEP_Update(SENSOR_ACCEL, a);
+			CEP_Update(SENSOR_GYRO, g);
+			VIB_AddSample(&accel_xyz[3 * i]);
+		}
+		if (sets > 0) {
+			// the detectors see one value per block: a single 416 Hz sample is not a shock
+			ANOMALY_Update(SENSOR_ACCEL, sqrtf(accel_max));
+			ANOMALY_Update(SENSOR_GYRO, sqrtf(gyro_max));
+			store_mean(&accel_fifo, SENSOR_ACCEL, &accel_sum, sets, period_ms, t_sample);
+			store_mean(&gyro_fifo, SENSOR_GYRO, &gyro_sum, sets, period_ms, t_sample);
+		}
+
+		// rules run once per block on the largest squared magnitude, instead of once per sample
+		if (sets > 0) {
+			RULES_EvaluateSq(SENSOR_ACCEL, accel_max);
+			RULES_EvaluateSq(SENSOR_GYRO, gyro_max);
+		}
+
+		// a failed magnetometer read leaves mag_raw undefined, this block has no mag sample
+		if (!mag_ok) {
+			continue;
+		}
+		mag_data.x = word_at(mag_raw, 0) * MAG_MGAUSS_PER_LSB / 1000.0f;
+		mag_data.y = word_at(mag_raw, 1) * MAG_MGAUSS_PER_LSB / 1000.0f;
+		mag_data.z = word_at(mag_raw, 2) * MAG_MGAUSS_PER_LSB / 1000.0f;
+		stamp(&mag_data, 0);
+		float m_sq = DSP_MagSq_f32(&mag_data.x);
+		float m = sqrtf(m_sq);
+		STATS_Add(SENSOR_MAG, m);
+		ANOMALY_Update(SENSOR_MAG, m);
+		CEP_Update(SENSOR_MAG, m);
+		store(&mag_fifo, SENSOR_MAG, &mag_data, t_sample);
+		RULES_EvaluateSq(SENSOR_MAG, m_sq);
+	}
+}
+
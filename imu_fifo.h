@@ -0,0 +1,34 @@
+/*
+ * imu_fifo.h
+ *
+ * Purpose: Declare the burst acquisition mode of the motion sensors.
+ * Content:
+ * LSM6DSL FIFO configuration parameters and the motion acquisition task.
+ */
+
+#ifndef IMU_FIFO_H
+#define IMU_FIFO_H
+
+#include "sensors.h"
+
+// accelerometer and gyroscope output data rate in Hz: 13/26/52/104/208/416/833/1660/3330/6660
+#ifndef IMU_FIFO_ODR_HZ
+#define IMU_FIFO_ODR_HZ 416
+#endif
+
+// accel+gyro sample sets collected by the LSM6DSL before it raises INT1
+#ifndef IMU_FIFO_WATERMARK
+#define IMU_FIFO_WATERMARK 32
+#endif
+
+// size of the software FIFOs filled by the burst reads
+#ifndef IMU_SW_FIFO_SIZE
+#define IMU_SW_FIFO_SIZE MOTION_FIFO_SIZE
+#endif
+
+int IMU_FIFO_Init(void);
+void vImuFifoTask(void *pvParameters);
+void IMU_FIFO_IRQHandler(BaseType_t *pxHigherPriorityTaskWoken);
+int IMU_FIFO_TakeOverruns(void);
+
+#endif
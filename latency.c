@@ -0,0 +1,125 @@
+/*
+ * latency.c
+ *
+ * Purpose: Record where the time goes between a sensor read and the UART.
+ * Content:
+ * Log bucketed latency histograms for every sensor and pipeline stage.
+ * Percentile (p50/p90/p99/max) reporting over UART.
+ *
+ * Recording is a count-leading-zeros and an increment, so it stays enabled
+ * in production. Every histogram is only written by a single task (the
+ * sensor task, the scheduler or the UART task), the reporter reads them
+ * without locking and at worst misses a sample that is being recorded.
+ */
+
+#include "latency.h"
+#include <string.h>
+
+static lat_histogram histograms[SENSOR_COUNT][LAT_STAGE_COUNT];
+
+static const char *const stage_name[LAT_STAGE_COUNT] = {
+	"smp>fifo",
+	"fifo>deq",
+	"deq>uart",
+	"alm>out"
+};
+
+void LAT_Init(void) {
+	LAT_Reset();
+}
+
+void LAT_Reset(void) {
+	memset(histograms, 0, sizeof(histograms));
+}
+
+/* bucket index:
+ * 	0 and 1 map to themselves, above that every power of two 2^msb
+ * 	is split in two halves by the bit below the msb.
+ * */
+static int bucket_of(uint32_t us) {
+	if (us < 2) {
+		return us;
+	}
+	int msb = 31 - __CLZ(us);
+	if (msb > LAT_MAX_MSB) {
+		return LAT_BUCKETS - 1;
+	}
+	return 2 * msb + ((us >> (msb - 1)) & 1);
+}
+
+// largest value that still falls into the bucket
+static uint32_t bucket_upper(int index) {
+	if (index < 2) {
+		return index;
+	}
+	int msb = index / 2;
+	uint32_t lower = (1UL << msb) | ((uint32_t)(index & 1) << (msb - 1));
+	return lower + (1UL << (msb - 1)) - 1;
+}
+
+/* Record into any histogram, e.g. the execution times of supervisor.c */
+void LAT_Add(lat_histogram *hist, uint32_t us) {
+	hist->buckets[bucket_of(us)]++;
+	hist->count++;
+	if (us > hist->max) {
+		hist->max = us;
+	}
+}
+
+#if LAT_ENABLE
+void LAT_Record(sensor_id sensor, lat_stage stage, uint32_t us) {
+	LAT_Add(&histograms[sensor][stage], us);
+}
+#endif
+
+/* Upper edge of the bucket that holds the given percentile,
+ * i.e. at most ~41% (half an octave) above the exact value, never above max.
+ * */
+uint32_t LAT_Percentile(const lat_histogram *hist, uint32_t percent) {
+	if (hist->count == 0) {
+		return 0;
+	}
+
+	uint32_t rank = (hist->count * (uint64_t)percent + 99) / 100;
+	uint32_t seen = 0;
+
+	for (int i = 0; i < LAT_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank) {
+			uint32_t upper = bucket_upper(i);
+			return upper < hist->max ? upper : hist->max;
+		}
+	}
+	return hist->max;
+}
+
+/* Send one line per sensor and stage that recorded anything:
+ * 	<sensor> <stage> n=<count> <p50>/<p90>/<p99>/<max>
+ * all values in microseconds. With reset set the histograms are cleared
+ * afterwards, so periodic reports describe the last interval only.
+ * */
+void LAT_Report(int reset) {
+	char message[50];
+	lat_histogram snapshot;
+
+	sprintf(message, "Latency p50/p90/p99/max (us):\r\n");
+	send_uart_message(message);
+
+	for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+		for (int stage = 0; stage < LAT_STAGE_COUNT; stage++) {
+			snapshot = histograms[sensor][stage];
+			if (snapshot.count == 0) {
+				continue;
+			}
+			snprintf(message, sizeof(message), "%s %s n=%lu %lu/%lu/%lu/%lu\r\n",
+					sensor_name[sensor], stage_name[stage], (unsigned long)snapshot.count,
+					(unsigned long)LAT_Percentile(&snapshot, 50), (unsigned long)LAT_Percentile(&snapshot, 90),
+					(unsigned long)LAT_Percentile(&snapshot, 99), (unsigned long)snapshot.max);
+			send_uart_message(message);
+		}
+	}
+
+	if (reset) {
+		LAT_Reset();
+	}
+}
@@ -0,0 +1,56 @@
+/*
+ * latency.h
+ *
+ * Purpose: Declare the latency instrumentation subsystem.
+ * Content:
+ * Per sensor, per stage latency histograms and their reporting functions.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "sensors.h"
+
+// set to 0 to compile all LAT_Record() calls out
+#ifndef LAT_ENABLE
+#define LAT_ENABLE 1
+#endif
+
+// period of the latency report sent by the scheduler, 0 disables it
+#ifndef LAT_REPORT_INTERVAL_MS
+#define LAT_REPORT_INTERVAL_MS 60000
+#endif
+
+/* Two buckets per power of two (half octaves), the last bucket also
+ * collects everything above 2^23 us (~8 s).
+ * */
+#define LAT_MAX_MSB 23
+#define LAT_BUCKETS (2 * (LAT_MAX_MSB + 1))
+
+typedef enum {
+	LAT_STAGE_SAMPLE_TO_FIFO = 0,	// sensor read done -> sample written to its FIFO
+	LAT_STAGE_FIFO_TO_DEQUEUE,		// written to FIFO -> taken out by the scheduler
+	LAT_STAGE_DEQUEUE_TO_UART,		// taken out by the scheduler -> UART transmit complete
+	LAT_STAGE_ALARM,				// abnormal reading detected -> response actions done (event.c)
+	LAT_STAGE_COUNT
+} lat_stage;
+
+typedef struct {
+	uint32_t count;
+	uint32_t max;
+	uint32_t buckets[LAT_BUCKETS];
+} lat_histogram;
+
+void LAT_Init(void);
+void LAT_Reset(void);
+void LAT_Add(lat_histogram *hist, uint32_t us);
+uint32_t LAT_Percentile(const lat_histogram *hist, uint32_t percent);
+void LAT_Report(int reset);
+
+#if LAT_ENABLE
+void LAT_Record(sensor_id sensor, lat_stage stage, uint32_t us);
+#else
+#define LAT_Record(sensor, stage, us) ((void)0)
+#endif
+
+#endif
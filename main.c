@@ -16,12 +16,35 @@
 #include "event_groups.h"
 #include "sensors.h"
 #include "scheduler.h"
+#include "imu_fifo.h"
+#include "acq_engine.h"
+#include "rules.h"
+#include "stats.h"
+#include "anomaly.h"
+#include "adaptive.h"
+#include "deadband.h"
+#include "filter.h"
+#include "event.h"
+#include "alarm_mgr.h"
+#include "cep.h"
+#include "sysmon.h"
+#include "console.h"
+#include "config_store.h"
+#include "boot_profile.h"
+#include "supervisor.h"
+#include "drdy.h"
+#include "i2c_bus.h"
+#include "latency.h"
+#include "timing.h"
+#include "trace.h"
 #include "cmsis_os.h"
 #include "string.h"
 
 UART_HandleTypeDef huart1;
 
 QueueHandle_t uartQueue;
+// one transmission at a time on USART1: queued lines (UART_Task) or the alarm lane
+SemaphoreHandle_t uartMutex;
 
 /*
  * Notes on RTC:
@@ -37,14 +60,27 @@ RTC_HandleTypeDef hrtc;
 RTC_TimeTypeDef sTime;
 RTC_DateTypeDef sDate;
 
-uint16_t milliseconds = 0;
+/* RTC backup register DR0, kept through a reset as long as VDD or VBAT is:
+ * the calendar runs from the first power-up (counting from 00:00:00) or
+ * was set to the time of day with rtc_set_time()
+ * */
+#define RTC_BKP_RUNNING		0x32F2
+#define RTC_BKP_TIME_OF_DAY	0x32F3
+
+static volatile int rtc_time_of_day;
 
-// Define the maximum message length
-#define MAX_MESSAGE_LENGTH 50
+uint16_t milliseconds = 0;
 
 // Define the Queue Size
 #define QUEUE_SIZE 20
 
+// UART queue entry, sensor lines carry when they left their FIFO
+typedef struct {
+	int8_t sensor;			// sensor_id of a sample line, -1 for any other message
+	uint32_t dequeue_us;	// TIMING_Micros() when the scheduler read the sample
+	char text[MAX_MESSAGE_LENGTH];
+} uart_message;
+
 static void USART1_UART_Init(void);
 static void SystemClock_Config(void);
 static void MX_RTC_Init(void);
@@ -67,13 +103,10 @@ void Error_Handler(void)
 
 // UART Task that will handle all UART transmissions
 void UART_Task(void *pvParameters) {
-    char queueBuffer[MAX_MESSAGE_LENGTH];
-    int stampHours, stampMinutes, stampSeconds;
-    uint16_t stampmilliSeconds;
+    uart_message queueBuffer;
     uint16_t ms;
 
-    int response_delay;
-    char message[70];
+    char message[MAX_MESSAGE_LENGTH + 16];
 
     while (1) {
         // Wait for a message from the queue
@@ -83,56 +116,157 @@ void UART_Task(void *pvParameters) {
             HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
             ms = milliseconds;
 
-            int result = sscanf(queueBuffer, "%02d:%02d:%02d:%03ld ", &stampHours, &stampMinutes, &stampSeconds, &stampmilliSeconds);
-
-            response_delay = (sTime.Hours - stampHours) * 3600000 + (sTime.Minutes - stampMinutes) * 60000 +
-            		(sTime.Seconds - stampSeconds) * 1000 + (ms - stampmilliSeconds);
-
-        	sprintf(message, "%02d:%02d:%02d:%03ld %s", sTime.Hours, sTime.Minutes, sTime.Seconds, ms, queueBuffer);
+        	snprintf(message, sizeof(message), "%02d:%02d:%02d:%03d %s", sTime.Hours, sTime.Minutes, sTime.Seconds, ms, queueBuffer.text);
+        	xSemaphoreTake(uartMutex, portMAX_DELAY);
+        	TRACE_Record(TRACE_UART_TX_START, 0, strlen(message));
         	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
+        	TRACE_Record(TRACE_UART_TX_DONE, 0, 0);
+        	xSemaphoreGive(uartMutex);
 
-            sprintf(message, "delay (ms): %d\r\n\r\n", response_delay);
-            HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
+        	if (queueBuffer.sensor >= 0) {
+        		LAT_Record(queueBuffer.sensor, LAT_STAGE_DEQUEUE_TO_UART, TIMING_Micros() - queueBuffer.dequeue_us);
+        	}
         }
     }
 }
 
 // Function for other tasks to send messages via UART
 void send_uart_message(const char *message) {
+	send_uart_sample(message, -1, 0);
+}
+
+// Free entries of the UART queue, bulk output waits for room instead of filling it
+int uart_queue_space(void) {
+	return (int)uxQueueSpacesAvailable(uartQueue);
+}
+
+// The RTC holds the time of day, not the time since the first power-up
+int rtc_time_valid(void) {
+	return rtc_time_of_day;
+}
+
+// Set the RTC to the time of day, the date stays as it is
+int rtc_set_time(int hours, int minutes, int seconds) {
+	RTC_TimeTypeDef time = {0};
+
+	if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59 || seconds < 0 || seconds > 59) {
+		return FAILURE;
+	}
+	time.Hours = hours;
+	time.Minutes = minutes;
+	time.Seconds = seconds;
+	time.DayLightSaving = RTC_DAYLIGHTSAVING_NONE;
+	time.StoreOperation = RTC_STOREOPERATION_RESET;
+	if (HAL_RTC_SetTime(&hrtc, &time, RTC_FORMAT_BIN) != HAL_OK) {
+		return FAILURE;
+	}
+	HAL_RTCEx_BKUPWrite(&hrtc, RTC_BKP_DR0, RTC_BKP_TIME_OF_DAY);
+	rtc_time_of_day = 1;
+	return SUCCESS;
+}
+
+// Same as send_uart_message() without waiting, FAILURE when the queue is full
+int send_uart_message_nowait(const char *message) {
+    uart_message entry;
+
+    entry.sensor = -1;
+    entry.dequeue_us = 0;
+    strncpy(entry.text, message, MAX_MESSAGE_LENGTH - 1);
+    entry.text[MAX_MESSAGE_LENGTH - 1] = '\0';
+    return xQueueSend(uartQueue, &entry, 0) == pdPASS ? SUCCESS : FAILURE;
+}
+
+// Same as send_uart_message() for a sample line, feeds the dequeue -> UART latency
+void send_uart_sample(const char *message, int sensor, uint32_t dequeue_us) {
+    uart_message entry;
+
+    entry.sensor = sensor;
+    entry.dequeue_us = dequeue_us;
+    strncpy(entry.text, message, MAX_MESSAGE_LENGTH - 1);
+    entry.text[MAX_MESSAGE_LENGTH - 1] = '\0';
+
     // Send message to the queue
-    if (xQueueSend(uartQueue, message, portMAX_DELAY) != pdPASS) {
+    if (xQueueSend(uartQueue, &entry, portMAX_DELAY) != pdPASS) {
         // Handle queue send failure
     }
 }
 
+/* Alarm lane: transmit now instead of behind the queued lines, waits at
+ * most for the line being sent (the mutex raises UART_Task meanwhile)
+ * */
+void send_uart_alarm(const char *message) {
+	if (xSemaphoreTake(uartMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+		TRACE_Record(TRACE_UART_TX_START, 1, strlen(message));
+		HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
+		TRACE_Record(TRACE_UART_TX_DONE, 1, 0);
+		xSemaphoreGive(uartMutex);
+	}
+}
+
 #define ACCEL_TASK_STACK_SIZE 512
 #define GYRO_TASK_STACK_SIZE 512
 #define MAG_TASK_STACK_SIZE 512
 #define TEMP_TASK_STACK_SIZE 400
 #define HUMID_TASK_STACK_SIZE 400
 #define PRESS_TASK_STACK_SIZE 400
+#define IMU_TASK_STACK_SIZE 512
 #define UART_TASK_STACK_SIZE 512
 #define SCHDLR_TASK_STACK_SIZE 800
-
-
+#define I2C_TASK_STACK_SIZE 256
+#define EVENT_TASK_STACK_SIZE 384
+#define CONSOLE_TASK_STACK_SIZE 384
+#define SUPERVISOR_TASK_STACK_SIZE 256
+
+
+#if ACQ_ENGINE == ACQ_ENGINE_HEAP
+StaticTask_t xAcqEngineTaskControlBlock;
+#else
+#if ACQ_MODE == ACQ_MODE_HWFIFO
+StaticTask_t xImuTaskControlBlock;
+#else
 StaticTask_t xAccelTaskControlBlock;
 StaticTask_t xGyroTaskControlBlock;
 StaticTask_t xMagTaskControlBlock;
+#endif
 StaticTask_t xTempTaskControlBlock;
 StaticTask_t xHumidTaskControlBlock;
 StaticTask_t xPressTaskControlBlock;
+#endif
 StaticTask_t xUARTTaskControlBlock;
 StaticTask_t xSchdlrTaskControlBlock;
-
+StaticTask_t xI2CTaskControlBlock;
+StaticTask_t xEventTaskControlBlock;
+#if CONSOLE_ENABLE
+StaticTask_t xConsoleTaskControlBlock;
+#endif
+#if SUPERVISOR_ENABLE
+StaticTask_t xSupervisorTaskControlBlock;
+#endif
+
+#if ACQ_ENGINE == ACQ_ENGINE_HEAP
+StackType_t xAcqEngineStack[ACQ_ENGINE_STACK_SIZE];
+#else
+#if ACQ_MODE == ACQ_MODE_HWFIFO
+StackType_t xImuStack[IMU_TASK_STACK_SIZE];
+#else
 StackType_t xAccelStack[ACCEL_TASK_STACK_SIZE];
 StackType_t xGyroStack[GYRO_TASK_STACK_SIZE];
 StackType_t xMagStack[MAG_TASK_STACK_SIZE];
+#endif
 StackType_t xTempStack[TEMP_TASK_STACK_SIZE];
 StackType_t xHumidStack[HUMID_TASK_STACK_SIZE];
 StackType_t xPressStack[PRESS_TASK_STACK_SIZE];
+#endif
 StackType_t xUARTStack[UART_TASK_STACK_SIZE];
 StackType_t xSchdlrStack[SCHDLR_TASK_STACK_SIZE];
+StackType_t xI2CStack[I2C_TASK_STACK_SIZE];
+StackType_t xEventStack[EVENT_TASK_STACK_SIZE];
+#if CONSOLE_ENABLE
+StackType_t xConsoleStack[CONSOLE_TASK_STACK_SIZE];
+#endif
+#if SUPERVISOR_ENABLE
+StackType_t xSupervisorStack[SUPERVISOR_TASK_STACK_SIZE];
+#endif
 
 
 
@@ -141,29 +275,63 @@ StackType_t xSchdlrStack[SCHDLR_TASK_STACK_SIZE];
 int main(void)
 {
 
-  int status;
-
 
 
+  // SystemInit() already ran from the reset handler
   HAL_Init();
-  SystemInit();
   SystemClock_Config();
+  TIMING_Init();
+  BOOT_Mark(BOOT_CLOCK);
   USART1_UART_Init();
+  BOOT_Mark(BOOT_UART);
   MX_RTC_Init();
+  BOOT_Mark(BOOT_RTC);
+  LAT_Init();
 
 
   osKernelInitialize();
 
 
 //   Create the UART queue
-  uartQueue = xQueueCreate(QUEUE_SIZE, MAX_MESSAGE_LENGTH);
+  uartQueue = xQueueCreate(QUEUE_SIZE, sizeof(uart_message));
+  uartMutex = xSemaphoreCreateMutex();
 
   char tx_buffer[50];
   sprintf(tx_buffer, "Initializing sensors\r\n");
   HAL_UART_Transmit(&huart1, (uint8_t*)tx_buffer, strlen(tx_buffer), 1000);
 
-  status = sensors_init();
-  initI2CMutex();
+  if (sensors_init() != SUCCESS) {
+	  sprintf(tx_buffer, "Sensor initialization failed\r\n");
+	  HAL_UART_Transmit(&huart1, (uint8_t*)tx_buffer, strlen(tx_buffer), 1000);
+  }
+  BOOT_Mark(BOOT_SENSORS);
+  RULES_Init();
+  STATS_Init();
+  ANOMALY_Init();
+  ADAPT_Init();
+  DEADBAND_Init();
+  FILTER_Init();
+  EVENT_Init();
+  ALARM_Init();
+  CEP_Init();
+  SYSMON_Init();
+  SYSMON_AddQueue("uart", uartQueue);
+  TRACE_NameQueue("uart", uartQueue);
+  TRACE_NameQueue("uart_mutex", uartMutex);
+  if (SUPERVISOR_Init()) {
+	  sprintf(tx_buffer, "Reset by the watchdog\r\n");
+	  HAL_UART_Transmit(&huart1, (uint8_t*)tx_buffer, strlen(tx_buffer), 1000);
+  }
+
+  // settings saved from the console replace the defaults of sensors_init()
+  CONFIG_Init(&config_flash_internal);
+  sprintf(tx_buffer, CONFIG_Load() == SUCCESS ? "Configuration loaded from flash\r\n" : "Default configuration\r\n");
+  HAL_UART_Transmit(&huart1, (uint8_t*)tx_buffer, strlen(tx_buffer), 1000);
+  BOOT_Mark(BOOT_MODULES);
+  I2C_BUS_Init();
+#if CONSOLE_ENABLE
+  CONSOLE_Init();
+#endif
 
 
 
@@ -181,18 +349,47 @@ int main(void)
   );
   *********************************************/
 
+#if ACQ_MODE == ACQ_MODE_DRDY
+  DRDY_Init();
+#endif
+
+#if ACQ_MODE != ACQ_MODE_HWFIFO || ACQ_ENGINE == ACQ_ENGINE_HEAP
+  BOOT_Mark(BOOT_DRIVERS);
+#endif
+
+#if ACQ_ENGINE == ACQ_ENGINE_HEAP
+  // one task instead of the six sensor tasks
+  ACQ_ENGINE_Init(ACCEL_TASK_STACK_SIZE + GYRO_TASK_STACK_SIZE + MAG_TASK_STACK_SIZE
+		  + TEMP_TASK_STACK_SIZE + HUMID_TASK_STACK_SIZE + PRESS_TASK_STACK_SIZE, SENSOR_COUNT);
+  xTaskCreateStatic(vAcqEngineTask, "Acq Engine", ACQ_ENGINE_STACK_SIZE, NULL, 2, xAcqEngineStack, &xAcqEngineTaskControlBlock);
+#else
+#if ACQ_MODE == ACQ_MODE_HWFIFO
+  IMU_FIFO_Init();
+  BOOT_Mark(BOOT_DRIVERS);
+  xTaskCreateStatic(vImuFifoTask, "IMU Task", IMU_TASK_STACK_SIZE, NULL, 2, xImuStack, &xImuTaskControlBlock);
+#else
   xTaskCreateStatic(vAccelSensorTask, "Accel Task", ACCEL_TASK_STACK_SIZE, NULL, 2, xAccelStack, &xAccelTaskControlBlock);
   xTaskCreateStatic(vGyroSensorTask, "Gyro Task", GYRO_TASK_STACK_SIZE, NULL, 2, xGyroStack, &xGyroTaskControlBlock);
   xTaskCreateStatic(vMagSensorTask,  "Mag Task",  MAG_TASK_STACK_SIZE,  NULL,  2, xMagStack, &xMagTaskControlBlock);
+#endif
   xTaskCreateStatic(vTempSensorTask, "Temp Task",  TEMP_TASK_STACK_SIZE, NULL, 2,  xTempStack,  &xTempTaskControlBlock);
   xTaskCreateStatic(vHumidSensorTask, "Humid Task", HUMID_TASK_STACK_SIZE, NULL, 2, xHumidStack, &xHumidTaskControlBlock);
   xTaskCreateStatic(vPressSensorTask, "Press Task", PRESS_TASK_STACK_SIZE, NULL, 2, xPressStack, &xPressTaskControlBlock);
+#endif
   xTaskCreateStatic(UART_Task, "UART_Task", UART_TASK_STACK_SIZE, NULL, 1, xUARTStack, &xUARTTaskControlBlock);
   xTaskCreateStatic(vSchedulerTask, "Scheduler Task", SCHDLR_TASK_STACK_SIZE, NULL, 2, xSchdlrStack, &xSchdlrTaskControlBlock);
+  xTaskCreateStatic(vI2CBusTask, "I2C Task", I2C_TASK_STACK_SIZE, NULL, 3, xI2CStack, &xI2CTaskControlBlock);
+  xTaskCreateStatic(vCriticalEventTask, "Event Task", EVENT_TASK_STACK_SIZE, NULL, EVENT_TASK_PRIORITY, xEventStack, &xEventTaskControlBlock);
+#if CONSOLE_ENABLE
+  xTaskCreateStatic(vConsoleTask, "Console Task", CONSOLE_TASK_STACK_SIZE, NULL, CONSOLE_TASK_PRIORITY, xConsoleStack, &xConsoleTaskControlBlock);
+#endif
+#if SUPERVISOR_ENABLE
+  xTaskCreateStatic(vSupervisorTask, "Supervisor", SUPERVISOR_TASK_STACK_SIZE, NULL, SUPERVISOR_TASK_PRIORITY, xSupervisorStack, &xSupervisorTaskControlBlock);
+#endif
 
 
 
-
+  BOOT_Mark(BOOT_TASKS);
   vTaskStartScheduler();
 
   for(;;);
@@ -247,6 +444,15 @@ static void MX_RTC_Init(void)
     Error_Handler();
   }
 
+  /* The calendar keeps running through a reset: only start it when the
+   * backup register says it never was (power-up without VBAT)
+   * */
+  uint32_t backup = HAL_RTCEx_BKUPRead(&hrtc, RTC_BKP_DR0);
+  if (backup == RTC_BKP_RUNNING || backup == RTC_BKP_TIME_OF_DAY)
+  {
+    rtc_time_of_day = backup == RTC_BKP_TIME_OF_DAY;
+    return;
+  }
 
   /** Initialize RTC and set the Time and Date
   */
@@ -268,6 +474,7 @@ static void MX_RTC_Init(void)
   {
     Error_Handler();
   }
+  HAL_RTCEx_BKUPWrite(&hrtc, RTC_BKP_DR0, RTC_BKP_RUNNING);
 
 
 }
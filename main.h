@@ -30,8 +30,17 @@ extern "C" {
 /* Includes ------------------------------------------------------------------*/
 #include "stm32l4xx_hal.h"
 
+// maximum length of a message queued for the UART task, including the terminator
+#define MAX_MESSAGE_LENGTH 64
+
 void Error_Handler(void);
 void send_uart_message(const char *message);
+int send_uart_message_nowait(const char *message);
+void send_uart_sample(const char *message, int sensor, uint32_t dequeue_us);
+void send_uart_alarm(const char *message);
+int uart_queue_space(void);
+int rtc_time_valid(void);
+int rtc_set_time(int hours, int minutes, int seconds);
 
 extern UART_HandleTypeDef huart1;
 extern RTC_HandleTypeDef hrtc;
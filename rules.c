@@ -0,0 +1,243 @@
+/*
+ * rules.c
+ *
+ * Purpose: Decide when a sensor reading is abnormal and report it once.
+ * Content:
+ * Rule table over the sensor_ctrl limits.
+ * Per rule hysteresis, N-of-M debounce and sustained duration state.
+ * Alarm/clear events on state changes only.
+ *
+ * The sensor code hands every processed value to RULES_Evaluate(), which
+ * runs all rules of that sensor in one pass. The 3 axis sensors hand over
+ * the squared magnitude instead (RULES_EvaluateSq()), compared with squared
+ * limits computed when the limits are set, so the rules take no sqrtf (the
+ * statistics, anomaly detectors, adaptive sampling and CEP patterns still
+ * get the magnitude). A value hovering at a limit no longer repeats the
+ * alarm lines or toggles the LEDs on every sample: only trips and clears
+ * are posted to the critical event task (event.c), which keeps the orange
+ * LED on while any rule is tripped.
+ */
+
+#include "rules.h"
+#include "event.h"
+#include <math.h>
+#include <string.h>
+
+/***********************************************
+ * Rule table, limits are read from sensor_ctrl
+ * at evaluation time so runtime changes apply,
+ * their squares on RULES_SetLimits()
+ ***********************************************/
+static const rule rule_table[] = {
+	// sensor        kind        hyst  n  m  sustain  what                 action
+	{ SENSOR_ACCEL, RULE_ABOVE, 0.5f, 3, 5, 0,     "accelerometer",     "Alarm!!! Abnormal vibration!!!" },
+	{ SENSOR_GYRO,  RULE_ABOVE, 5.0f, 3, 5, 0,     "gyroscope",         "Alarm!!! Abnormal vibration!!!" },
+	{ SENSOR_MAG,   RULE_ABOVE, 0.5f, 3, 5, 0,     "magnetometer",      "Turning on electromagnetic protection system..." },
+	{ SENSOR_TEMP,  RULE_ABOVE, 0.5f, 2, 3, 0,     "HIGH temperature",  "Turning on cooling system..." },
+	{ SENSOR_TEMP,  RULE_BELOW, 0.5f, 2, 3, 0,     "LOW temperature",   "Turning on heating system..." },
+	{ SENSOR_TEMP,  RULE_RATE,  0.2f, 2, 3, 0,     "FAST temperature",  "Temperature changing fast!!!" },
+	{ SENSOR_HUMID, RULE_ABOVE, 2.0f, 2, 3, 30000, "HIGH humidity",     "Turning on dehumidifier..." },
+	{ SENSOR_HUMID, RULE_BELOW, 2.0f, 2, 3, 0,     "LOW humidity",      "Turning on humidifier..." },
+	{ SENSOR_PRESS, RULE_ABOVE, 2.0f, 2, 3, 0,     "HIGH pressure",     "Releasing pressure valve..." },
+	{ SENSOR_PRESS, RULE_BELOW, 2.0f, 2, 3, 0,     "LOW pressure",      "Turning on pressure pump..." },
+};
+
+_Static_assert(sizeof(rule_table) / sizeof(rule_table[0]) == RULE_COUNT, "RULE_COUNT in rules.h must match rule_table");
+
+typedef struct {
+	uint8_t active;
+	uint8_t pending;		// N-of-M holds, waiting for sustain_ms
+	uint32_t history;		// one bit per sample, newest in bit 0
+	TickType_t since;		// when N-of-M started to hold
+} rule_state;
+
+static rule_state state[RULE_COUNT];
+static volatile int active_count;
+
+// squared limit of each rule for RULES_EvaluateSq(), [0] idle, [1] tripped (hysteresis applied)
+static float limit_sq[RULE_COUNT][2];
+
+// previous value of each sensor, for the rate rules
+static float last_value[SENSOR_COUNT];
+static TickType_t last_tick[SENSOR_COUNT];
+static uint8_t has_last[SENSOR_COUNT];
+
+void RULES_Init(void) {
+	memset(state, 0, sizeof(state));
+	memset(has_last, 0, sizeof(has_last));
+	active_count = 0;
+	for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+		RULES_SetLimits(sensor);
+	}
+	LEDG_On();
+	LEDO_Off();
+}
+
+/* Squares of the sensor's limits, after its sensor_ctrl changed (SENSOR_ApplyConfig()).
+ * A magnitude is never negative: above a negative limit always holds,
+ * below a limit <= 0 never does.
+ * */
+void RULES_SetLimits(sensor_id sensor) {
+	sensor_ctrl_data *ctrl = sensor_ctrl[sensor];
+
+	for (uint32_t i = 0; i < RULE_COUNT; i++) {
+		const rule *r = &rule_table[i];
+
+		if (r->sensor != sensor) {
+			continue;
+		}
+		for (int active = 0; active < 2; active++) {
+			float hyst = active ? r->hysteresis : 0;
+			float limit;
+
+			switch (r->kind) {
+				case RULE_ABOVE:
+					limit = ctrl->threshold_up - hyst;
+					limit_sq[i][active] = limit < 0 ? -1.0f : limit * limit;
+					break;
+				case RULE_BELOW:
+					limit = ctrl->threshold_down + hyst;
+					limit_sq[i][active] = limit > 0 ? limit * limit : 0;
+					break;
+				default:
+					limit_sq[i][active] = 0;
+					break;
+			}
+		}
+	}
+}
+
+int RULES_ActiveCount(void) {
+	return active_count;
+}
+
+static int popcount(uint32_t bits) {
+	int count = 0;
+	for (; bits; bits &= bits - 1) {
+		count++;
+	}
+	return count;
+}
+
+/* Limit test of one sample, with the limit moved back by the hysteresis while tripped */
+static int violates(const rule *r, int active, float value, float rate) {
+	sensor_ctrl_data *ctrl = sensor_ctrl[r->sensor];
+	float hyst = active ? r->hysteresis : 0;
+
+	switch (r->kind) {
+		case RULE_ABOVE:
+			return value > ctrl->threshold_up - hyst;
+		case RULE_BELOW:
+			return value < ctrl->threshold_down + hyst;
+		case RULE_RATE:
+			return ctrl->rate_limit > 0 && (rate > ctrl->rate_limit - hyst || -rate > ctrl->rate_limit - hyst);
+		default:
+			return 0;
+	}
+}
+
+/* Same test on a squared magnitude, rate rules need the magnitude itself */
+static int violates_sq(uint32_t i, int active, float mag_sq) {
+	switch (rule_table[i].kind) {
+		case RULE_ABOVE:
+			return mag_sq > limit_sq[i][active];
+		case RULE_BELOW:
+			return mag_sq < limit_sq[i][active];
+		default:
+			return 0;
+	}
+}
+
+/* Trips and clears go to the critical event task (event.c) */
+static void emit(const rule *r, int active, float value, float rate) {
+	event_record event = {
+		.what = r->what,
+		.action = active ? r->action : NULL,
+		.value = value,
+		.sensor = r->sensor,
+		.type = active ? EVENT_TRIP : EVENT_CLEAR,
+		.high = r->kind == RULE_ABOVE || (r->kind == RULE_RATE && rate > 0),
+	};
+
+	EVENT_Post(&event);
+}
+
+/* Both evaluations: value, or the squared magnitude mag_sq when squared is set */
+static int evaluate(sensor_id sensor, float value, float mag_sq, int squared) {
+	TickType_t now = xTaskGetTickCount();
+	float rate = 0;
+	int tripped = 0;
+
+	if (!squared) {
+		if (has_last[sensor] && now != last_tick[sensor]) {
+			rate = (value - last_value[sensor]) * configTICK_RATE_HZ / (float)(now - last_tick[sensor]);
+		}
+		last_value[sensor] = value;
+		last_tick[sensor] = now;
+	}
+
+	for (uint32_t i = 0; i < RULE_COUNT; i++) {
+		const rule *r = &rule_table[i];
+		rule_state *s = &state[i];
+
+		if (r->sensor != sensor) {
+			continue;
+		}
+		if (r->kind == RULE_RATE && (squared || !has_last[sensor])) {
+			continue;
+		}
+
+		int violation = squared ? violates_sq(i, s->active, mag_sq) : violates(r, s->active, value, rate);
+		uint32_t window = r->m >= 32 ? 0xFFFFFFFFu : (1u << r->m) - 1;
+		s->history = ((s->history << 1) | violation) & window;
+		int hits = popcount(s->history);
+
+		if (!s->active) {
+			if (hits >= r->n) {
+				if (!s->pending) {
+					s->pending = 1;
+					s->since = now;
+				}
+				if (now - s->since >= pdMS_TO_TICKS(r->sustain_ms)) {
+					s->active = 1;
+					s->pending = 0;
+					taskENTER_CRITICAL();
+					active_count++;
+					taskEXIT_CRITICAL();
+					emit(r, 1, squared ? sqrtf(mag_sq) : value, rate);
+				}
+			}else{
+				s->pending = 0;
+			}
+		}else if (hits == 0) {
+			s->active = 0;
+			taskENTER_CRITICAL();
+			active_count--;
+			taskEXIT_CRITICAL();
+			emit(r, 0, squared ? sqrtf(mag_sq) : value, rate);
+		}
+
+		tripped += s->active;
+	}
+
+	if (!squared) {
+		has_last[sensor] = 1;
+	}
+	return tripped;
+}
+
+/* Run every rule of the sensor on a new value. Posts an event only when a
+ * rule trips or clears. Returns the number of rules of this sensor that
+ * are tripped.
+ * */
+int RULES_Evaluate(sensor_id sensor, float value) {
+	return evaluate(sensor, value, 0, 0);
+}
+
+/* Same for a 3 axis sensor on its squared magnitude (DSP_MagSq_f32()),
+ * the magnitude is only computed for a trip or clear event. Rate rules
+ * are skipped.
+ * */
+int RULES_EvaluateSq(sensor_id sensor, float mag_sq) {
+	return evaluate(sensor, 0, mag_sq, 1);
+}
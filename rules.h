@@ -0,0 +1,46 @@
+/*
+ * rules.h
+ *
+ * Purpose: Declare the threshold rule engine.
+ * Content:
+ * Rule description (limit, hysteresis, N-of-M debounce, sustained duration)
+ * and the evaluation functions called once per sample or sample block,
+ * on the value or on the squared magnitude of a 3 axis sensor.
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+#include "sensors.h"
+
+typedef enum {
+	RULE_ABOVE = 0,		// value above sensor_ctrl threshold_up
+	RULE_BELOW,			// value below sensor_ctrl threshold_down
+	RULE_RATE			// |change per second| above sensor_ctrl rate_limit
+} rule_kind;
+
+/* A rule trips when its condition holds for n of the last m samples during
+ * at least sustain_ms, and clears once none of the last m samples violate it.
+ * While tripped, the limit is moved back by hysteresis.
+ * */
+typedef struct {
+	sensor_id sensor;
+	rule_kind kind;
+	float hysteresis;
+	uint8_t n;
+	uint8_t m;				// at most 32
+	uint16_t sustain_ms;
+	const char *what;		// "HIGH temperature"
+	const char *action;		// printed when the rule trips
+} rule;
+
+// rows of rule_table in rules.c, checked there
+#define RULE_COUNT 10
+
+void RULES_Init(void);
+void RULES_SetLimits(sensor_id sensor);
+int RULES_Evaluate(sensor_id sensor, float value);
+int RULES_EvaluateSq(sensor_id sensor, float mag_sq);
+int RULES_ActiveCount(void);
+
+#endif
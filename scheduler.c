@@ -1,12 +1,48 @@
 
 #include "scheduler.h"
 #include "sensors.h"
+#include "latency.h"
+#include "timing.h"
+#include "i2c_bus.h"
+#include "acq_engine.h"
+#include "drdy.h"
+#include "dsp_kernels.h"
+#include "bench.h"
+#include "trace.h"
+#include "stats.h"
+#include "vibration.h"
+#include "adaptive.h"
+#include "deadband.h"
+#include "filter.h"
+#include "alarm_mgr.h"
+#include "sysmon.h"
+#include "boot_profile.h"
+#include "supervisor.h"
 #include <stdlib.h>
 
 // Function prototypes for internal helper functions
 static int select_fifo_random();
 static int select_fifo_full();
 static int select_fifo_predictive();
+static void output_summaries(char *message);
+
+/* One sample line per second cannot keep up with the motion sensors of
+ * ACQ_MODE_HWFIFO, one FIFO sample per block: they start summarised
+ * */
+#ifndef SCHEDULER_OUTPUT_MOTION
+#if ACQ_MODE == ACQ_MODE_HWFIFO
+#define SCHEDULER_OUTPUT_MOTION OUTPUT_SUMMARY
+#else
+#define SCHEDULER_OUTPUT_MOTION SCHEDULER_OUTPUT
+#endif
+#endif
+
+volatile int output_mode[SENSOR_COUNT] = {
+	SCHEDULER_OUTPUT_MOTION, SCHEDULER_OUTPUT_MOTION, SCHEDULER_OUTPUT_MOTION,
+	SCHEDULER_OUTPUT, SCHEDULER_OUTPUT, SCHEDULER_OUTPUT
+};
+
+volatile int scheduler_scheme = SCHEDULER_SCHEME;
 
 /* SchedulerTask select a fifo to read its data at one time;
  * selected_index:
@@ -21,12 +57,22 @@ void vSchedulerTask(void *pvParameters) {
 	TickType_t xLastWakeTime = xTaskGetTickCount();
 	TickType_t SchedulerInterval = 1000;
 
-    int scheme = 0;
+    int scheme = scheduler_scheme;
     int selected_fifo = -1;
 
-    char message[50];
+    char message[MAX_MESSAGE_LENGTH];
     Data data;
     Data3Axis data3Axis;
+    uint32_t dequeue_us;
+    TickType_t xLastLatReport = xLastWakeTime;
+    int supervised_id = SUPERVISOR_Register("Sched", 1, SUPERVISOR_SCHEDULER_BUDGET_US);
+
+    // cycles per sample of the conversion kernels, when built with DSP_BENCHMARK=1
+    DSP_Benchmark();
+    // cycles per call of the FIFO, formatting and conversion paths, when built with BENCH_ENABLE=1
+    BENCH_Run(BENCH_Print);
+    // frequency response of the decimators, when built with FILTER_SELFTEST=1
+    FILTER_SelfTest();
 
     switch (scheme) {
         case 0:
@@ -48,7 +94,8 @@ void vSchedulerTask(void *pvParameters) {
 
     for(;;) {
 
-        // Decide which scheme to use based on the scheme variable
+        // Decide which scheme to use based on the scheme variable, read once per selection
+        scheme = scheduler_scheme;
         switch (scheme) {
             case 0:
                 selected_fifo = select_fifo_random();
@@ -64,83 +111,110 @@ void vSchedulerTask(void *pvParameters) {
                 break;
         }
 
+        // summarised sensors are not printed sample by sample
+        output_summaries(message);
+#if ACQ_MODE == ACQ_MODE_HWFIFO
+        // spectrum of the last accelerometer block, if one completed
+        VIB_Report();
+#endif
+        if (output_mode[selected_fifo] != OUTPUT_RAW) {
+        	selected_fifo = -1;
+        }
+
         // Perform actions with the selected FIFO
         switch(selected_fifo){
 			case 0:
 				if(accel_fifo.count == 0){
-					sprintf(message, "Accel FIFO empty!\r");
+					sprintf(message, "Accel FIFO empty!\r\n");
 					send_uart_message(message);
 				}
 				else{
 					FIFO_Read_3Axis(&accel_fifo, &data3Axis);
-					sprintf(message, "%02d:%02d:%02d:%03ld Acl XYZ: %6.2f %6.2f %6.2f %02d/%02d\r",
-							data3Axis.Hours, data3Axis.Minutes, data3Axis.Seconds, data3Axis.milliSeconds,
+					dequeue_us = TIMING_Micros();
+					LAT_Record(SENSOR_ACCEL, LAT_STAGE_FIFO_TO_DEQUEUE, dequeue_us - data3Axis.timestamp);
+					sprintf(message, "%02d:%02d:%02d:%03lu Acl XYZ: %6.2f %6.2f %6.2f %02d/%02d\r\n",
+							data3Axis.Hours, data3Axis.Minutes, data3Axis.Seconds, (unsigned long)data3Axis.milliSeconds,
 							data3Axis.x, data3Axis.y, data3Axis.z, accel_fifo.count, accel_fifo.size);
-					send_uart_message(message);
+					send_uart_sample(message, SENSOR_ACCEL, dequeue_us);
 				}
 				break;
 
 			case 1:
 				if(gyro_fifo.count == 0){
-					sprintf(message, "Gyro FIFO empty!\r");
+					sprintf(message, "Gyro FIFO empty!\r\n");
 					send_uart_message(message);
 				}else{
 					FIFO_Read_3Axis(&gyro_fifo, &data3Axis);
-					sprintf(message, "%02d:%02d:%02d:%03ld Gyr XYZ: %6.2f %6.2f %6.2f %02d/%02d\r",
-							data3Axis.Hours, data3Axis.Minutes, data3Axis.Seconds, data3Axis.milliSeconds,
+					dequeue_us = TIMING_Micros();
+					LAT_Record(SENSOR_GYRO, LAT_STAGE_FIFO_TO_DEQUEUE, dequeue_us - data3Axis.timestamp);
+					sprintf(message, "%02d:%02d:%02d:%03lu Gyr XYZ: %6.2f %6.2f %6.2f %02d/%02d\r\n",
+							data3Axis.Hours, data3Axis.Minutes, data3Axis.Seconds, (unsigned long)data3Axis.milliSeconds,
 							data3Axis.x, data3Axis.y, data3Axis.z, gyro_fifo.count, gyro_fifo.size);
-					send_uart_message(message);
+					send_uart_sample(message, SENSOR_GYRO, dequeue_us);
 				}
 				break;
 
 			case 2:
 				if(mag_fifo.count == 0){
-					sprintf(message, "Mag FIFO empty!\r");
+					sprintf(message, "Mag FIFO empty!\r\n");
 					send_uart_message(message);
 				}else{
 					FIFO_Read_3Axis(&mag_fifo, &data3Axis);
-					sprintf(message, "%02d:%02d:%02d:%03ld Mag XYZ: %6.2f %6.2f %6.2f %02d/%02d\r",
-							data3Axis.Hours, data3Axis.Minutes, data3Axis.Seconds, data3Axis.milliSeconds,
+					dequeue_us = TIMING_Micros();
+					LAT_Record(SENSOR_MAG, LAT_STAGE_FIFO_TO_DEQUEUE, dequeue_us - data3Axis.timestamp);
+					sprintf(message, "%02d:%02d:%02d:%03lu Mag XYZ: %6.2f %6.2f %6.2f %02d/%02d\r\n",
+							data3Axis.Hours, data3Axis.Minutes, data3Axis.Seconds, (unsigned long)data3Axis.milliSeconds,
 							data3Axis.x, data3Axis.y, data3Axis.z, mag_fifo.count, mag_fifo.size);
-					send_uart_message(message);
+					send_uart_sample(message, SENSOR_MAG, dequeue_us);
 				}
 				break;
 
 			case 3:
 				if(temp_fifo.count == 0){
-					sprintf(message, "Temp FIFO empty!\r");
+					sprintf(message, "Temp FIFO empty!\r\n");
 					send_uart_message(message);
 				}else{
 					FIFO_Read(&temp_fifo, &data);
-					sprintf(message, "%02d:%02d:%02d:%03ld Temp: %6.2f %02d/%02d\r",
-							data.Hours, data.Minutes, data.Seconds, data.milliSeconds, data.value, temp_fifo.count, temp_fifo.size);
-					send_uart_message(message);
+					dequeue_us = TIMING_Micros();
+					LAT_Record(SENSOR_TEMP, LAT_STAGE_FIFO_TO_DEQUEUE, dequeue_us - data.timestamp);
+					sprintf(message, "%02d:%02d:%02d:%03lu Temp: %6.2f %02d/%02d +%u\r\n",
+							data.Hours, data.Minutes, data.Seconds, (unsigned long)data.milliSeconds, data.value, temp_fifo.count, temp_fifo.size,
+							data.skipped);
+					send_uart_sample(message, SENSOR_TEMP, dequeue_us);
 				}
 				break;
 
 			case 4:
 				if(humid_fifo.count == 0){
-					sprintf(message, "Humid FIFO empty!\r");
+					sprintf(message, "Humid FIFO empty!\r\n");
 					send_uart_message(message);
 				}else{
 					FIFO_Read(&humid_fifo, &data);
-					sprintf(message, "%02d:%02d:%02d:%03ld Humid: %6.2f %02d/%02d\r",
-							data.Hours, data.Minutes, data.Seconds, data.milliSeconds, data.value, humid_fifo.count, humid_fifo.size);
-					send_uart_message(message);
+					dequeue_us = TIMING_Micros();
+					LAT_Record(SENSOR_HUMID, LAT_STAGE_FIFO_TO_DEQUEUE, dequeue_us - data.timestamp);
+					sprintf(message, "%02d:%02d:%02d:%03lu Humid: %6.2f %02d/%02d +%u\r\n",
+							data.Hours, data.Minutes, data.Seconds, (unsigned long)data.milliSeconds, data.value, humid_fifo.count, humid_fifo.size,
+							data.skipped);
+					send_uart_sample(message, SENSOR_HUMID, dequeue_us);
 				}
 				break;
 
 			case 5:
 				if(press_fifo.count == 0){
-					sprintf(message, "Press FIFO empty!\r");
+					sprintf(message, "Press FIFO empty!\r\n");
 					send_uart_message(message);
 				}else{
 					FIFO_Read(&press_fifo, &data);
-					sprintf(message, "%02d:%02d:%02d:%03ld Press: %6.2f %02d/%02d\r",
-							data.Hours, data.Minutes, data.Seconds, data.milliSeconds, data.value, press_fifo.count, press_fifo.size);
-					send_uart_message(message);
+					dequeue_us = TIMING_Micros();
+					LAT_Record(SENSOR_PRESS, LAT_STAGE_FIFO_TO_DEQUEUE, dequeue_us - data.timestamp);
+					sprintf(message, "%02d:%02d:%02d:%03lu Press: %6.2f %02d/%02d +%u\r\n",
+							data.Hours, data.Minutes, data.Seconds, (unsigned long)data.milliSeconds, data.value, press_fifo.count, press_fifo.size,
+							data.skipped);
+					send_uart_sample(message, SENSOR_PRESS, dequeue_us);
 				}
 				break;
+			case -1:
+				break;
 			default:
 				Error_Handler();
 				break;
@@ -151,8 +225,35 @@ void vSchedulerTask(void *pvParameters) {
 
 
 
+#if LAT_REPORT_INTERVAL_MS > 0
+        if (xTaskGetTickCount() - xLastLatReport >= pdMS_TO_TICKS(LAT_REPORT_INTERVAL_MS)) {
+        	xLastLatReport = xTaskGetTickCount();
+        	LAT_Report(1);
+        	I2C_BUS_Report();
+        	ADAPT_Report();
+        	DEADBAND_Report();
+        	ALARM_Report();
+#if ACQ_ENGINE == ACQ_ENGINE_HEAP
+        	ACQ_ENGINE_Report();
+#endif
+#if ACQ_MODE == ACQ_MODE_DRDY
+        	DRDY_Report();
+#endif
+        	SYSMON_Report();
+        	SUPERVISOR_Report();
+        }
+#endif
+        // queue depth peaks, and the report when another task asked for one
+        SYSMON_Sample();
+        // boot timeline, once every sensor has delivered
+        BOOT_Poll();
+        // event trace stopped by a FIFO overflow, when built with TRACE_AUTODUMP=1
+        TRACE_Poll();
+
         // Delay the task to allow other tasks to run
+        SUPERVISOR_End(supervised_id, xLastWakeTime + SchedulerInterval, SchedulerInterval);
         vTaskDelayUntil(&xLastWakeTime, SchedulerInterval);
+        SUPERVISOR_Begin(supervised_id);
     }
 }
 
@@ -199,12 +300,12 @@ static int select_fifo_full() {
 static int select_fifo_predictive() {
     int time_to_full[6];
 
-    time_to_full[0] = (accel_fifo.size - accel_fifo.count) * accel.interval;
-    time_to_full[1] = (gyro_fifo.size - gyro_fifo.count) * gyro.interval;
-    time_to_full[2] = (mag_fifo.size - mag_fifo.count) * mag.interval;
-    time_to_full[3] = (temp_fifo.size - temp_fifo.count) * temp.interval;
-    time_to_full[4] = (humid_fifo.size - humid_fifo.count) * humid.interval;
-    time_to_full[5] = (press_fifo.size - press_fifo.count) * press.interval;
+    time_to_full[0] = (accel_fifo.size - accel_fifo.count) * accel.effective_interval;
+    time_to_full[1] = (gyro_fifo.size - gyro_fifo.count) * gyro.effective_interval;
+    time_to_full[2] = (mag_fifo.size - mag_fifo.count) * mag.effective_interval;
+    time_to_full[3] = (temp_fifo.size - temp_fifo.count) * temp.effective_interval;
+    time_to_full[4] = (humid_fifo.size - humid_fifo.count) * humid.effective_interval;
+    time_to_full[5] = (press_fifo.size - press_fifo.count) * press.effective_interval;
 
     int min_time_to_full = time_to_full[0];
     int selected_index = 0;
@@ -218,3 +319,42 @@ static int select_fifo_predictive() {
 
     return selected_index;
 }
+
+/* OUTPUT_SUMMARY and OUTPUT_SLIDING sensors: drop their queued samples
+ * and print each closed SCHEDULER_SUMMARY_WINDOW window, or the sliding
+ * window each time it moved by a bucket, as one line
+ * */
+static void output_summaries(char *message) {
+	static FIFO3Axis *const fifo_3axis[] = { &accel_fifo, &gyro_fifo, &mag_fifo };
+	static FIFO *const fifo[] = { &temp_fifo, &humid_fifo, &press_fifo };
+	Data data;
+	Data3Axis data3Axis;
+	stats_acc acc;
+
+	for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+		if (output_mode[sensor] == OUTPUT_RAW) {
+			continue;
+		}
+
+		if (sensor < SENSOR_TEMP) {
+			while (FIFO_Read_3Axis(fifo_3axis[sensor], &data3Axis));
+		}else{
+			while (FIFO_Read(fifo[sensor - SENSOR_TEMP], &data));
+		}
+
+		if (output_mode[sensor] == OUTPUT_SLIDING) {
+			if (STATS_Sliding(sensor, &acc) == SUCCESS && acc.count > 0) {
+				snprintf(message, MAX_MESSAGE_LENGTH, "%s %lus/%lus n%lu avg %.2f sd %.2f %.2f..%.2f\r\n",
+						sensor_name[sensor], (unsigned long)(STATS_SLIDING_MS / 1000),
+						(unsigned long)(STATS_SLIDING_MS / STATS_SLIDING_BUCKETS / 1000), (unsigned long)acc.count,
+						acc.mean, STATS_StdDev(&acc), acc.min, acc.max);
+				send_uart_message(message);
+			}
+		}else if (STATS_TakeWindow(sensor, SCHEDULER_SUMMARY_WINDOW, &acc) == SUCCESS && acc.count > 0) {
+			snprintf(message, MAX_MESSAGE_LENGTH, "%s %lus n%lu avg %.2f sd %.2f %.2f..%.2f\r\n",
+					sensor_name[sensor], (unsigned long)(STATS_WindowMs(SCHEDULER_SUMMARY_WINDOW) / 1000), (unsigned long)acc.count,
+					acc.mean, STATS_StdDev(&acc), acc.min, acc.max);
+			send_uart_message(message);
+		}
+	}
+}
@@ -24,5 +24,33 @@
  * Declare Define task handles and scheduling data structures
  */
 
+// what vSchedulerTask prints for a sensor
+#define OUTPUT_RAW		0	// the dequeued samples
+#define OUTPUT_SUMMARY	1	// one line per closed stats window (stats.c), samples are dropped
+#define OUTPUT_SLIDING	2	// one line per sliding window bucket over the last STATS_SLIDING_MS, samples are dropped
+#define OUTPUT_MODES	3
+
+#ifndef SCHEDULER_OUTPUT
+#define SCHEDULER_OUTPUT OUTPUT_RAW
+#endif
+
+// window printed in OUTPUT_SUMMARY, index in STATS_WINDOWS_MS
+#ifndef SCHEDULER_SUMMARY_WINDOW
+#define SCHEDULER_SUMMARY_WINDOW 2
+#endif
+
+// output mode by sensor_id, may be changed at runtime
+extern volatile int output_mode[];
+
+// FIFO selection: 0 random, 1 full, 2 predictive
+#define SCHEDULER_SCHEMES 3
+
+#ifndef SCHEDULER_SCHEME
+#define SCHEDULER_SCHEME 0
+#endif
+
+// may be changed at runtime (console.c)
+extern volatile int scheduler_scheme;
+
 void vSchedulerTask(void *pvParameters);
 
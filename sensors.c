@@ -1,9 +1,28 @@
 #include "sensors.h"
-#include "math.h"
+#include "latency.h"
+#include "timing.h"
+#include "drdy.h"
+#include "i2c_bus.h"
+#include "dsp_kernels.h"
+#include "rules.h"
+#include "stats.h"
+#include "anomaly.h"
+#include "adaptive.h"
+#include "deadband.h"
+#include "filter.h"
+#include "cep.h"
+#include "boot_profile.h"
+#include "supervisor.h"
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 
 
+const char *const sensor_name[SENSOR_COUNT] = {
+	"Acl", "Gyr", "Mag", "Temp", "Humid", "Press"
+};
+
 sensor_ctrl_data accel;
 sensor_ctrl_data gyro;
 sensor_ctrl_data mag;
@@ -11,6 +30,14 @@ sensor_ctrl_data temp;
 sensor_ctrl_data humid;
 sensor_ctrl_data press;
 
+sensor_ctrl_data *const sensor_ctrl[SENSOR_COUNT] = {
+	&accel, &gyro, &mag, &temp, &humid, &press
+};
+
+// control data waiting for the next sample (SENSOR_Configure)
+static sensor_ctrl_data staged_ctrl[SENSOR_COUNT];
+static volatile uint8_t staged[SENSOR_COUNT];
+
 FIFO3Axis accel_fifo;
 FIFO3Axis gyro_fifo;
 FIFO3Axis mag_fifo;
@@ -18,626 +45,565 @@ FIFO temp_fifo;
 FIFO humid_fifo;
 FIFO press_fifo;
 
+// FIFO storage, the motion FIFOs are provided by imu_fifo.c in ACQ_MODE_HWFIFO
+#if ACQ_MODE != ACQ_MODE_HWFIFO
+static Data3Axis accel_fifo_buffer[MOTION_FIFO_SIZE];
+static Data3Axis gyro_fifo_buffer[MOTION_FIFO_SIZE];
+static Data3Axis mag_fifo_buffer[MOTION_FIFO_SIZE];
+#endif
+static Data temp_fifo_buffer[ENV_FIFO_SIZE];
+static Data humid_fifo_buffer[ENV_FIFO_SIZE];
+static Data press_fifo_buffer[ENV_FIFO_SIZE];
+
+// last raw reading of every sensor, filled by the BSP reads below
+static int16_t accel_raw[3];
+static float gyro_raw[3];
+static int16_t mag_raw[3];
+static float temp_raw;
+static float humid_raw;
+static float press_raw;
+
 /***********************************************
  * initializing sensors, sensors params
  * and sensor FIFO
  ***********************************************/
+// power-up to first valid conversion at the ODR the BSP sets
+static const uint16_t startup_ms[SENSOR_COUNT] = {
+	[SENSOR_ACCEL] = 20,	// LSM6DSL accelerometer turn-on
+	[SENSOR_GYRO]  = 80,	// LSM6DSL gyroscope turn-on
+	[SENSOR_MAG]   = 20,
+	[SENSOR_TEMP]  = 1000,	// HTS221 at 1 Hz
+	[SENSOR_HUMID] = 1000,
+	[SENSOR_PRESS] = 50,
+};
+
+/* HAL_Init() ran in main(). The slow sensors are brought up first, so that
+ * their first conversion overlaps the rest of the boot (boot_profile.c).
+ * */
 int sensors_init(){
-	int status;
-
-	status = HAL_Init();
-	if(status != HAL_OK){ return FAILURE;}
-
 	LED_Init();
 	LEDG_On();
 	LEDO_Off();
 
 	SENSOR_IO_Init();
 
-	status = BSP_ACCELERO_Init();
-	if(status != ACCELERO_OK){ return FAILURE;}
+	if(BSP_TSENSOR_Init() != TSENSOR_OK){ return FAILURE;}
+	BOOT_SensorUp(SENSOR_TEMP);
+	if(BSP_HSENSOR_Init() != HSENSOR_OK){ return FAILURE;}
+	BOOT_SensorUp(SENSOR_HUMID);
+	if(BSP_PSENSOR_Init() != PSENSOR_OK){ return FAILURE;}
+	BOOT_SensorUp(SENSOR_PRESS);
+	if(BSP_ACCELERO_Init() != ACCELERO_OK){ return FAILURE;}
+	BOOT_SensorUp(SENSOR_ACCEL);
+	if(BSP_GYRO_Init() != GYRO_OK){ return FAILURE;}
+	BOOT_SensorUp(SENSOR_GYRO);
+	if(BSP_MAGNETO_Init() != MAGNETO_OK){ return FAILURE;}
+	BOOT_SensorUp(SENSOR_MAG);
+
 	accel.interval = 1000;
+	accel.min_interval = 250;
+	accel.max_interval = 4000;
+	accel.effective_interval = accel.interval;
 	accel.threshold_up = 11;
 	accel.threshold_down = -11;
-	accel_fifo.size = 32;
+#if ACQ_MODE != ACQ_MODE_HWFIFO
+	accel_fifo.data = accel_fifo_buffer;
+	accel_fifo.size = MOTION_FIFO_SIZE;
+	accel_fifo.id = SENSOR_ACCEL;
 	FIFO_Init_3Axis(&accel_fifo);
+#endif
 
-	status = BSP_GYRO_Init();
-	if(status != GYRO_OK){ return FAILURE;}
 	gyro.interval = 1000;
+	gyro.min_interval = 250;
+	gyro.max_interval = 4000;
+	gyro.effective_interval = gyro.interval;
 	gyro.threshold_up = 50;
 	gyro.threshold_down = -50;
-	gyro_fifo.size = 32;
+#if ACQ_MODE != ACQ_MODE_HWFIFO
+	gyro_fifo.data = gyro_fifo_buffer;
+	gyro_fifo.size = MOTION_FIFO_SIZE;
+	gyro_fifo.id = SENSOR_GYRO;
 	FIFO_Init_3Axis(&gyro_fifo);
+#endif
 
-	status = BSP_MAGNETO_Init();
-	if(status != MAGNETO_OK){ return FAILURE;}
 	mag.interval = 1000;
+	mag.min_interval = 250;
+	mag.max_interval = 4000;
+	mag.effective_interval = mag.interval;
 	mag.threshold_up = 5;
 	mag.threshold_down = -5;
-	mag_fifo.size = 32;
+#if ACQ_MODE != ACQ_MODE_HWFIFO
+	mag_fifo.data = mag_fifo_buffer;
+	mag_fifo.size = MOTION_FIFO_SIZE;
+	mag_fifo.id = SENSOR_MAG;
 	FIFO_Init_3Axis(&mag_fifo);
+#endif
 
-	status = BSP_TSENSOR_Init();
-	if(status != TSENSOR_OK){ return FAILURE;}
 	temp.interval = 5000;
+	temp.min_interval = 1000;
+	temp.max_interval = 30000;
+	temp.effective_interval = temp.interval;
 	temp.threshold_up = 36;
 	temp.threshold_down = 20;
-	temp_fifo.size = 16;
+	temp.rate_limit = 1.0f;
+	temp.deadband_abs = 0.2f;
+	temp.deadband_rel = 0;
+	temp.max_silence = 60000;
+	temp_fifo.data = temp_fifo_buffer;
+	temp_fifo.size = ENV_FIFO_SIZE;
+	temp_fifo.id = SENSOR_TEMP;
 	FIFO_Init(&temp_fifo);
 
-	status = BSP_HSENSOR_Init();
-	if(status != HSENSOR_OK){ return FAILURE;}
 	humid.interval = 5000;
+	humid.min_interval = 1000;
+	humid.max_interval = 30000;
+	humid.effective_interval = humid.interval;
 	humid.threshold_up = 100;
 	humid.threshold_down = 30;
-	humid_fifo.size = 16;
+	humid.deadband_abs = 1.0f;
+	humid.deadband_rel = 0;
+	humid.max_silence = 60000;
+	humid_fifo.data = humid_fifo_buffer;
+	humid_fifo.size = ENV_FIFO_SIZE;
+	humid_fifo.id = SENSOR_HUMID;
 	FIFO_Init(&humid_fifo);
 
-	status = BSP_PSENSOR_Init();
-	if(status != PSENSOR_OK){ return FAILURE;}
 	press.interval = 5000;
+	press.min_interval = 1000;
+	press.max_interval = 30000;
+	press.effective_interval = press.interval;
 	press.threshold_up = 1000;
 	press.threshold_down = 950;
-	press_fifo.size = 16;
+	press.deadband_abs = 0;
+	press.deadband_rel = 0.0005f;
+	press.max_silence = 60000;
+	press_fifo.data = press_fifo_buffer;
+	press_fifo.size = ENV_FIFO_SIZE;
+	press_fifo.id = SENSOR_PRESS;
 	FIFO_Init(&press_fifo);
 
 	return SUCCESS;
 }
 
-SemaphoreHandle_t xI2CMutex;
+/* Ticks until the sensor delivers valid conversions, 0 once it does */
+TickType_t SENSOR_StartupDelay(sensor_id sensor) {
+	uint32_t since = TIMING_Micros() - BOOT_SensorUpTime(sensor);
+	uint32_t need = startup_ms[sensor] * 1000u;
 
-void initI2CMutex() {
-    xI2CMutex = xSemaphoreCreateMutex();
-    if (xI2CMutex == NULL) {
-        // Handle error: Failed to create the mutex
-    }
+	return since < need ? pdMS_TO_TICKS((need - since) / 1000 + 1) : 0;
 }
 
+/* BSP reads, executed by the I2C bus manager task (I2C_BUS_Call) */
+static void read_accel(void *arg) { BSP_ACCELERO_AccGetXYZ(arg); }
+static void read_gyro(void *arg) { BSP_GYRO_GetXYZ(arg); }
+static void read_mag(void *arg) { BSP_MAGNETO_GetXYZ(arg); }
+static void read_press(void *arg) { *(float*)arg = BSP_PSENSOR_ReadPressure(); }
+
+#if ACQ_MODE != ACQ_MODE_DRDY
+static void read_temp(void *arg) { *(float*)arg = BSP_TSENSOR_ReadTemp(); }
+static void read_humid(void *arg) { *(float*)arg = BSP_HSENSOR_ReadHumidity(); }
+#else
+/* The HTS221 keeps its data-ready line high until both outputs are read:
+ * whichever of the two tasks is woken reads both (drdy.c, DRDY_HandOver())
+ * */
+static void read_hts221(void *arg) {
+	temp_raw = BSP_TSENSOR_ReadTemp();
+	humid_raw = BSP_HSENSOR_ReadHumidity();
+}
+#endif
+
+
+// supervisor.c activity of each sensor task
+static int supervised_id[SENSOR_COUNT];
+
+/* Block until the next sample of the sensor is due:
+ * 	on its data-ready interrupt in ACQ_MODE_DRDY, polled if it does not come,
+ * 	after its interval plus a random offset otherwise.
+ * */
+static void wait_next_sample(sensor_id sensor, TickType_t *xLastWakeTime, int jitter) {
+#if ACQ_MODE == ACQ_MODE_DRDY
+	// the next data-ready interrupt is expected about one interval from now
+	TickType_t period = pdMS_TO_TICKS(SENSOR_ReadInterval(sensor));
+	SUPERVISOR_End(supervised_id[sensor], xTaskGetTickCount() + period, period);
+	if (DRDY_Wait(sensor, xLastWakeTime) != SUCCESS) {
+		/* No edge within two intervals (counted, DRDY_Report()): the caller
+		 * reads the sensor anyway, as in ACQ_MODE_POLL, and the release times
+		 * restart from now instead of catching up.
+		 * */
+		*xLastWakeTime = xTaskGetTickCount();
+	}
+#else
+	TickType_t period = pdMS_TO_TICKS(SENSOR_ReadInterval(sensor) + (rand() % jitter) + 10);
+	SUPERVISOR_End(supervised_id[sensor], *xLastWakeTime + period, period);
+	vTaskDelayUntil(xLastWakeTime, period);
+#endif
+	SUPERVISOR_Begin(supervised_id[sensor]);
+}
 
 /***********************************************
- * Sensor tasks:
- * 	poll sensors, notify monitor task if there's
- * 	abormal reading.
+ * Sample processing:
+ * 	convert the raw reading, check it against
+ * 	the thresholds and store it in the FIFO.
+ * 	Shared by the sensor tasks and acq_engine.c
  ***********************************************/
-void vAccelSensorTask(void *pvParameters) {
-    TickType_t xLastWakeTime = xTaskGetTickCount();
-
-
-    Data3Axis accel_fifo_buffer[accel_fifo.size];
-    accel_fifo.data = accel_fifo_buffer;
-
-    Data3Axis accel_data;
-    int16_t accel_data_i16[3] = { 0 };
-    char message[50];
-    int response_delay;
-    float error;
-    double magnitude = 0;
-    for (;;) {
+/* Statistics, detectors, adaptive interval and rules of one sample; the 3
+ * axis sensors pass the magnitude and its square, which their rules compare
+ * */
+static void analyse(sensor_id sensor, float value, float mag_sq) {
+	STATS_Add(sensor, value);
+	ANOMALY_Update(sensor, value);
+	ADAPT_Update(sensor, value);
+	CEP_Update(sensor, value);
+
+	// alarm lines and LEDs on state changes only
+	if (sensor < SENSOR_TEMP) {
+		RULES_EvaluateSq(sensor, mag_sq);
+	}else{
+		RULES_Evaluate(sensor, value);
+	}
+}
 
-    if (xSemaphoreTake(xI2CMutex, portMAX_DELAY) == pdTRUE) {
-    	// Obtain the mg value
-		BSP_ACCELERO_AccGetXYZ(accel_data_i16);		// read accelerometer
+/* Decimate, analyse and store one converted 3 axis reading. A full FIFO is
+ * counted there (fifo.c) and reported by the system monitor.
+ * */
+static void process_motion(sensor_id sensor, FIFO3Axis *fifo, float *xyz, uint32_t t_sample) {
+	Data3Axis data;
+	float mag_sq;
+
+	// one sample per FILTER_Ratio() readings
+	if (FILTER_Push(sensor, xyz, xyz) != SUCCESS) {
+		return;
+	}
+	data.x = xyz[0];
+	data.y = xyz[1];
+	data.z = xyz[2];
+
+	HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
+	HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
+	data.milliSeconds = milliseconds;
+	data.Hours = sTime.Hours;
+	data.Minutes = sTime.Minutes;
+	data.Seconds = sTime.Seconds;
+
+	mag_sq = DSP_MagSq_f32(xyz);
+	analyse(sensor, sqrtf(mag_sq), mag_sq);
+
+	data.timestamp = TIMING_Micros();
+	if (FIFO_Write_3Axis(fifo, data)) {
+		LAT_Record(sensor, LAT_STAGE_SAMPLE_TO_FIFO, data.timestamp - t_sample);
+		BOOT_FirstSample(sensor);
+	}
+}
 
-		xSemaphoreGive(xI2CMutex);
+/* Same for an environmental reading, which is only stored when it left the deadband */
+static void process_env(sensor_id sensor, FIFO *fifo, float raw, uint32_t t_sample) {
+	Data data;
+	float error = (rand() % 10 - 5) / 100.0f;
+
+	data.value = raw * (1 + error);
+	if (FILTER_Push(sensor, &data.value, &data.value) != SUCCESS) {
+		return;
+	}
+
+	HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
+	HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
+	data.milliSeconds = milliseconds;
+	data.Hours = sTime.Hours;
+	data.Minutes = sTime.Minutes;
+	data.Seconds = sTime.Seconds;
+
+	analyse(sensor, data.value, 0);
+
+	// unchanged readings stop here, the next stored one counts them
+	if (!DEADBAND_Check(sensor, data.value, t_sample, &data.skipped)) {
+		return;
+	}
+
+	data.timestamp = TIMING_Micros();
+	if (FIFO_Write(fifo, data)) {
+		LAT_Record(sensor, LAT_STAGE_SAMPLE_TO_FIFO, data.timestamp - t_sample);
+		BOOT_FirstSample(sensor);
+	}
+}
 
-		error = (rand() % 10 - 5) / 100.0f;
+static void process_accel(uint32_t t_sample) {
+	float error = (rand() % 10 - 5) / 100.0f;
+	float xyz[3];
 
-		// the function above returns 16 bit integers which are 100 * acceleration_in_m/s2. Converting to float to print the actual acceleration.
-		accel_data.x = ((float)accel_data_i16[0] * 9.8 / 1000.0f) * (1 + error);
-		accel_data.y = ((float)accel_data_i16[1] * 9.8 / 1000.0f) * (1 + error);
-		accel_data.z = ((float)accel_data_i16[2] * 9.8 / 1000.0f) * (1 + error);
+	// BSP_ACCELERO_AccGetXYZ returns mg as 16 bit integers. Converting to float to print the actual acceleration.
+	DSP_Convert_i16(accel_raw, xyz, 3, 9.8f / 1000.0f * (1 + error));
+	process_motion(SENSOR_ACCEL, &accel_fifo, xyz, t_sample);
+}
 
+static void process_gyro(uint32_t t_sample) {
+	float error = (rand() % 10 - 5) / 100.0f;
+	float xyz[3];
 
-		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
+	// divide by 1000 for dps value
+	DSP_Scale_f32(gyro_raw, xyz, 3, (1 + error) / 1000.0f);
+	process_motion(SENSOR_GYRO, &gyro_fifo, xyz, t_sample);
+}
 
-		accel_data.milliSeconds = milliseconds;
-		accel_data.Hours = sTime.Hours;
-		accel_data.Minutes = sTime.Minutes;
-		accel_data.Seconds = sTime.Seconds;
+static void process_mag(uint32_t t_sample) {
+	float error = (rand() % 10 - 5) / 100.0f;
+	float xyz[3];
 
+	// divide by 1000 for gauss value
+	DSP_Convert_i16(mag_raw, xyz, 3, (1 + error) / 1000.0f);
+	process_motion(SENSOR_MAG, &mag_fifo, xyz, t_sample);
+}
 
-        // Check if data is abnormal
+static void process_temp(uint32_t t_sample) {
+	process_env(SENSOR_TEMP, &temp_fifo, temp_raw, t_sample);
+}
 
-        if (magnitude > accel.threshold_up || magnitude < accel.threshold_down) {
+static void process_humid(uint32_t t_sample) {
+	process_env(SENSOR_HUMID, &humid_fifo, humid_raw, t_sample);
+}
 
-    		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-    		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
+static void process_press(uint32_t t_sample) {
+	process_env(SENSOR_PRESS, &press_fifo, press_raw, t_sample);
+}
 
-        	// in case abnormal data, log message and flash led
-        	LEDG_Off();
-        	LEDO_On();
+// per sensor BSP read, raw buffer, processing and bus priority
+static const struct {
+	void (*read)(void *arg);
+	void *raw;
+	void (*process)(uint32_t t_sample);
+	i2c_prio prio;
+} sensor_ops[SENSOR_COUNT] = {
+	[SENSOR_ACCEL] = { read_accel, accel_raw, process_accel, I2C_PRIO_HIGH },
+	[SENSOR_GYRO]  = { read_gyro,  gyro_raw,  process_gyro,  I2C_PRIO_HIGH },
+	[SENSOR_MAG]   = { read_mag,   mag_raw,   process_mag,   I2C_PRIO_NORMAL },
+#if ACQ_MODE != ACQ_MODE_DRDY
+	[SENSOR_TEMP]  = { read_temp,  &temp_raw,  process_temp,  I2C_PRIO_LOW },
+	[SENSOR_HUMID] = { read_humid, &humid_raw, process_humid, I2C_PRIO_LOW },
+#else
+	[SENSOR_TEMP]  = { read_hts221, &temp_raw,  process_temp,  I2C_PRIO_LOW },
+	[SENSOR_HUMID] = { read_hts221, &humid_raw, process_humid, I2C_PRIO_LOW },
+#endif
+	[SENSOR_PRESS] = { read_press, &press_raw, process_press, I2C_PRIO_LOW },
+};
+
+/* Read the sensor into its raw buffer through the bus manager */
+int SENSOR_Read(sensor_id sensor) {
+#if ACQ_MODE == ACQ_MODE_DRDY
+	if (DRDY_Delivered(sensor)) {
+		return SUCCESS;		// read by the other task of the data-ready line
+	}
+	int status = I2C_BUS_Call(sensor_ops[sensor].read, sensor_ops[sensor].raw, sensor_ops[sensor].prio);
+	if (status == SUCCESS) {
+		DRDY_HandOver(sensor);
+	}
+	return status;
+#else
+	return I2C_BUS_Call(sensor_ops[sensor].read, sensor_ops[sensor].raw, sensor_ops[sensor].prio);
+#endif
+}
 
+/* Read the sensor into its raw buffer, only from code running on the
+ * I2C bus manager task (a function passed to I2C_BUS_Call)
+ * */
+void SENSOR_ReadRaw(sensor_id sensor) {
+	sensor_ops[sensor].read(sensor_ops[sensor].raw);
+}
 
-        	sprintf(message, "%02d:%02d:%02d:%03ld Abnormal accelerometer reading\r",
-        			accel_data.Hours, accel_data.Minutes, accel_data.Seconds, accel_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
+int SENSOR_BusPriority(sensor_id sensor) {
+	return sensor_ops[sensor].prio;
+}
 
-        	sprintf(message, "Alarm!!! Abnormal vibration!!!\r");
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
+/* ms between two readings: the sample interval divided by the oversampling ratio */
+int SENSOR_ReadInterval(sensor_id sensor) {
+	int interval = sensor_ctrl[sensor]->effective_interval / FILTER_Ratio(sensor);
+	return interval > 0 ? interval : 1;
+}
 
-            response_delay = (sTime.Hours - accel_data.Hours) * 3600000 + (sTime.Minutes - accel_data.Minutes) * 60000 +
-            		(sTime.Seconds - accel_data.Seconds) * 1000 + (milliseconds - accel_data.milliSeconds);
+/* Keep a complete copy of the new control data until the sensor's next sample */
+void SENSOR_Configure(sensor_id sensor, const sensor_ctrl_data *ctrl) {
+	taskENTER_CRITICAL();
+	staged_ctrl[sensor] = *ctrl;
+	staged[sensor] = 1;
+	taskEXIT_CRITICAL();
+}
 
-            sprintf(message, "delay (ms): %d\r\n\r\n", response_delay);
-            HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
+void SENSOR_GetConfig(sensor_id sensor, sensor_ctrl_data *ctrl) {
+	taskENTER_CRITICAL();
+	*ctrl = staged[sensor] ? staged_ctrl[sensor] : *sensor_ctrl[sensor];
+	taskEXIT_CRITICAL();
+}
 
+/* The control data must make sense as a whole, not each value on its own */
+const char *SENSOR_CheckConfig(const sensor_ctrl_data *ctrl) {
+	if (ctrl->interval <= 0) {
+		return "interval must be > 0";
+	}
+	if (ctrl->min_interval > 0 && (ctrl->min_interval > ctrl->interval || ctrl->max_interval < ctrl->interval)) {
+		return "need min_interval <= interval <= max_interval";
+	}
+	if (ctrl->threshold_down >= ctrl->threshold_up) {
+		return "need threshold_down < threshold_up";
+	}
+	if (ctrl->rate_limit < 0 || ctrl->deadband_abs < 0 || ctrl->deadband_rel < 0 || ctrl->max_silence < 0) {
+		return "negative limit";
+	}
+	if (ctrl->interval > SENSOR_MAX_INTERVAL_MS || ctrl->max_interval > SENSOR_MAX_INTERVAL_MS
+			|| ctrl->max_silence > SENSOR_MAX_INTERVAL_MS) {
+		return "interval or max_silence above SENSOR_MAX_INTERVAL_MS";
+	}
+	if (!isfinite(ctrl->threshold_up) || !isfinite(ctrl->threshold_down) || !isfinite(ctrl->rate_limit)
+			|| !isfinite(ctrl->deadband_abs) || !isfinite(ctrl->deadband_rel)) {
+		return "not a number";
+	}
+	return NULL;
+}
 
-        }else{
-        	LEDG_On();
-        	LEDO_Off();
-        }
+/* Take over staged control data, called by the code processing the sensor
+ * before a sample so that no sample sees half of the new values.
+ * The adaptive interval restarts from the new nominal interval.
+ * */
+void SENSOR_ApplyConfig(sensor_id sensor) {
+	if (!staged[sensor]) {
+		return;
+	}
+	taskENTER_CRITICAL();
+	*sensor_ctrl[sensor] = staged_ctrl[sensor];
+	sensor_ctrl[sensor]->effective_interval = staged_ctrl[sensor].interval;
+	staged[sensor] = 0;
+	taskEXIT_CRITICAL();
+	RULES_SetLimits(sensor);
+}
 
-        if (!FIFO_Write_3Axis(&accel_fifo, accel_data)) {
-        	sprintf(message, "%02d:%02d:%02d:%03ld Accelerometer FIFO overflow\r\n\r\n",
-        			accel_data.Hours, accel_data.Minutes, accel_data.Seconds, accel_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-        }
+/* Convert, check and store the last raw reading, sampled at t_sample (TIMING_Micros) */
+void SENSOR_Process(sensor_id sensor, uint32_t t_sample) {
+	SENSOR_ApplyConfig(sensor);
+	sensor_ops[sensor].process(t_sample);
+}
 
+/***********************************************
+ * Sensor tasks:
+ * 	poll sensors, notify monitor task if there's
+ * 	abormal reading.
+ ***********************************************/
+void vAccelSensorTask(void *pvParameters) {
+    TickType_t xLastWakeTime;
 
+    // first read as soon as the sensor has a valid conversion
+    vTaskDelay(SENSOR_StartupDelay(SENSOR_ACCEL));
+    xLastWakeTime = xTaskGetTickCount();
+    supervised_id[SENSOR_ACCEL] = SUPERVISOR_Register(sensor_name[SENSOR_ACCEL], 1, SUPERVISOR_SENSOR_BUDGET_US);
+#if ACQ_MODE == ACQ_MODE_DRDY
+    DRDY_Attach(SENSOR_ACCEL);
+#endif
 
-    }
+    for (;;) {
+    	if (SENSOR_Read(SENSOR_ACCEL) == SUCCESS) {
+    		SENSOR_Process(SENSOR_ACCEL, TIMING_Micros());
+    	}
 
-        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(accel.interval + (rand() % 10) + 10));
+        wait_next_sample(SENSOR_ACCEL, &xLastWakeTime, 10);
     }
 }
 
 void vGyroSensorTask(void *pvParameters) {
-    TickType_t xLastWakeTime = xTaskGetTickCount();
+    TickType_t xLastWakeTime;
 
-    Data3Axis gyro_fifo_buffer[gyro_fifo.size];
-    gyro_fifo.data = gyro_fifo_buffer;
+    // first read as soon as the sensor has a valid conversion
+    vTaskDelay(SENSOR_StartupDelay(SENSOR_GYRO));
+    xLastWakeTime = xTaskGetTickCount();
+    supervised_id[SENSOR_GYRO] = SUPERVISOR_Register(sensor_name[SENSOR_GYRO], 1, SUPERVISOR_SENSOR_BUDGET_US);
+#if ACQ_MODE == ACQ_MODE_DRDY
+    DRDY_Attach(SENSOR_GYRO);
+#endif
 
-    Data3Axis gyro_data;
-	float gyro_data_i16[3] = { 0 };
-	char message[50];
-	int response_delay;
-	float error;
-	double magnitude;
     for (;;) {
+    	if (SENSOR_Read(SENSOR_GYRO) == SUCCESS) {
+    		SENSOR_Process(SENSOR_GYRO, TIMING_Micros());
+    	}
 
-    	if (xSemaphoreTake(xI2CMutex, portMAX_DELAY) == pdTRUE) {
-
-    	// mdps value
-		BSP_GYRO_GetXYZ(gyro_data_i16);
-		xSemaphoreGive(xI2CMutex);
-
-		error = (rand() % 10 - 5) / 100.0f;
-
-		// divide by 1000 for dps value
-		gyro_data.x = ((float)gyro_data_i16[0] / 1000.0f) * (1 + error);
-		gyro_data.y = ((float)gyro_data_i16[1] / 1000.0f) * (1 + error);
-		gyro_data.z = ((float)gyro_data_i16[2] / 1000.0f) * (1 + error);
-
-		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-		gyro_data.milliSeconds = milliseconds;
-		gyro_data.Hours = sTime.Hours;
-		gyro_data.Minutes = sTime.Minutes;
-		gyro_data.Seconds = sTime.Seconds;
-
-		// TODO: Check if data is abnormal, confirm threshold values
-		magnitude = sqrt(gyro_data.x * gyro_data.x + gyro_data.y * gyro_data.y + gyro_data.z * gyro_data.z);
-
-        if (magnitude > gyro.threshold_up || magnitude < gyro.threshold_down) {
-
-    		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-    		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-        	// in case abnormal data, log message and flash led
-        	LEDG_Off();
-        	LEDO_On();
-
-
-        	sprintf(message, "%02d:%02d:%02d:%03ld Abnormal gyroscope reading\r",
-        			gyro_data.Hours, gyro_data.Minutes, gyro_data.Seconds, gyro_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        	sprintf(message, "Alarm!!! Abnormal vibration!!!\r");
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-            response_delay = (sTime.Hours - gyro_data.Hours) * 3600000 + (sTime.Minutes - gyro_data.Minutes) * 60000 +
-            		(sTime.Seconds - gyro_data.Seconds) * 1000 + (milliseconds - gyro_data.milliSeconds);
-
-            sprintf(message, "delay (ms): %d\r\n\r\n", response_delay);
-            HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        }else{
-        	LEDG_On();
-        	LEDO_Off();
-        }
-
-
-        if (!FIFO_Write_3Axis(&gyro_fifo, gyro_data)) {
-        	sprintf(message, "%02d:%02d:%02d:%03ld Gyroscope FIFO overflow\r\n\r\n",
-        			gyro_data.Hours, gyro_data.Minutes, gyro_data.Seconds, gyro_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-        }
-
-
-    }
-
-		vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(gyro.interval + (rand() % 20) + 10));
+        wait_next_sample(SENSOR_GYRO, &xLastWakeTime, 20);
     }
 }
 
 void vMagSensorTask(void *pvParameters) {
-    TickType_t xLastWakeTime = xTaskGetTickCount();
-
-    Data3Axis mag_fifo_buffer[mag_fifo.size];
-    mag_fifo.data = mag_fifo_buffer;
+    TickType_t xLastWakeTime;
 
-    Data3Axis mag_data;
-	int16_t mag_data_i16[3] = { 0 };
-    char message[50];
+    // first read as soon as the sensor has a valid conversion
+    vTaskDelay(SENSOR_StartupDelay(SENSOR_MAG));
+    xLastWakeTime = xTaskGetTickCount();
+    supervised_id[SENSOR_MAG] = SUPERVISOR_Register(sensor_name[SENSOR_MAG], 1, SUPERVISOR_SENSOR_BUDGET_US);
+#if ACQ_MODE == ACQ_MODE_DRDY
+    DRDY_Attach(SENSOR_MAG);
+#endif
 
-    int response_delay;
-    float error;
-    double magnitude;
     for (;;) {
+    	if (SENSOR_Read(SENSOR_MAG) == SUCCESS) {
+    		SENSOR_Process(SENSOR_MAG, TIMING_Micros());
+    	}
 
-    	if (xSemaphoreTake(xI2CMutex, portMAX_DELAY) == pdTRUE) {
-
-    	// mGauss values
-		BSP_MAGNETO_GetXYZ(mag_data_i16);
-		xSemaphoreGive(xI2CMutex);
-
-		error = (rand() % 10 - 5) / 100.0f;
-		// divide by 1000 for gauss value
-		mag_data.x = ((float)mag_data_i16[0] / 1000.0f) * (1 + error);
-		mag_data.y = ((float)mag_data_i16[1] / 1000.0f) * (1 + error);
-		mag_data.z = ((float)mag_data_i16[2] / 1000.0f) * (1 + error);
-
-		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-		mag_data.milliSeconds = milliseconds;
-		mag_data.Hours = sTime.Hours;
-		mag_data.Minutes = sTime.Minutes;
-		mag_data.Seconds = sTime.Seconds;
-
-        // TODO: Check if data is abnormal, confirm threshold values
-		magnitude = sqrt(mag_data.x * mag_data.x + mag_data.y * mag_data.y + mag_data.z * mag_data.z);
-
-        if (magnitude > mag.threshold_up || magnitude < mag.threshold_down) {
-
-    		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-    		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-        	// in case abnormal data, log message and flash led
-        	LEDG_Off();
-        	LEDO_On();
-
-
-        	sprintf(message, "%02d:%02d:%02d:%03ld Abnormal magnetometer reading\r",
-        			mag_data.Hours, mag_data.Minutes, mag_data.Seconds, mag_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        	sprintf(message, "Turning on electromagnetic protection system...\r");
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-
-            response_delay = (sTime.Hours - mag_data.Hours) * 3600000 + (sTime.Minutes - mag_data.Minutes) * 60000 +
-            		(sTime.Seconds - mag_data.Seconds) * 1000 + (milliseconds - mag_data.milliSeconds);
-
-            sprintf(message, "delay (ms): %d\r\n\r\n", response_delay);
-            HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-
-
-        }else{
-        	LEDG_On();
-        	LEDO_Off();
-        }
-
-
-        if (!FIFO_Write_3Axis(&mag_fifo, mag_data)) {
-        	sprintf(message, "%02d:%02d:%02d:%03ld Magnetometer FIFO overflow\r\n\r\n",
-        			mag_data.Hours, mag_data.Minutes, mag_data.Seconds, mag_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-        }
-
-
-    }
-
-
-        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(mag.interval + (rand() % 20) + 10));
+        wait_next_sample(SENSOR_MAG, &xLastWakeTime, 20);
     }
 }
 
-
-
 void vTempSensorTask(void *pvParameters) {
-    TickType_t xLastWakeTime = xTaskGetTickCount();
-
-    Data temp_fifo_buffer[temp_fifo.size];
-    temp_fifo.data = temp_fifo_buffer;
+    TickType_t xLastWakeTime;
 
-    Data temp_data;
-    char message[50];
+    // first read as soon as the sensor has a valid conversion
+    vTaskDelay(SENSOR_StartupDelay(SENSOR_TEMP));
+    xLastWakeTime = xTaskGetTickCount();
+    supervised_id[SENSOR_TEMP] = SUPERVISOR_Register(sensor_name[SENSOR_TEMP], 1, SUPERVISOR_SENSOR_BUDGET_US);
+#if ACQ_MODE == ACQ_MODE_DRDY
+    DRDY_Attach(SENSOR_TEMP);
+#endif
 
-    int response_delay;
-    float error;
     for (;;) {
+    	if (SENSOR_Read(SENSOR_TEMP) == SUCCESS) {
+    		SENSOR_Process(SENSOR_TEMP, TIMING_Micros());
+    	}
 
-    	if (xSemaphoreTake(xI2CMutex, portMAX_DELAY) == pdTRUE) {
-
-    	error = (rand() % 10 - 5) / 100.0f;
-
-        temp_data.value = BSP_TSENSOR_ReadTemp() * (1 + error);
-        xSemaphoreGive(xI2CMutex);
-
-
-        HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-        HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-        temp_data.milliSeconds = milliseconds;
-		temp_data.Hours = sTime.Hours;
-		temp_data.Minutes = sTime.Minutes;
-		temp_data.Seconds = sTime.Seconds;
-
-        //Check if data is abnormal
-        if (temp_data.value > temp.threshold_up) {
-
-    		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-    		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-        	// in case abnormal data, log message and flash led
-        	LEDG_Off();
-        	LEDO_On();
-
-
-        	sprintf(message, "%02d:%02d:%02d:%03ld Abnormal HIGH temperature reading\r",
-        			temp_data.Hours, temp_data.Minutes, temp_data.Seconds, temp_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        	sprintf(message, "Turning on cooling system...\r");
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-            response_delay = (sTime.Hours - temp_data.Hours) * 3600000 + (sTime.Minutes - temp_data.Minutes) * 60000 +
-            		(sTime.Seconds - temp_data.Seconds) * 1000 + (milliseconds - temp_data.milliSeconds);
-
-            sprintf(message, "delay (ms): %d\r\n\r\n", response_delay);
-            HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        }else if (temp_data.value < temp.threshold_down) {
-
-    		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-    		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-        	// in case abnormal data, log message and flash led
-        	LEDG_Off();
-        	LEDO_On();
-
-
-        	sprintf(message, "%02d:%02d:%02d:%03ld Abnormal LOW temperature reading\r",
-        			temp_data.Hours, temp_data.Minutes, temp_data.Seconds, temp_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        	sprintf(message, "Turning on heating system...\r");
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-            response_delay = (sTime.Hours - temp_data.Hours) * 3600000 + (sTime.Minutes - temp_data.Minutes) * 60000 +
-            		(sTime.Seconds - temp_data.Seconds) * 1000 + (milliseconds - temp_data.milliSeconds);
-
-            sprintf(message, "delay (ms): %d\r\n\r\n", response_delay);
-            HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        }else{
-        	LEDG_On();
-        	LEDO_Off();
-        }
-
-        if (!FIFO_Write(&temp_fifo, temp_data)) {
-        	sprintf(message, "%02d:%02d:%02d:%03ld Temperature Sensor FIFO overflow\r\n\r\n",
-        			temp_data.Hours, temp_data.Minutes, temp_data.Seconds, temp_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-        }
-
-    }
-
-        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(temp.interval + (rand() % 20) + 10));
+        wait_next_sample(SENSOR_TEMP, &xLastWakeTime, 20);
     }
 }
 
 void vHumidSensorTask(void *pvParameters) {
-    TickType_t xLastWakeTime = xTaskGetTickCount();
-
-    Data humid_fifo_buffer[humid_fifo.size];
-    humid_fifo.data = humid_fifo_buffer;
+    TickType_t xLastWakeTime;
 
-    Data humid_data;
-    char message[50];
+    // first read as soon as the sensor has a valid conversion
+    vTaskDelay(SENSOR_StartupDelay(SENSOR_HUMID));
+    xLastWakeTime = xTaskGetTickCount();
+    supervised_id[SENSOR_HUMID] = SUPERVISOR_Register(sensor_name[SENSOR_HUMID], 1, SUPERVISOR_SENSOR_BUDGET_US);
+#if ACQ_MODE == ACQ_MODE_DRDY
+    DRDY_Attach(SENSOR_HUMID);
+#endif
 
-    int response_delay;
-    float error;
     for (;;) {
+    	if (SENSOR_Read(SENSOR_HUMID) == SUCCESS) {
+    		SENSOR_Process(SENSOR_HUMID, TIMING_Micros());
+    	}
 
-    	if (xSemaphoreTake(xI2CMutex, portMAX_DELAY) == pdTRUE) {
-
-    	error = (rand() % 10 - 5) / 100.0f;
-
-        humid_data.value = BSP_HSENSOR_ReadHumidity() * (1 + error);
-        xSemaphoreGive(xI2CMutex);
-
-        HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-        HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-        humid_data.milliSeconds = milliseconds;
-		humid_data.Hours = sTime.Hours;
-		humid_data.Minutes = sTime.Minutes;
-		humid_data.Seconds = sTime.Seconds;
-
-
-        //TODO: check threshold. Check if data is abnormal
-        if (humid_data.value > humid.threshold_up) {
-
-    		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-    		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-        	// in case abnormal data, log message and flash led
-        	LEDG_Off();
-        	LEDO_On();
-
-
-        	sprintf(message, "%02d:%02d:%02d:%03ld Abnormal HIGH humidity reading\r",
-        			humid_data.Hours, humid_data.Minutes, humid_data.Seconds, humid_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        	sprintf(message, "Turning on dehumidifier...\r");
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-            response_delay = (sTime.Hours - humid_data.Hours) * 3600000 + (sTime.Minutes - humid_data.Minutes) * 60000 +
-            		(sTime.Seconds - humid_data.Seconds) * 1000 + (milliseconds - humid_data.milliSeconds);
-
-            sprintf(message, "delay (ms): %d\r\n\r\n", response_delay);
-            HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        }else if (humid_data.value < humid.threshold_down) {
-
-    		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-    		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-        	// in case abnormal data, log message and flash led
-        	LEDG_Off();
-        	LEDO_On();
-
-
-        	sprintf(message, "%02d:%02d:%02d:%03ld Abnormal LOW humidity reading\r",
-        			humid_data.Hours, humid_data.Minutes, humid_data.Seconds, humid_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        	sprintf(message, "Turning on humidifier...\r");
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-            response_delay = (sTime.Hours - humid_data.Hours) * 3600000 + (sTime.Minutes - humid_data.Minutes) * 60000 +
-            		(sTime.Seconds - humid_data.Seconds) * 1000 + (milliseconds - humid_data.milliSeconds);
-
-            sprintf(message, "delay (ms): %d\r\n\r\n", response_delay);
-            HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        }else{
-        	LEDG_On();
-        	LEDO_Off();
-        }
-
-
-        if (!FIFO_Write(&humid_fifo, humid_data)) {
-        	sprintf(message, "%02d:%02d:%02d:%03ld Humidity Sensor FIFO overflow\r\n\r\n",
-        			humid_data.Hours, humid_data.Minutes, humid_data.Seconds, humid_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-        }
-
-
-
-    }
-
-        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(humid.interval + (rand() % 20) + 10));
+        wait_next_sample(SENSOR_HUMID, &xLastWakeTime, 20);
     }
 }
 
 void vPressSensorTask(void *pvParameters) {
-    TickType_t xLastWakeTime = xTaskGetTickCount();
+    TickType_t xLastWakeTime;
 
-    Data press_fifo_buffer[press_fifo.size];
-    press_fifo.data = press_fifo_buffer;
+    // first read as soon as the sensor has a valid conversion
+    vTaskDelay(SENSOR_StartupDelay(SENSOR_PRESS));
+    xLastWakeTime = xTaskGetTickCount();
+    supervised_id[SENSOR_PRESS] = SUPERVISOR_Register(sensor_name[SENSOR_PRESS], 1, SUPERVISOR_SENSOR_BUDGET_US);
+#if ACQ_MODE == ACQ_MODE_DRDY
+    DRDY_Attach(SENSOR_PRESS);
+#endif
 
-    Data press_data;
-
-    char message[50];
-
-    int response_delay;
-    float error;
     for (;;) {
+    	if (SENSOR_Read(SENSOR_PRESS) == SUCCESS) {
+    		SENSOR_Process(SENSOR_PRESS, TIMING_Micros());
+    	}
 
-    	if (xSemaphoreTake(xI2CMutex, portMAX_DELAY) == pdTRUE) {
-
-    	error = (rand() % 10 - 5) / 100.0f;
-
-    	// 260 - 1260 hPa
-        press_data.value = BSP_PSENSOR_ReadPressure() * (1 + error);
-        xSemaphoreGive(xI2CMutex);
-
-        HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-        HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-        press_data.milliSeconds = milliseconds;
-		press_data.Hours = sTime.Hours;
-		press_data.Minutes = sTime.Minutes;
-		press_data.Seconds = sTime.Seconds;
-
-        //TODO: check threshold. Check if data is abnormal
-        if (press_data.value > press.threshold_up) {
-
-    		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-    		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-        	// in case abnormal data, log message and flash led
-        	LEDG_Off();
-        	LEDO_On();
-
-
-        	sprintf(message, "%02d:%02d:%02d:%03ld Abnormal HIGH pressure reading\r",
-        			press_data.Hours, press_data.Minutes, press_data.Seconds, press_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        	sprintf(message, "Releasing pressure valve...\r");
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-            response_delay = (sTime.Hours - press_data.Hours) * 3600000 + (sTime.Minutes - press_data.Minutes) * 60000 +
-            		(sTime.Seconds - press_data.Seconds) * 1000 + (milliseconds - press_data.milliSeconds);
-
-            sprintf(message, "delay (ms): %d\r\n\r\n", response_delay);
-            HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-
-        }else if (press_data.value < press.threshold_down) {
-
-    		HAL_RTC_GetTime(&hrtc, &sTime, RTC_FORMAT_BIN);
-    		HAL_RTC_GetDate(&hrtc, &sDate, RTC_FORMAT_BIN);
-
-        	// in case abnormal data, log message and flash led
-        	LEDG_Off();
-        	LEDO_On();
-
-
-        	sprintf(message, "%02d:%02d:%02d:%03ld Abnormal LOW pressure reading\r",
-        			press_data.Hours, press_data.Minutes, press_data.Seconds, press_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        	sprintf(message, "Turning on pressure pump...\r");
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-            response_delay = (sTime.Hours - press_data.Hours) * 3600000 + (sTime.Minutes - press_data.Minutes) * 60000 +
-            		(sTime.Seconds - press_data.Seconds) * 1000 + (milliseconds - press_data.milliSeconds);
-
-            sprintf(message, "delay (ms): %d\r\n\r\n", response_delay);
-            HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-
-        }else{
-        	LEDG_On();
-        	LEDO_Off();
-        }
-
-
-        if (!FIFO_Write(&press_fifo, press_data)) {
-        	sprintf(message, "%02d:%02d:%02d:%03ld Pressure Sensor FIFO overflow\r\n\r\n",
-        			press_data.Hours, press_data.Minutes, press_data.Seconds, press_data.milliSeconds);
-        	HAL_UART_Transmit(&huart1, (uint8_t*)message, strlen(message), 1000);
-        }
-
-
-    }
-
-
-        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(press.interval + (rand() % 20) + 10));
+        wait_next_sample(SENSOR_PRESS, &xLastWakeTime, 20);
     }
 }
 
-
-
 // LED0: green LED
 // LED1: orange LED
 void LED_Init(void) {
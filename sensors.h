@@ -55,12 +55,60 @@
 #define SUCCESS 1
 #define FAILURE 0
 
+/* Acquisition of the accelerometer, gyroscope and magnetometer:
+ * 	ACQ_MODE_POLL	one BSP_*_GetXYZ() per task wake (vAccel/vGyro/vMagSensorTask)
+ * 	ACQ_MODE_HWFIFO	LSM6DSL FIFO drained with burst reads on its watermark (imu_fifo.c)
+ * 	ACQ_MODE_DRDY	every sensor task wakes on its data-ready interrupt (drdy.c)
+ * */
+#define ACQ_MODE_POLL	0
+#define ACQ_MODE_HWFIFO	1
+#define ACQ_MODE_DRDY	2
+
+#ifndef ACQ_MODE
+#define ACQ_MODE ACQ_MODE_POLL
+#endif
+
+/* Who runs the periodic reads in ACQ_MODE_POLL:
+ * 	ACQ_ENGINE_TASKS	one task per sensor (vAccelSensorTask ... vPressSensorTask)
+ * 	ACQ_ENGINE_HEAP		a single task serving all sensors from a deadline heap (acq_engine.c)
+ * */
+#define ACQ_ENGINE_TASKS	0
+#define ACQ_ENGINE_HEAP		1
+
+#ifndef ACQ_ENGINE
+#define ACQ_ENGINE ACQ_ENGINE_TASKS
+#endif
+
+// software FIFO depth of the motion and the environmental sensors
+#define MOTION_FIFO_SIZE 32
+#define ENV_FIFO_SIZE 16
+
 typedef void (*callback)(void);
 
+// sensor index, same order as the FIFO index used by the scheduler
+typedef enum{
+	SENSOR_ACCEL = 0,
+	SENSOR_GYRO,
+	SENSOR_MAG,
+	SENSOR_TEMP,
+	SENSOR_HUMID,
+	SENSOR_PRESS,
+	SENSOR_COUNT
+}sensor_id;
+
+extern const char *const sensor_name[SENSOR_COUNT];
+
 typedef struct{
-	int interval;
+	int interval;			// nominal sampling interval in ms
+	int min_interval;		// adaptive range (adaptive.c), 0: always the nominal interval
+	int max_interval;
+	volatile int effective_interval;	// interval the acquisition currently uses
 	float threshold_up;
 	float threshold_down;
+	float rate_limit;		// max |change| per second, 0: no rate rule (rules.c)
+	float deadband_abs;		// report-on-change band (deadband.c), 0/0: every reading stored
+	float deadband_rel;		// fraction of the last stored value
+	int max_silence;		// ms without a stored reading before one is stored anyway, 0: none
 }sensor_ctrl_data;
 
 
@@ -71,6 +119,9 @@ extern sensor_ctrl_data temp;
 extern sensor_ctrl_data humid;
 extern sensor_ctrl_data press;
 
+// control data by sensor_id
+extern sensor_ctrl_data *const sensor_ctrl[SENSOR_COUNT];
+
 extern FIFO3Axis accel_fifo;
 extern FIFO3Axis gyro_fifo;
 extern FIFO3Axis mag_fifo;
@@ -81,7 +132,25 @@ extern FIFO press_fifo;
 
 
 int sensors_init();
-void initI2CMutex();
+
+int SENSOR_Read(sensor_id sensor);
+void SENSOR_ReadRaw(sensor_id sensor);
+int SENSOR_BusPriority(sensor_id sensor);
+int SENSOR_ReadInterval(sensor_id sensor);
+// ticks until the first valid conversion after sensors_init(), 0 once there
+TickType_t SENSOR_StartupDelay(sensor_id sensor);
+void SENSOR_Process(sensor_id sensor, uint32_t t_sample);
+// new control data from another task (console.c), taken over between two samples
+void SENSOR_Configure(sensor_id sensor, const sensor_ctrl_data *ctrl);
+void SENSOR_ApplyConfig(sensor_id sensor);
+// staged control data if any, else the one in use
+void SENSOR_GetConfig(sensor_id sensor, sensor_ctrl_data *ctrl);
+/* Longest interval and max_silence: in ticks, in microseconds (deadband.c)
+ * and times the data-ready rate (drdy.c) they must stay within 32 bits
+ * */
+#define SENSOR_MAX_INTERVAL_MS 3600000
+// NULL if the values are consistent, else what is wrong
+const char *SENSOR_CheckConfig(const sensor_ctrl_data *ctrl);
 
 void vAccelSensorTask(void *pvParameters);
 void vGyroSensorTask(void *pvParameters);
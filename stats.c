@@ -0,0 +1,176 @@
+/*
+ * stats.c
+ *
+ * Purpose: Keep streaming statistics of every sensor on the device.
+ * Content:
+ * Welford mean/variance with min/max, merge of two accumulators.
+ * Tumbling windows (STATS_WINDOWS_MS) and a sliding window built from
+ * buckets, per sensor.
+ *
+ * The sensor code adds each processed value; the scheduler takes the closed
+ * tumbling windows (OUTPUT_SUMMARY), or the sliding window each time it
+ * moved by a bucket (OUTPUT_SLIDING), to print one summary line instead of
+ * every sample. Nothing is stored per sample, so the memory does not
+ * depend on the rates.
+ */
+
+#include "stats.h"
+#include <math.h>
+#include <string.h>
+
+static const uint32_t window_ms[STATS_WINDOW_COUNT] = STATS_WINDOWS_MS;
+
+#define BUCKET_TICKS pdMS_TO_TICKS(STATS_SLIDING_MS / STATS_SLIDING_BUCKETS)
+
+typedef struct {
+	stats_acc current[STATS_WINDOW_COUNT];
+	stats_acc closed[STATS_WINDOW_COUNT];
+	TickType_t start[STATS_WINDOW_COUNT];
+	uint8_t ready;						// bit per window: closed holds a window not taken yet
+
+	stats_acc bucket[STATS_SLIDING_BUCKETS];
+	TickType_t bucket_id[STATS_SLIDING_BUCKETS];
+	TickType_t slid;					// bucket of the last STATS_Sliding()
+} sensor_stats;
+
+static sensor_stats stats[SENSOR_COUNT];
+
+static void reset(stats_acc *acc) {
+	memset(acc, 0, sizeof(*acc));
+}
+
+void STATS_Init(void) {
+	TickType_t now = xTaskGetTickCount();
+
+	memset(stats, 0, sizeof(stats));
+	for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+		for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+			stats[sensor].start[w] = now;
+		}
+		for (int b = 0; b < STATS_SLIDING_BUCKETS; b++) {
+			stats[sensor].bucket_id[b] = (TickType_t)-1;
+		}
+		stats[sensor].slid = now / BUCKET_TICKS;
+	}
+}
+
+void STATS_Accumulate(stats_acc *acc, float value) {
+	float delta = value - acc->mean;
+
+	acc->count++;
+	acc->mean += delta / acc->count;
+	acc->m2 += delta * (value - acc->mean);
+
+	if (acc->count == 1 || value < acc->min) { acc->min = value; }
+	if (acc->count == 1 || value > acc->max) { acc->max = value; }
+}
+
+/* Combine two accumulators as if all values had been added to one (Chan et al.) */
+void STATS_Merge(stats_acc *into, const stats_acc *from) {
+	if (from->count == 0) {
+		return;
+	}
+	if (into->count == 0) {
+		*into = *from;
+		return;
+	}
+
+	uint32_t count = into->count + from->count;
+	float delta = from->mean - into->mean;
+
+	into->mean += delta * from->count / count;
+	into->m2 += from->m2 + delta * delta * ((float)into->count * from->count / count);
+	into->count = count;
+	if (from->min < into->min) { into->min = from->min; }
+	if (from->max > into->max) { into->max = from->max; }
+}
+
+float STATS_Variance(const stats_acc *acc) {
+	return acc->count > 1 ? acc->m2 / (acc->count - 1) : 0;
+}
+
+float STATS_StdDev(const stats_acc *acc) {
+	return sqrtf(STATS_Variance(acc));
+}
+
+/* Close the tumbling windows whose time is over, called with the sensor locked.
+ * A window closed before the previous one was taken replaces it.
+ * */
+static void close_windows(sensor_stats *s, TickType_t now) {
+	for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+		TickType_t length = pdMS_TO_TICKS(window_ms[w]);
+		TickType_t elapsed = now - s->start[w];
+
+		if (elapsed >= length) {
+			s->closed[w] = s->current[w];
+			s->ready |= 1 << w;
+			reset(&s->current[w]);
+			s->start[w] = now - elapsed % length;	// stay on the window grid
+		}
+	}
+}
+
+void STATS_Add(sensor_id sensor, float value) {
+	sensor_stats *s = &stats[sensor];
+	TickType_t now = xTaskGetTickCount();
+	TickType_t id = now / BUCKET_TICKS;
+	int slot = id % STATS_SLIDING_BUCKETS;
+
+	taskENTER_CRITICAL();
+	close_windows(s, now);
+	for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+		STATS_Accumulate(&s->current[w], value);
+	}
+	if (s->bucket_id[slot] != id) {
+		s->bucket_id[slot] = id;
+		reset(&s->bucket[slot]);
+	}
+	STATS_Accumulate(&s->bucket[slot], value);
+	taskEXIT_CRITICAL();
+}
+
+/* Copy the last closed tumbling window of the given index.
+ * Returns SUCCESS once per window, FAILURE if no new window closed since.
+ * */
+int STATS_TakeWindow(sensor_id sensor, int window, stats_acc *acc) {
+	sensor_stats *s = &stats[sensor];
+	int status = FAILURE;
+
+	taskENTER_CRITICAL();
+	close_windows(s, xTaskGetTickCount());
+	if (s->ready & (1 << window)) {
+		*acc = s->closed[window];
+		s->ready &= ~(1 << window);
+		status = SUCCESS;
+	}
+	taskEXIT_CRITICAL();
+	return status;
+}
+
+uint32_t STATS_WindowMs(int window) {
+	return window_ms[window];
+}
+
+/* Values of the last STATS_SLIDING_BUCKETS - 1 complete buckets and the
+ * current one, so up to STATS_SLIDING_MS. Returns SUCCESS once per bucket,
+ * FAILURE if the window has not moved since the last call.
+ * */
+int STATS_Sliding(sensor_id sensor, stats_acc *acc) {
+	sensor_stats *s = &stats[sensor];
+	TickType_t id = xTaskGetTickCount() / BUCKET_TICKS;
+
+	if (id == s->slid) {
+		return FAILURE;
+	}
+	s->slid = id;
+
+	reset(acc);
+	taskENTER_CRITICAL();
+	for (int b = 0; b < STATS_SLIDING_BUCKETS; b++) {
+		if (id - s->bucket_id[b] < STATS_SLIDING_BUCKETS) {
+			STATS_Merge(acc, &s->bucket[b]);
+		}
+	}
+	taskEXIT_CRITICAL();
+	return SUCCESS;
+}
@@ -0,0 +1,47 @@
+/*
+ * stats.h
+ *
+ * Purpose: Declare the streaming per sensor statistics.
+ * Content:
+ * Running accumulator (count, mean, variance, min, max), window lengths
+ * and the functions feeding and reading the tumbling and sliding windows.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "sensors.h"
+
+// tumbling window lengths in ms, closed windows are kept until taken
+#define STATS_WINDOWS_MS { 1000, 10000, 60000 }
+#define STATS_WINDOW_COUNT 3
+
+// sliding window: STATS_SLIDING_MS covered by STATS_SLIDING_BUCKETS buckets
+#ifndef STATS_SLIDING_MS
+#define STATS_SLIDING_MS 10000
+#endif
+#define STATS_SLIDING_BUCKETS 5
+
+typedef struct {
+	uint32_t count;
+	float mean;
+	float m2;		// sum of squared differences from the mean (Welford)
+	float min;
+	float max;
+} stats_acc;
+
+void STATS_Init(void);
+
+// 3 axis sensors feed the magnitude
+void STATS_Add(sensor_id sensor, float value);
+
+void STATS_Accumulate(stats_acc *acc, float value);
+void STATS_Merge(stats_acc *into, const stats_acc *from);
+float STATS_Variance(const stats_acc *acc);
+float STATS_StdDev(const stats_acc *acc);
+
+int STATS_TakeWindow(sensor_id sensor, int window, stats_acc *acc);
+uint32_t STATS_WindowMs(int window);
+int STATS_Sliding(sensor_id sensor, stats_acc *acc);
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * supervisor.c
+ *
+ * Purpose: Notice when the periodic tasks fall behind, and reset if they stop.
+ * Content:
+ * Per activity expected release and deadline, late release, deadline miss
+ * and execution budget overrun counts, execution time histograms,
+ * supervisor task feeding the IWDG, report printed by the scheduler.
+ *
+ * Nothing checked whether vTaskDelayUntil() was met: a blocking print or
+ * I2C contention shifted the samples unnoticed until a FIFO overflowed.
+ * A supervised task calls SUPERVISOR_Begin() when a job starts and
+ * SUPERVISOR_End() when it is done, with its next release and period; the
+ * job's deadline is the next release (implicit deadline), so a longer
+ * adaptive interval moves the deadline with it. A job finishing after its
+ * deadline is a miss, one running longer than its budget an overrun. The
+ * supervisor task runs above all of them and feeds the watchdog only while
+ * every critical activity is within its deadline plus SUPERVISOR_GRACE_MS
+ * and has fewer than SUPERVISOR_MISS_LIMIT misses in a row; a stuck or
+ * persistently late task therefore ends in a watchdog reset.
+ * The execution times, periods and priorities are dumped on request for
+ * the response-time analysis in tools/schedulability.py.
+ */
+
+#include "supervisor.h"
+#include "timing.h"
+#include "latency.h"
+#include <stdio.h>
+#include <string.h>
+
+#if SUPERVISOR_ENABLE
+
+typedef struct {
+	const char *name;
+	uint8_t critical;
+	UBaseType_t priority;
+	uint8_t armed;			// a deadline is known, set by the first End
+	uint8_t running;
+	uint8_t miss_run;		// consecutive deadline misses
+	uint32_t budget_us;
+	TickType_t release;		// expected release of the current or next job
+	TickType_t deadline;
+	uint32_t start_us;
+	uint32_t jobs, misses, overruns;
+	TickType_t late_max;
+	TickType_t period_min;		// shortest period seen, the rate for the analysis
+	lat_histogram exec;			// execution time distribution, us
+} supervised;
+
+static supervised activity[SUPERVISOR_MAX];
+static int activity_count;
+static IWDG_HandleTypeDef hiwdg;
+static uint32_t withheld;		// checks that did not feed the watchdog
+static int watchdog_reset;
+
+static int before(TickType_t a, TickType_t b) {
+	return (int32_t)(a - b) < 0;
+}
+
+/* 1 if the previous reset came from the watchdog */
+int SUPERVISOR_Init(void) {
+	memset(activity, 0, sizeof(activity));
+	activity_count = 0;
+	withheld = 0;
+	watchdog_reset = __HAL_RCC_GET_FLAG(RCC_FLAG_IWDGRST) != 0;
+	__HAL_RCC_CLEAR_RESET_FLAGS();
+	return watchdog_reset;
+}
+
+/* Called by a task before its first job, -1 when full: the task runs unsupervised */
+int SUPERVISOR_Register(const char *name, int critical, uint32_t budget_us) {
+	int id = -1;
+
+	taskENTER_CRITICAL();
+	if (activity_count < SUPERVISOR_MAX) {
+		id = activity_count++;
+		activity[id].name = name;
+		activity[id].critical = critical;
+		activity[id].budget_us = budget_us;
+		activity[id].priority = uxTaskPriorityGet(NULL);
+	}
+	taskEXIT_CRITICAL();
+	return id;
+}
+
+void SUPERVISOR_Begin(int id) {
+	if (id < 0) {
+		return;
+	}
+	supervised *s = &activity[id];
+	TickType_t now = xTaskGetTickCount();
+
+	if (s->armed && before(s->release, now) && now - s->release > s->late_max) {
+		s->late_max = now - s->release;
+	}
+	s->start_us = TIMING_Micros();
+	s->running = 1;
+}
+
+void SUPERVISOR_End(int id, TickType_t next_release, TickType_t period) {
+	if (id < 0) {
+		return;
+	}
+	supervised *s = &activity[id];
+	TickType_t now = xTaskGetTickCount();
+
+	if (s->running) {
+		uint32_t exec_us = TIMING_Micros() - s->start_us;
+		s->jobs++;
+		LAT_Add(&s->exec, exec_us);
+		if (s->budget_us > 0 && exec_us > s->budget_us) {
+			s->overruns++;
+		}
+		if (s->armed && before(s->deadline, now)) {
+			s->misses++;
+			if (s->miss_run < 255) {
+				s->miss_run++;
+			}
+		}else{
+			s->miss_run = 0;
+		}
+	}
+
+	if (s->period_min == 0 || period < s->period_min) {
+		s->period_min = period;
+	}
+
+	// fields read by the supervisor task
+	taskENTER_CRITICAL();
+	s->release = next_release;
+	s->deadline = next_release + period;
+	s->running = 0;
+	s->armed = 1;
+	taskEXIT_CRITICAL();
+}
+
+/* NULL if every critical activity is on schedule, else the first one that is not */
+static const char *check(const char **why) {
+	TickType_t now = xTaskGetTickCount();
+
+	for (int i = 0; i < activity_count; i++) {
+		supervised *s = &activity[i];
+		if (!s->critical || !s->armed) {
+			continue;
+		}
+		taskENTER_CRITICAL();
+		TickType_t deadline = s->deadline;
+		taskEXIT_CRITICAL();
+		if (before(deadline + pdMS_TO_TICKS(SUPERVISOR_GRACE_MS), now)) {
+			*why = "stuck";
+			return s->name;
+		}
+		if (s->miss_run >= SUPERVISOR_MISS_LIMIT) {
+			*why = "missing deadlines";
+			return s->name;
+		}
+	}
+	return NULL;
+}
+
+/* Started with the scheduler, so the boot does not have to fit the timeout */
+void vSupervisorTask(void *pvParameters) {
+	char message[MAX_MESSAGE_LENGTH];
+	const char *failed, *why = "";
+	const char *reported = NULL;
+
+	hiwdg.Instance = IWDG;
+	hiwdg.Init.Prescaler = IWDG_PRESCALER_64;
+	hiwdg.Init.Window = IWDG_WINDOW_DISABLE;
+	hiwdg.Init.Reload = SUPERVISOR_WDG_TIMEOUT_MS / 2;
+	// the watchdog keeps running while the core is halted by the debugger otherwise
+	__HAL_DBGMCU_FREEZE_IWDG();
+	HAL_IWDG_Init(&hiwdg);
+
+	for (;;) {
+		failed = check(&why);
+		if (failed == NULL) {
+			HAL_IWDG_Refresh(&hiwdg);
+			reported = NULL;
+		}else{
+			withheld++;
+			if (failed != reported) {
+				reported = failed;
+				snprintf(message, sizeof(message), "Supervisor: %s %s, watchdog not fed\r\n", failed, why);
+				send_uart_message(message);
+			}
+		}
+		vTaskDelay(pdMS_TO_TICKS(SUPERVISOR_CHECK_MS));
+	}
+}
+
+void SUPERVISOR_Report(void) {
+	char message[MAX_MESSAGE_LENGTH];
+
+	for (int i = 0; i < activity_count; i++) {
+		supervised *s = &activity[i];
+		snprintf(message, sizeof(message), "Sup %-6.6s%s job %lu miss %lu ovr %lu late %lu ms exec %lu us\r\n",
+				s->name, s->critical ? "*" : " ", (unsigned long)s->jobs, (unsigned long)s->misses, (unsigned long)s->overruns,
+				(unsigned long)(s->late_max * portTICK_PERIOD_MS), (unsigned long)s->exec.max);
+		send_uart_message(message);
+	}
+	snprintf(message, sizeof(message), "Watchdog %lu ms, %lu checks not fed%s\r\n",
+			(unsigned long)SUPERVISOR_WDG_TIMEOUT_MS, (unsigned long)withheld, watchdog_reset ? ", last reset by watchdog" : "");
+	send_uart_message(message);
+}
+
+/* Input of tools/schedulability.py, two lines per activity:
+ * 	WCET task=<name> prio=<priority> period_ms=<shortest period> jobs=<n>
+ * 	WCET task=<name> p50=<us> p90=<us> p99=<us> max=<us>
+ * The execution time of a job is from SUPERVISOR_Begin() to SUPERVISOR_End(),
+ * including its waits on the I2C bus manager and any preemption.
+ * */
+void SUPERVISOR_Dump(void) {
+	char message[MAX_MESSAGE_LENGTH];
+
+	for (int i = 0; i < activity_count; i++) {
+		supervised *s = &activity[i];
+		lat_histogram exec = s->exec;
+		snprintf(message, sizeof(message), "WCET task=%s prio=%lu period_ms=%lu jobs=%lu\r\n",
+				s->name, (unsigned long)s->priority, (unsigned long)(s->period_min * portTICK_PERIOD_MS), (unsigned long)exec.count);
+		send_uart_message(message);
+		snprintf(message, sizeof(message), "WCET task=%s p50=%lu p90=%lu p99=%lu max=%lu\r\n",
+				s->name, (unsigned long)LAT_Percentile(&exec, 50), (unsigned long)LAT_Percentile(&exec, 90),
+				(unsigned long)LAT_Percentile(&exec, 99), (unsigned long)exec.max);
+		send_uart_message(message);
+	}
+}
+
+#endif
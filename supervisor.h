@@ -0,0 +1,64 @@
+/*
+ * supervisor.h
+ *
+ * Purpose: Declare the task supervisor.
+ * Content:
+ * Release, completion and deadline tracking of the periodic tasks,
+ * execution time measurement, independent watchdog fed only while the
+ * critical ones keep up.
+ */
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+// set to 0 to compile the supervisor and the watchdog out
+#ifndef SUPERVISOR_ENABLE
+#define SUPERVISOR_ENABLE 1
+#endif
+
+// periodic activities that can register
+#define SUPERVISOR_MAX 10
+
+// IWDG timeout, LSI 32 kHz / 64: 2 ms resolution, 8190 ms at most
+#ifndef SUPERVISOR_WDG_TIMEOUT_MS
+#define SUPERVISOR_WDG_TIMEOUT_MS 4000
+#endif
+
+// how often the supervisor task checks the activities and feeds the watchdog
+#define SUPERVISOR_CHECK_MS 500
+
+// past its deadline by this much, a critical activity is considered stuck
+#define SUPERVISOR_GRACE_MS 200
+
+// consecutive deadline misses of a critical activity that stop the feeding
+#define SUPERVISOR_MISS_LIMIT 3
+
+// execution time budgets, a longer job counts as an overrun
+#define SUPERVISOR_SENSOR_BUDGET_US 5000
+#define SUPERVISOR_SCHEDULER_BUDGET_US 20000
+
+// above every supervised task
+#define SUPERVISOR_TASK_PRIORITY 4
+
+#if SUPERVISOR_ENABLE
+int SUPERVISOR_Init(void);
+int SUPERVISOR_Register(const char *name, int critical, uint32_t budget_us);
+void SUPERVISOR_Begin(int id);
+void SUPERVISOR_End(int id, TickType_t next_release, TickType_t period);
+void SUPERVISOR_Report(void);
+void SUPERVISOR_Dump(void);
+void vSupervisorTask(void *pvParameters);
+#else
+#define SUPERVISOR_Init() 0
+#define SUPERVISOR_Register(name, critical, budget_us) (-1)
+#define SUPERVISOR_Begin(id) ((void)(id))
+#define SUPERVISOR_End(id, next_release, period) ((void)(id), (void)(period))
+#define SUPERVISOR_Report() ((void)0)
+#define SUPERVISOR_Dump() ((void)0)
+#endif
+
+#endif
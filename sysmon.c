@@ -0,0 +1,180 @@
+/*
+ * sysmon.c
+ *
+ * Purpose: Show where the CPU time and the memory go.
+ * Content:
+ * Per task CPU share over the report period from the FreeRTOS run time
+ * counters, stack high-water marks, peak depth of the UART and event queues
+ * and of the sensor FIFOs, samples lost to full FIFOs, report printed by
+ * the scheduler.
+ *
+ * The stack sizes in main.c were guesses and nothing showed which task
+ * eats the cycles. The kernel accounts each task's run time on the DWT
+ * microsecond clock (getRunTimeCounterValue() in freertos.c); the report
+ * prints the share of every task since the previous report, so a busy
+ * minute is not averaged away over the uptime, and the free stack words
+ * to compare with the *_STACK_SIZE defines. Queue depths are sampled by
+ * the scheduler loop, the FIFOs keep their own peak on write.
+ * SYSMON_Report() runs in the scheduler task only, other tasks ask for an
+ * extra report with SYSMON_Request().
+ */
+
+#include "sysmon.h"
+#include "sensors.h"
+#include "event.h"
+#include "imu_fifo.h"
+#include "task.h"
+#include <string.h>
+
+#if SYSMON_ENABLE
+
+#if configUSE_TRACE_FACILITY != 1 || configGENERATE_RUN_TIME_STATS != 1
+#error "SYSMON_ENABLE needs configUSE_TRACE_FACILITY and configGENERATE_RUN_TIME_STATS set to 1"
+#endif
+
+typedef struct {
+	TaskHandle_t handle;
+	uint32_t runtime;		// run time counter at the previous report
+} task_mark;
+
+typedef struct {
+	const char *name;
+	QueueHandle_t queue;
+	UBaseType_t peak;
+} queue_watch;
+
+static task_mark mark[SYSMON_MAX_TASKS];
+static uint32_t last_total;
+static queue_watch queues[SYSMON_MAX_QUEUES];
+static int queue_count;
+static int event_peak;
+static volatile int requested;
+
+// too large for the scheduler stack
+static TaskStatus_t task_status[SYSMON_MAX_TASKS];
+
+void SYSMON_Init(void) {
+	memset(mark, 0, sizeof(mark));
+	memset(queues, 0, sizeof(queues));
+	last_total = 0;
+	queue_count = 0;
+	event_peak = 0;
+	requested = 0;
+}
+
+void SYSMON_AddQueue(const char *name, QueueHandle_t queue) {
+	if (queue_count < SYSMON_MAX_QUEUES && queue != NULL) {
+		queues[queue_count].name = name;
+		queues[queue_count].queue = queue;
+		queue_count++;
+	}
+}
+
+/* Called by the scheduler loop: queue depth peaks, and the requested report */
+void SYSMON_Sample(void) {
+	for (int i = 0; i < queue_count; i++) {
+		UBaseType_t waiting = uxQueueMessagesWaiting(queues[i].queue);
+		if (waiting > queues[i].peak) {
+			queues[i].peak = waiting;
+		}
+	}
+	int pending = EVENT_Pending();
+	if (pending > event_peak) {
+		event_peak = pending;
+	}
+
+	if (requested) {
+		requested = 0;
+		SYSMON_Report();
+	}
+}
+
+void SYSMON_Request(void) {
+	requested = 1;
+}
+
+/* Run time counter of the task at the previous report, 0 for a new task */
+static uint32_t previous(TaskHandle_t handle, uint32_t runtime) {
+	task_mark *free_mark = NULL;
+
+	for (int i = 0; i < SYSMON_MAX_TASKS; i++) {
+		if (mark[i].handle == handle) {
+			uint32_t last = mark[i].runtime;
+			mark[i].runtime = runtime;
+			return last;
+		}
+		if (mark[i].handle == NULL && free_mark == NULL) {
+			free_mark = &mark[i];
+		}
+	}
+	if (free_mark != NULL) {
+		free_mark->handle = handle;
+		free_mark->runtime = runtime;
+	}
+	return 0;
+}
+
+void SYSMON_Report(void) {
+	char message[MAX_MESSAGE_LENGTH];
+	uint32_t total, period, idle = 0;
+	UBaseType_t tasks;
+
+	tasks = uxTaskGetSystemState(task_status, SYSMON_MAX_TASKS, &total);
+	if (tasks == 0) {
+		send_uart_message("Sysmon: more than SYSMON_MAX_TASKS tasks\r\n");
+		return;
+	}
+	period = total - last_total;
+	last_total = total;
+	if (period == 0) {
+		period = 1;
+	}
+
+	// per task share of the period, the run time counters are in us and wrap
+	for (UBaseType_t i = 0; i < tasks; i++) {
+		TaskStatus_t *t = &task_status[i];
+		uint32_t used = t->ulRunTimeCounter - previous(t->xHandle, t->ulRunTimeCounter);
+
+		if (t->uxCurrentPriority == 0 && strcmp(t->pcTaskName, "IDLE") == 0) {
+			idle = used;
+		}
+		snprintf(message, sizeof(message), "%-14.14s %5.1f%% stack free %4u%s\r\n",
+				t->pcTaskName, 100.0f * used / period, t->usStackHighWaterMark,
+				t->usStackHighWaterMark < SYSMON_STACK_MARGIN ? " LOW" : "");
+		send_uart_message(message);
+	}
+	snprintf(message, sizeof(message), "CPU load %.1f%% over %lu ms, %lu tasks\r\n",
+			100.0f - 100.0f * idle / period, (unsigned long)(period / 1000), (unsigned long)tasks);
+	send_uart_message(message);
+
+	for (int i = 0; i < queue_count; i++) {
+		UBaseType_t waiting = uxQueueMessagesWaiting(queues[i].queue);
+		snprintf(message, sizeof(message), "Queue %s %lu/%lu peak %lu\r\n", queues[i].name,
+				(unsigned long)waiting, (unsigned long)(waiting + uxQueueSpacesAvailable(queues[i].queue)),
+				(unsigned long)queues[i].peak);
+		send_uart_message(message);
+		queues[i].peak = 0;
+	}
+	snprintf(message, sizeof(message), "Queue event %d/%d peak %d\r\n", EVENT_Pending(), EVENT_QUEUE_SIZE, event_peak);
+	send_uart_message(message);
+	event_peak = 0;
+
+	snprintf(message, sizeof(message), "FIFO peak Acl %d Gyr %d Mag %d Temp %d Hum %d Prs %d\r\n",
+			accel_fifo.peak, gyro_fifo.peak, mag_fifo.peak, temp_fifo.peak, humid_fifo.peak, press_fifo.peak);
+	send_uart_message(message);
+	accel_fifo.peak = gyro_fifo.peak = mag_fifo.peak = 0;
+	temp_fifo.peak = humid_fifo.peak = press_fifo.peak = 0;
+
+	// samples refused by a full FIFO, counted by the producers instead of printed
+	snprintf(message, sizeof(message), "FIFO lost Acl %d Gyr %d Mag %d Temp %d Hum %d Prs %d\r\n",
+			accel_fifo.lost, gyro_fifo.lost, mag_fifo.lost, temp_fifo.lost, humid_fifo.lost, press_fifo.lost);
+	send_uart_message(message);
+	accel_fifo.lost = gyro_fifo.lost = mag_fifo.lost = 0;
+	temp_fifo.lost = humid_fifo.lost = press_fifo.lost = 0;
+#if ACQ_MODE == ACQ_MODE_HWFIFO
+	snprintf(message, sizeof(message), "IMU FIFO overruns %d\r\n", IMU_FIFO_TakeOverruns());
+	send_uart_message(message);
+#endif
+}
+
+#endif
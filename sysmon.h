@@ -0,0 +1,44 @@
+/*
+ * sysmon.h
+ *
+ * Purpose: Declare the system monitor.
+ * Content:
+ * CPU load and stack high-water mark per task, queue and FIFO depth peaks,
+ * periodic and on demand report.
+ */
+
+#ifndef SYSMON_H
+#define SYSMON_H
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+
+// set to 0 to compile the monitor out, it needs configUSE_TRACE_FACILITY and
+// configGENERATE_RUN_TIME_STATS in FreeRTOSConfig.h
+#ifndef SYSMON_ENABLE
+#define SYSMON_ENABLE 1
+#endif
+
+// tasks and queues the report covers
+#define SYSMON_MAX_TASKS 16
+#define SYSMON_MAX_QUEUES 4
+
+// stacks with fewer free words left are flagged in the report
+#define SYSMON_STACK_MARGIN 32
+
+#if SYSMON_ENABLE
+void SYSMON_Init(void);
+void SYSMON_AddQueue(const char *name, QueueHandle_t queue);
+void SYSMON_Sample(void);
+void SYSMON_Request(void);
+void SYSMON_Report(void);
+#else
+#define SYSMON_Init() ((void)0)
+#define SYSMON_AddQueue(name, queue) ((void)0)
+#define SYSMON_Sample() ((void)0)
+#define SYSMON_Request() ((void)0)
+#define SYSMON_Report() ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * timing.c
+ *
+ * Purpose: Provide a cheap, high resolution time source.
+ * Content:
+ * DWT cycle counter setup and a 32 bit microsecond clock derived from it.
+ * The RTC only resolves seconds and the tick hook milliseconds, which is
+ * too coarse to measure what a single sample costs.
+ */
+
+#include "timing.h"
+
+static uint32_t cycles_per_us = 1;
+static uint32_t last_cycles;
+static uint32_t rest_cycles;
+static uint32_t micros;
+
+/* Enable the cycle counter, must run after SystemClock_Config()
+ * so that SystemCoreClock holds the final core frequency.
+ * */
+void TIMING_Init(void) {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	cycles_per_us = SystemCoreClock / 1000000;
+	if (cycles_per_us == 0) {
+		cycles_per_us = 1;
+	}
+	last_cycles = 0;
+	rest_cycles = 0;
+	micros = 0;
+}
+
+uint32_t TIMING_Cycles(void) {
+	return DWT->CYCCNT;
+}
+
+/* Microseconds since TIMING_Init().
+ * CYCCNT wraps every 2^32 cycles (~53 s at 80 MHz), so the elapsed cycles
+ * are folded into a separate microsecond counter on every call; callers
+ * only have to use it at least once per wrap, which every sensor task does.
+ * Safe to call from tasks and ISRs.
+ * */
+uint32_t TIMING_Micros(void) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t now = DWT->CYCCNT;
+	rest_cycles += now - last_cycles;
+	last_cycles = now;
+	micros += rest_cycles / cycles_per_us;
+	rest_cycles %= cycles_per_us;
+	uint32_t result = micros;
+
+	__set_PRIMASK(primask);
+	return result;
+}
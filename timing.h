@@ -0,0 +1,18 @@
+/*
+ * timing.h
+ *
+ * Purpose: Declare the high resolution time source used for instrumentation.
+ * Content:
+ * Function prototypes for the DWT cycle counter and the derived microsecond clock.
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "main.h"
+
+void TIMING_Init(void);
+uint32_t TIMING_Cycles(void);
+uint32_t TIMING_Micros(void);
+
+#endif
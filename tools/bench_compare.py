@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""
+bench_compare.py
+
+Purpose: Compare benchmark results between two commits.
+Content:
+Reader of the host bench's JSON results file and of serial captures with
+the target's BENCH lines (bench.c), conversion of a capture to a results
+file, comparison of the medians.
+
+A case has regressed when its median grew by more than the threshold and
+by more than the noise, twice the larger of the two standard deviations.
+Results in different units (ns on the host, cycles on the target) are not
+compared with each other.
+
+Usage:
+    ./build-host/sensor_bench --out new.json
+    python3 tools/bench_compare.py old.json new.json
+    python3 tools/bench_compare.py --to-json board.json capture.log
+    python3 tools/bench_compare.py board-old.json capture.log --threshold 2
+Exit status 0 without regression, 1 with, 2 without usable input.
+"""
+
+import argparse
+import json
+import re
+import sys
+
+BENCH_LINE = re.compile(r"BENCH\s+(.*)$")
+PAIR = re.compile(r"(\w+)=(\S+)")
+
+
+def parse_capture(lines):
+    """case name -> dict of the reported values, the three BENCH lines merged"""
+    cases = {}
+    for line in lines:
+        match = BENCH_LINE.search(line)
+        if not match:
+            continue
+        fields = dict(PAIR.findall(match.group(1)))
+        name = fields.pop("name", None)
+        if name is None:
+            continue
+        cases.setdefault(name, {}).update(fields)
+    results = {}
+    for name, fields in cases.items():
+        try:
+            results[name] = {
+                "unit": fields.get("unit", "cycles"),
+                "median": float(fields["median"]),
+                "stddev": float(fields.get("sd", 0)),
+                "mean": float(fields.get("mean", fields["median"])),
+                "min": float(fields.get("min", fields["median"])),
+                "iterations": int(fields.get("ops", 0)),
+                "repetitions": int(fields.get("reps", 0)),
+            }
+        except (KeyError, ValueError):
+            print("incomplete BENCH lines for %s, skipped" % name, file=sys.stderr)
+    return results
+
+
+def parse_json(document):
+    """case name -> dict of the aggregates, Google Benchmark layout"""
+    results = {}
+    for entry in document.get("benchmarks", []):
+        if entry.get("run_type") != "aggregate":
+            continue
+        name = entry.get("run_name", entry["name"])
+        case = results.setdefault(name, {"unit": entry.get("time_unit", "ns")})
+        case[entry["aggregate_name"]] = float(entry["real_time"])
+        case["iterations"] = entry.get("iterations", 0)
+        case["repetitions"] = entry.get("repetitions", 0)
+    return {name: case for name, case in results.items() if "median" in case}
+
+
+def load(path):
+    with open(path, errors="replace") as source:
+        text = source.read()
+    try:
+        return parse_json(json.loads(text))
+    except ValueError:
+        return parse_capture(text.splitlines())
+
+
+def to_json(results, path, source):
+    benchmarks = []
+    for name, case in results.items():
+        for aggregate in ("median", "mean", "stddev", "min"):
+            benchmarks.append({
+                "name": "%s_%s" % (name, aggregate),
+                "run_name": name,
+                "run_type": "aggregate",
+                "aggregate_name": aggregate,
+                "repetitions": case["repetitions"],
+                "threads": 1,
+                "iterations": case["iterations"],
+                "real_time": case[aggregate],
+                "cpu_time": case[aggregate],
+                "time_unit": case["unit"],
+            })
+    with open(path, "w") as out:
+        json.dump({"context": {"source": source, "target": "board"}, "benchmarks": benchmarks}, out, indent=2)
+        out.write("\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare the medians of two benchmark runs")
+    parser.add_argument("old", help="results file or serial capture of the baseline")
+    parser.add_argument("new", nargs="?", help="results file or serial capture to check")
+    parser.add_argument("--threshold", type=float, default=5, metavar="PERCENT",
+                        help="median growth counted as a regression (default: 5)")
+    parser.add_argument("--to-json", metavar="FILE",
+                        help="write the results of the last input as a results file")
+    args = parser.parse_args()
+
+    old = load(args.old)
+    new = load(args.new) if args.new else None
+    if args.to_json:
+        last = new if new is not None else old
+        if not last:
+            print("no benchmark results in %s" % (args.new or args.old), file=sys.stderr)
+            return 2
+        to_json(last, args.to_json, args.new or args.old)
+        if new is None:
+            return 0
+    if new is None:
+        parser.error("a second input is needed to compare")
+    if not old or not new:
+        print("no benchmark results in %s" % (args.old if not old else args.new), file=sys.stderr)
+        return 2
+
+    regressions = 0
+    print("%-20s %6s %10s %10s %8s %8s" % ("case", "unit", "old", "new", "delta", "noise"))
+    for name in sorted(set(old) | set(new)):
+        if name not in old or name not in new:
+            print("%-20s only in %s" % (name, "new" if name in new else "old"))
+            continue
+        a, b = old[name], new[name]
+        if a["unit"] != b["unit"]:
+            print("%-20s %s against %s, not compared" % (name, a["unit"], b["unit"]))
+            continue
+        delta = (b["median"] - a["median"]) / a["median"] * 100 if a["median"] else 0
+        noise = 2 * max(a.get("stddev", 0), b.get("stddev", 0))
+        regressed = delta > args.threshold and b["median"] - a["median"] > noise
+        regressions += regressed
+        print("%-20s %6s %10.1f %10.1f %+7.1f%% %8.1f%s" % (
+            name, a["unit"], a["median"], b["median"], delta, noise, "  REGRESSION" if regressed else ""))
+
+    print()
+    print("%d regression%s beyond %.1f%% and the noise" % (regressions, "" if regressions == 1 else "s", args.threshold))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
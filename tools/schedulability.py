@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+"""
+schedulability.py
+
+Purpose: Check whether the periodic tasks fit, and at which priorities.
+Content:
+Parser of the WCET lines the console prints on "wcet" (supervisor.c),
+response-time analysis for the measured and for rate- or deadline-monotonic
+priorities, recommended priority assignment.
+
+Capture the serial output while the board runs under a representative load,
+type "wcet" in the terminal and pass the capture to this script. Each task's
+execution time C is a percentile or the maximum of its measured jobs, its
+period T the shortest one the supervisor saw, its deadline D the period
+unless given. FreeRTOS time-slices tasks of equal priority, so a task is
+interfered with by every other task of the same or a higher priority:
+
+    R = C + B + sum over those tasks j of ceil(R / T_j) * C_j
+
+iterated from R = C until it settles or exceeds D. A measured job includes
+its waits on the I2C bus manager and its preemption, so C, and therefore R,
+are upper bounds. What-if tasks (a new sensor) are added with --add.
+
+The recommendation gives each distinct period (deadline with dm) its own
+priority, from --base upward. The --fixed tasks, by default the I2C bus
+manager (3) and the supervisor (4) of main.c, must stay above the tasks
+they serve and watch: the script reports where they have to be raised to,
+in their order, and whether that still fits below the event task at
+configMAX_PRIORITIES - 1 (--max-priorities). A --fixed task given with
+--add is analysed at that raised priority.
+
+Usage:
+    python3 tools/schedulability.py capture.log
+    python3 tools/schedulability.py capture.log --wcet p99 --policy dm \\
+        --deadline Sched=500 --add Co2:3000:2000
+    python3 tools/schedulability.py capture.log --fixed I2C=5 --add I2C:400:10
+Exit status 0 if the recommended assignment fits, 1 if not, 2 without input.
+"""
+
+import argparse
+import math
+import re
+import sys
+
+WCET_LINE = re.compile(r"WCET\s+(.*)$")
+PAIR = re.compile(r"(\w+)=(\S+)")
+
+
+class Task:
+    def __init__(self, name, c_us, t_us, d_us, prio=None):
+        self.name = name
+        self.c = c_us
+        self.t = t_us
+        self.d = d_us
+        self.prio = prio
+
+
+def parse_capture(lines):
+    """task name -> dict of the last reported values, both WCET lines merged"""
+    tasks = {}
+    for line in lines:
+        match = WCET_LINE.search(line)
+        if not match:
+            continue
+        fields = dict(PAIR.findall(match.group(1)))
+        name = fields.pop("task", None)
+        if name is None:
+            continue
+        tasks.setdefault(name, {}).update(fields)
+    return tasks
+
+
+def name_value(text, option):
+    name, sep, value = text.partition("=")
+    if not sep:
+        raise SystemExit("%s expects NAME=MS, got %s" % (option, text))
+    return name, float(value)
+
+
+def build_tasks(reported, args):
+    periods = dict(name_value(p, "--period") for p in args.period)
+    deadlines = dict(name_value(d, "--deadline") for d in args.deadline)
+    tasks = []
+
+    for name, fields in reported.items():
+        if name in args.exclude:
+            continue
+        if int(fields.get("jobs", "0")) == 0 or args.wcet not in fields:
+            print("skipping %s: no completed jobs" % name, file=sys.stderr)
+            continue
+        t_ms = periods.get(name, float(fields.get("period_ms", "0")))
+        if t_ms <= 0:
+            print("skipping %s: no period" % name, file=sys.stderr)
+            continue
+        d_ms = deadlines.get(name, t_ms)
+        tasks.append(Task(name, float(fields[args.wcet]), t_ms * 1000, d_ms * 1000,
+                          int(fields["prio"]) if "prio" in fields else None))
+
+    for spec in args.add:
+        parts = spec.split(":")
+        if len(parts) not in (3, 4):
+            raise SystemExit("--add expects NAME:C_US:T_MS[:D_MS], got %s" % spec)
+        t_ms = float(parts[2])
+        d_ms = float(parts[3]) if len(parts) == 4 else deadlines.get(parts[0], t_ms)
+        tasks.append(Task(parts[0], float(parts[1]), t_ms * 1000, d_ms * 1000))
+    return tasks
+
+
+def response_time(task, tasks, prio, blocking):
+    """Worst-case response time in us, None if it exceeds the deadline"""
+    interferers = [j for j in tasks if j is not task and prio[j.name] >= prio[task.name]]
+    r = task.c + blocking
+    while True:
+        next_r = task.c + blocking + sum(math.ceil(r / j.t) * j.c for j in interferers)
+        if next_r > task.d:
+            return None
+        if next_r == r:
+            return r
+        r = next_r
+
+
+def monotonic_priorities(tasks, policy, base, fixed):
+    """Shorter period (rm) or deadline (dm) -> higher priority, ties share a
+    level, one level per distinct value from base upward. Returns the
+    priorities of the other tasks and the highest level used."""
+    key = (lambda t: t.t) if policy == "rm" else (lambda t: t.d)
+    free = [t for t in tasks if t.name not in fixed]
+    levels = sorted(set(key(t) for t in free))
+    prio = {}
+    for t in free:
+        rank = levels.index(key(t))     # 0: shortest period
+        prio[t.name] = base + len(levels) - 1 - rank
+    return prio, base + len(levels) - 1
+
+
+def raise_fixed(fixed, base, top):
+    """Priorities of the --fixed tasks from --base up, kept in their order
+    and above top; the ones below --base are not concerned"""
+    raised = dict(fixed)
+    floor = top
+    for name in sorted(fixed, key=fixed.get):
+        if fixed[name] >= base:
+            floor = max(fixed[name], floor + 1)
+            raised[name] = floor
+    return raised
+
+
+def analyse(tasks, prio, blocking):
+    results = {t.name: response_time(t, tasks, prio, blocking) for t in tasks}
+    return results, all(r is not None for r in results.values())
+
+
+def fmt_ms(us):
+    return "-" if us is None else "%.2f" % (us / 1000)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Response-time analysis of the measured task set")
+    parser.add_argument("capture", nargs="?", help="serial capture with the wcet dump, stdin if omitted")
+    parser.add_argument("--wcet", choices=("max", "p99", "p90", "p50"), default="max",
+                        help="execution time used as C (default: max)")
+    parser.add_argument("--policy", choices=("rm", "dm"), default="rm",
+                        help="rate- or deadline-monotonic recommendation (default: rm)")
+    parser.add_argument("--period", action="append", default=[], metavar="NAME=MS",
+                        help="override a period, e.g. a sensor's min_interval")
+    parser.add_argument("--deadline", action="append", default=[], metavar="NAME=MS",
+                        help="constrained deadline, the period otherwise")
+    parser.add_argument("--add", action="append", default=[], metavar="NAME:C_US:T_MS[:D_MS]",
+                        help="what-if task, e.g. a new sensor")
+    parser.add_argument("--exclude", action="append", default=[], metavar="NAME",
+                        help="leave a reported task out")
+    parser.add_argument("--blocking", type=float, default=0, metavar="US",
+                        help="blocking term added to every task, e.g. the longest I2C transaction")
+    parser.add_argument("--base", type=int, default=2,
+                        help="FreeRTOS priority of the lowest recommended level (default: 2)")
+    parser.add_argument("--fixed", action="append", default=None, metavar="NAME=PRIO",
+                        help="system task that must stay above the recommendation "
+                             "(default: I2C=3 Supervisor=4, as in main.c)")
+    parser.add_argument("--max-priorities", type=int, default=56, metavar="N",
+                        help="configMAX_PRIORITIES, the event task runs at N - 1 (default: 56, CMSIS_V2)")
+    args = parser.parse_args()
+    fixed = {name: int(value) for name, value in
+             (name_value(f, "--fixed") for f in (args.fixed or ["I2C=3", "Supervisor=4"]))}
+
+    if args.capture:
+        with open(args.capture, errors="replace") as capture:
+            reported = parse_capture(capture)
+    else:
+        reported = parse_capture(sys.stdin)
+
+    tasks = build_tasks(reported, args)
+    if not tasks:
+        print("no WCET lines found, type wcet in the console while capturing", file=sys.stderr)
+        return 2
+
+    utilisation = sum(t.c / t.t for t in tasks)
+    n = len(tasks)
+    bound = n * (2 ** (1 / n) - 1)
+
+    measured = {t.name: t.prio for t in tasks if t.prio is not None}
+    have_measured = len(measured) == n
+    if have_measured:
+        measured_r, measured_ok = analyse(tasks, measured, args.blocking)
+
+    recommended, top = monotonic_priorities(tasks, args.policy, args.base, fixed)
+    raised = raise_fixed(fixed, args.base, top)
+    recommended.update((t.name, raised[t.name]) for t in tasks if t.name in fixed)
+    recommended_r, recommended_ok = analyse(tasks, recommended, args.blocking)
+
+    print("%-8s %9s %9s %9s | %4s %9s | %4s %9s" %
+          ("task", "C ms", "T ms", "D ms", "prio", "R ms", args.policy, "R ms"))
+    for t in sorted(tasks, key=lambda t: (-recommended[t.name], t.t)):
+        print("%-8s %9.3f %9.1f %9.1f | %4s %9s | %4d %9s" % (
+            t.name, t.c / 1000, t.t / 1000, t.d / 1000,
+            measured.get(t.name, "-"), fmt_ms(measured_r[t.name]) if have_measured else "-",
+            recommended[t.name], fmt_ms(recommended_r[t.name])))
+
+    print()
+    print("utilisation %.3f, Liu & Layland bound for %d tasks %.3f%s" %
+          (utilisation, n, bound, "" if utilisation <= bound else " (exceeded, the exact test decides)"))
+    if have_measured:
+        print("current priorities: %s" % ("fit" if measured_ok else "DO NOT FIT"))
+    print("%s priorities: %s" % (args.policy.upper(), "fit" if recommended_ok else "DO NOT FIT"))
+    print("%s uses priorities %d to %d" % (args.policy.upper(), args.base, top))
+    moved = sorted((name for name in fixed if raised[name] != fixed[name]), key=raised.get)
+    if moved:
+        print("to stay above them, raise %s" % ", ".join(
+            "%s from %d to %d" % (name, fixed[name], raised[name]) for name in moved))
+    highest = max([top] + list(raised.values()))
+    room = args.max_priorities - 1 - highest
+    if room > 0:
+        print("highest priority %d, %d levels left below the event task (configMAX_PRIORITIES %d - 1)" % (
+            highest, room - 1, args.max_priorities))
+    else:
+        print("highest priority %d does not fit below the event task: configMAX_PRIORITIES must be at least %d" % (
+            highest, highest + 2))
+    for t in tasks:
+        if t.name not in fixed and t.prio is not None and t.prio in fixed.values():
+            print("%s runs at priority %d, the same as %s" % (
+                t.name, t.prio, [name for name, p in fixed.items() if p == t.prio][0]))
+    return 0 if recommended_ok and room > 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,263 @@
+#!/usr/bin/env python3
+"""
+trace2chrome.py
+
+Purpose: Turn the event trace of the board into a timeline.
+Content:
+Parser of the trace dump (console "trace", trace.c), conversion to the
+Chrome trace event JSON that chrome://tracing and ui.perfetto.dev open,
+summary of the task run times and the FIFO overflows.
+
+Each task gets a track with a slice per run, from its switch-in to its
+switch-out. The FIFO levels and the named queues are counters, overflows
+global instants; a task that blocks on a queue or mutex, or fails to get
+or put an item (timeout, or none there without waiting), gets an instant
+on its own track. USART1, the I2C bus and every named
+mutex have a track of their own: transmissions, bus transactions by
+priority and device, and which task held the mutex. The event types must
+match trace_type in trace.h.
+
+Usage:
+    python3 tools/trace2chrome.py capture.log -o trace.json
+    python3 tools/trace2chrome.py capture.log --dump 0    (first dump of the capture)
+Exit status 0, 2 without a complete dump.
+"""
+
+import argparse
+import json
+import re
+import sys
+
+TRACE_LINE = re.compile(r"TRACE\s+(.*)$")
+EVENT_LINE = re.compile(r"TRC\s+([0-9a-fA-F]+)")
+PAIR = re.compile(r"(\w+)=(.+?)(?=\s+\w+=|\s*$)")
+
+(TASK_IN, TASK_OUT, FIFO_WRITE, FIFO_READ, FIFO_OVERFLOW,
+ QUEUE_SEND, QUEUE_RECEIVE, QUEUE_BLOCK, QUEUE_FAIL,
+ MUTEX_GIVE, MUTEX_TAKE, MUTEX_BLOCK, MUTEX_FAIL,
+ UART_TX_START, UART_TX_DONE, I2C_START, I2C_DONE) = range(17)
+
+SENSOR = ("Acl", "Gyr", "Mag", "Temp", "Humid", "Press")
+I2C_PRIO = ("hi", "mid", "lo")
+UART_LANE = ("line", "alarm")
+
+PID = 1
+TID_UART = 1000
+TID_I2C = 1001
+TID_MUTEX = 1100
+
+
+class Dump:
+    def __init__(self, fields):
+        self.hz = int(fields.get("hz", 80000000))
+        self.lost = int(fields.get("lost", 0))
+        self.stopped = fields.get("stopped") == "1"
+        self.tasks = {}
+        self.queues = {}
+        self.events = []
+        self.complete = False
+
+
+def parse_capture(lines):
+    """list of the dumps in the capture, oldest first"""
+    dumps = []
+    dump = None
+    for line in lines:
+        match = EVENT_LINE.search(line)
+        if match and dump is not None:
+            digits = match.group(1)
+            for i in range(0, len(digits) - 15, 16):
+                word = digits[i:i + 16]
+                dump.events.append((int(word[0:8], 16), int(word[8:10], 16),
+                                    int(word[10:12], 16), int(word[12:16], 16)))
+            continue
+        match = TRACE_LINE.search(line)
+        if not match:
+            continue
+        text = match.group(1).strip()
+        if text == "end":
+            if dump is not None:
+                dump.complete = True
+            continue
+        fields = dict(PAIR.findall(text))
+        if "hz" in fields:
+            dump = Dump(fields)
+            dumps.append(dump)
+        elif dump is not None and "task" in fields:
+            dump.tasks[int(fields["task"])] = fields.get("name", "task " + fields["task"])
+        elif dump is not None and "queue" in fields:
+            dump.queues[int(fields["queue"])] = fields.get("name", "queue " + fields["queue"])
+    return dumps
+
+
+def name_of(table, index, kind):
+    return table[index] if 0 <= index < len(table) else "%s %d" % (kind, index)
+
+
+def convert(dump):
+    """Chrome trace events, task run time in us per task number, overflows"""
+    out = []
+    tasks = dict(dump.tasks)
+    queues = dict(dump.queues)
+    running = None
+    run_start = {}
+    run_time = {}
+    seen = set()
+    open_tx = {}
+    open_i2c = {}
+    holder = {}
+    overflows = []
+    skipped = 0
+
+    def task_name(number):
+        return tasks.setdefault(number, "task %d" % number)
+
+    def queue_name(number):
+        return queues.setdefault(number, "queue %d" % number)
+
+    def instant(ts, name, tid=None, args=None):
+        event = {"ph": "i", "name": name, "pid": PID, "ts": ts}
+        if tid is None:
+            event["s"] = "g"
+        else:
+            event["s"] = "t"
+            event["tid"] = tid
+        if args:
+            event["args"] = args
+        out.append(event)
+
+    def counter(ts, name, value):
+        out.append({"ph": "C", "name": name, "pid": PID, "ts": ts, "args": {"value": value}})
+
+    def slice_(tid, name, start, end, args=None):
+        event = {"ph": "X", "name": name, "pid": PID, "tid": tid, "ts": start, "dur": max(end - start, 0)}
+        if args:
+            event["args"] = args
+        out.append(event)
+
+    def end_run(number, ts):
+        start = run_start.pop(number, None)
+        if start is not None:
+            slice_(number, task_name(number), start, ts)
+            run_time[number] = run_time.get(number, 0) + ts - start
+
+    cycles = 0
+    previous = None
+    ts = 0.0
+    for raw, kind, ident, value in dump.events:
+        # the 32-bit cycle counter wraps, the gaps between events are shorter
+        if previous is not None:
+            cycles += (raw - previous) & 0xFFFFFFFF
+        previous = raw
+        ts = cycles * 1e6 / dump.hz
+
+        if kind in (TASK_IN, TASK_OUT) and ident not in seen:
+            seen.add(ident)
+            if kind == TASK_OUT:
+                run_start[ident] = 0.0      # running when the ring starts
+        if kind == TASK_IN:
+            if running is not None and running != ident:
+                end_run(running, ts)
+            running = ident
+            run_start[ident] = ts
+        elif kind == TASK_OUT:
+            end_run(ident, ts)
+            running = None
+        elif kind in (FIFO_WRITE, FIFO_READ):
+            counter(ts, "FIFO " + name_of(SENSOR, ident, "sensor"), value)
+        elif kind == FIFO_OVERFLOW:
+            sensor = name_of(SENSOR, ident, "sensor")
+            counter(ts, "FIFO " + sensor, value)
+            instant(ts, "overflow " + sensor, args={"task": task_name(running) if running else "-"})
+            overflows.append((ts, sensor, task_name(running) if running else "-"))
+        elif kind in (QUEUE_SEND, QUEUE_RECEIVE):
+            # value is the item count before the operation
+            counter(ts, "queue " + queue_name(ident), value + 1 if kind == QUEUE_SEND else max(value - 1, 0))
+        elif kind in (QUEUE_BLOCK, MUTEX_BLOCK, QUEUE_FAIL, MUTEX_FAIL):
+            what = "fail " if kind in (QUEUE_FAIL, MUTEX_FAIL) else "wait "
+            if running is not None:
+                instant(ts, what + queue_name(ident), running)
+            else:
+                instant(ts, what + queue_name(ident))
+        elif kind == MUTEX_TAKE:
+            holder[ident] = (ts, running)
+        elif kind == MUTEX_GIVE:
+            start, owner = holder.pop(ident, (None, None))
+            if start is not None:
+                slice_(TID_MUTEX + ident, task_name(owner) if owner else "?", start, ts)
+        elif kind == UART_TX_START:
+            open_tx[ident] = (ts, value)
+        elif kind == UART_TX_DONE:
+            start, length = open_tx.pop(ident, (None, 0))
+            if start is not None:
+                slice_(TID_UART, name_of(UART_LANE, ident, "lane"), start, ts, {"bytes": length})
+        elif kind == I2C_START:
+            open_i2c[ident] = (ts, value)
+        elif kind == I2C_DONE:
+            start, addr = open_i2c.pop(ident, (None, 0))
+            if start is not None:
+                label = "%s 0x%02X" % (name_of(I2C_PRIO, ident, "prio"), addr) if addr else \
+                    "%s call" % name_of(I2C_PRIO, ident, "prio")
+                slice_(TID_I2C, label, start, ts, {"status": "ok" if value else "failed"})
+        else:
+            skipped += 1
+
+    for number in list(run_start):
+        end_run(number, ts)
+
+    meta = [{"ph": "M", "name": "process_name", "pid": PID, "args": {"name": "B-L475E-IOT01"}}]
+    tracks = [(number, name) for number, name in tasks.items()]
+    tracks += [(TID_UART, "USART1"), (TID_I2C, "I2C bus")]
+    tracks += [(TID_MUTEX + number, "mutex " + name) for number, name in queues.items()
+               if any(e["ph"] == "X" and e.get("tid") == TID_MUTEX + number for e in out)]
+    for tid, name in tracks:
+        meta.append({"ph": "M", "name": "thread_name", "pid": PID, "tid": tid, "args": {"name": name}})
+        meta.append({"ph": "M", "name": "thread_sort_index", "pid": PID, "tid": tid, "args": {"sort_index": tid}})
+    if skipped:
+        print("%d events of unknown type skipped" % skipped, file=sys.stderr)
+    return meta + out, run_time, tasks, ts, overflows
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a trace dump to Chrome trace JSON")
+    parser.add_argument("capture", nargs="?", help="serial capture with the trace dump, stdin if omitted")
+    parser.add_argument("-o", "--output", default="trace.json", help="JSON file to write (default: trace.json)")
+    parser.add_argument("--dump", type=int, default=-1,
+                        help="which dump of the capture, 0 for the first (default: the last)")
+    args = parser.parse_args()
+
+    if args.capture:
+        with open(args.capture, errors="replace") as capture:
+            dumps = parse_capture(capture)
+    else:
+        dumps = parse_capture(sys.stdin)
+
+    dumps = [d for d in dumps if d.complete and d.events]
+    if not dumps:
+        print("no complete trace dump found, type trace in the console while capturing", file=sys.stderr)
+        return 2
+    try:
+        dump = dumps[args.dump]
+    except IndexError:
+        print("the capture holds %d dumps" % len(dumps), file=sys.stderr)
+        return 2
+
+    events, run_time, tasks, span, overflows = convert(dump)
+    with open(args.output, "w") as out:
+        json.dump({"traceEvents": events, "displayTimeUnit": "ns",
+                   "otherData": {"hz": dump.hz, "lost": dump.lost, "stopped": dump.stopped}}, out)
+
+    print("%d events over %.1f ms, %d older ones overwritten%s" % (
+        len(dump.events), span / 1000, dump.lost, ", stopped after a FIFO overflow" if dump.stopped else ""))
+    print("%-16s %10s %6s" % ("task", "run ms", "cpu %"))
+    for number in sorted(run_time, key=lambda n: -run_time[n]):
+        print("%-16s %10.3f %6.1f" % (tasks[number], run_time[number] / 1000,
+                                      100 * run_time[number] / span if span else 0))
+    for ts, sensor, task in overflows:
+        print("overflow %s at %.3f ms, %s running" % (sensor, ts / 1000, task))
+    print("wrote %s, open it in ui.perfetto.dev or chrome://tracing" % args.output)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
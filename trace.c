@@ -0,0 +1,177 @@
+/*
+ * trace.c
+ *
+ * Purpose: Record what the tasks, FIFOs, queues, UART and I2C bus did, in order.
+ * Content:
+ * RAM ring of timestamped events, queue naming, stop on FIFO overflow,
+ * dump over the UART for tools/trace2chrome.py.
+ *
+ * A dropped sample says that a FIFO was full, not whether its sensor task
+ * ran too often, the scheduler was late, the UART queue was blocked or a
+ * task waited for the UART mutex or the I2C bus. Every event is 8 bytes:
+ * TIMING_Cycles(), type, id and a 16-bit value (trace.h), written with
+ * interrupts masked so that tasks, kernel hooks and interrupt handlers can
+ * all record; the ring keeps the last TRACE_EVENTS. Queues and mutexes are
+ * traced once named with TRACE_NameQueue(), which sets their FreeRTOS
+ * queue number, the others cost the hook one comparison.
+ * The dump (console "trace") stops the recording, prints
+ * 	TRACE hz=<cycles per s> events=<n> lost=<n> stopped=<0|1>
+ * 	TRACE task=<number> name=<name>		one per task
+ * 	TRACE queue=<number> name=<name>	one per named queue or mutex
+ * 	TRC <event><event><event>			16 hex digits per event, oldest first
+ * 	TRACE end
+ * and starts it over; a dump cut off by a blocked UART ends with
+ * 	TRACE cut
+ * instead, which tools/trace2chrome.py skips. The dump is about 170 lines
+ * and paced by the free space of the UART queue (TRACE_DUMP_RESERVE), the
+ * other tasks never wait behind it. An event is cycles (8 digits), type,
+ * id (2 each) and value (4). The cycle counter wraps after 53 s at 80 MHz, the task
+ * switches of every tick keep the gaps far shorter.
+ */
+
+#include "trace.h"
+
+#if TRACE_ENABLE
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "timing.h"
+#include <stdio.h>
+
+#if configUSE_TRACE_FACILITY != 1
+#error "TRACE_ENABLE needs configUSE_TRACE_FACILITY set to 1"
+#endif
+
+#if (TRACE_EVENTS & (TRACE_EVENTS - 1)) != 0
+#error "TRACE_EVENTS must be a power of two"
+#endif
+
+typedef struct {
+	uint32_t cycles;
+	uint8_t type;
+	uint8_t id;
+	uint16_t value;
+} trace_event;
+
+static trace_event ring[TRACE_EVENTS];
+static volatile uint32_t head;			// events recorded since the start
+static volatile uint32_t stop_at;		// head at which the recording stops, 0 before an overflow
+static volatile uint8_t recording = 1;
+#if TRACE_AUTODUMP
+static uint8_t dumped;
+#endif
+
+static const char *queue_name[TRACE_MAX_QUEUES];
+static int queue_count;
+static TaskStatus_t task_status[TRACE_MAX_TASKS];
+
+void TRACE_Record(uint8_t type, uint8_t id, uint16_t value) {
+	if (!recording) {
+		return;
+	}
+
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+	trace_event *event = &ring[head & (TRACE_EVENTS - 1)];
+	event->cycles = TIMING_Cycles();
+	event->type = type;
+	event->id = id;
+	event->value = value;
+	head++;
+#if TRACE_STOP_ON_OVERFLOW
+	if (type == TRACE_FIFO_OVERFLOW && stop_at == 0) {
+		stop_at = head + TRACE_EVENTS / 2;
+	}
+	if (head == stop_at) {
+		recording = 0;
+	}
+#endif
+	taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+/* Queue hooks: mutexes get their own event types */
+void TRACE_Queue(uint8_t type, uint32_t number, uint8_t queue_type, uint32_t waiting) {
+	if (queue_type == queueQUEUE_TYPE_MUTEX || queue_type == queueQUEUE_TYPE_RECURSIVE_MUTEX) {
+		type += TRACE_MUTEX_GIVE - TRACE_QUEUE_SEND;
+	}
+	TRACE_Record(type, (uint8_t)number, (uint16_t)waiting);
+}
+
+/* Traces the operations on a queue, mutex or semaphore under name */
+void TRACE_NameQueue(const char *name, void *queue) {
+	if (queue_count < TRACE_MAX_QUEUES && queue != NULL) {
+		queue_name[queue_count++] = name;
+		vQueueSetQueueNumber((QueueHandle_t)queue, queue_count);
+	}
+}
+
+/* Queue a dump line once the UART queue has room to spare, pdFAIL if it
+ * stayed full for TRACE_DUMP_WAIT_MS
+ * */
+static BaseType_t send_paced(const char *message) {
+	TickType_t start = xTaskGetTickCount();
+
+	while (uart_queue_space() <= TRACE_DUMP_RESERVE) {
+		if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(TRACE_DUMP_WAIT_MS)) {
+			return pdFAIL;
+		}
+		vTaskDelay(pdMS_TO_TICKS(5));
+	}
+	send_uart_message(message);
+	return pdPASS;
+}
+
+void TRACE_Dump(void) {
+	char message[MAX_MESSAGE_LENGTH];
+	uint32_t total, count;
+	UBaseType_t tasks;
+	BaseType_t status;
+
+	recording = 0;
+	total = head;
+	count = total < TRACE_EVENTS ? total : TRACE_EVENTS;
+
+	snprintf(message, sizeof(message), "TRACE hz=%lu events=%lu lost=%lu stopped=%d\r\n",
+			(unsigned long)SystemCoreClock, (unsigned long)count, (unsigned long)(total - count), stop_at != 0 && total == stop_at);
+	status = send_paced(message);
+	tasks = uxTaskGetSystemState(task_status, TRACE_MAX_TASKS, NULL);
+	for (UBaseType_t i = 0; i < tasks && status == pdPASS; i++) {
+		snprintf(message, sizeof(message), "TRACE task=%lu name=%s\r\n",
+				(unsigned long)task_status[i].xTaskNumber, task_status[i].pcTaskName);
+		status = send_paced(message);
+	}
+	for (int i = 0; i < queue_count && status == pdPASS; i++) {
+		snprintf(message, sizeof(message), "TRACE queue=%d name=%s\r\n", i + 1, queue_name[i]);
+		status = send_paced(message);
+	}
+
+	// three events per line, within MAX_MESSAGE_LENGTH
+	for (uint32_t i = total - count; i < total && status == pdPASS; i += 3) {
+		int length = snprintf(message, sizeof(message), "TRC ");
+		for (uint32_t j = i; j < i + 3 && j < total; j++) {
+			trace_event *event = &ring[j & (TRACE_EVENTS - 1)];
+			length += snprintf(message + length, sizeof(message) - length, "%08lx%02x%02x%04x",
+					(unsigned long)event->cycles, event->type, event->id, event->value);
+		}
+		snprintf(message + length, sizeof(message) - length, "\r\n");
+		status = send_paced(message);
+	}
+	send_uart_message(status == pdPASS ? "TRACE end\r\n" : "TRACE cut\r\n");
+
+	head = 0;
+	stop_at = 0;
+	recording = 1;
+}
+
+/* Called by the scheduler loop, prints the trace stopped by an overflow once */
+void TRACE_Poll(void) {
+#if TRACE_AUTODUMP
+	if (!dumped && !recording && stop_at != 0) {
+		dumped = 1;
+		TRACE_Dump();
+	}
+#endif
+}
+
+#endif
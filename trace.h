@@ -0,0 +1,111 @@
+/*
+ * trace.h
+ *
+ * Purpose: Declare the event trace and the FreeRTOS trace hooks feeding it.
+ * Content:
+ * Event types, recording and naming calls, dump; the task switch and queue
+ * hooks of the kernel.
+ *
+ * FreeRTOSConfig.h includes this file at its end (README, "Set up the
+ * project"), so it needs nothing but stdint.h: the hook macros are only
+ * expanded in the kernel sources, where the TCB and queue fields they read
+ * exist (configUSE_TRACE_FACILITY 1). Without that include the trace still
+ * records the FIFO, UART and I2C events, only the task switches and the
+ * queue and mutex operations are missing.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// set to 0 to compile the trace and the kernel hooks out
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 1
+#endif
+
+// ring size in events of 8 bytes, a power of two
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS 512
+#endif
+
+// 1: the first FIFO overflow stops the recording half a ring later, the
+// dump then shows what led to the dropped sample and what followed
+#ifndef TRACE_STOP_ON_OVERFLOW
+#define TRACE_STOP_ON_OVERFLOW 1
+#endif
+
+// 1: the scheduler prints the stopped trace once, without the console
+#ifndef TRACE_AUTODUMP
+#define TRACE_AUTODUMP 0
+#endif
+
+/* The dump only queues a line while more than TRACE_DUMP_RESERVE entries of
+ * the UART queue are free, so the sample and alarm lines keep flowing, and
+ * gives up when the queue did not drain for TRACE_DUMP_WAIT_MS
+ * */
+#ifndef TRACE_DUMP_RESERVE
+#define TRACE_DUMP_RESERVE 8
+#endif
+#ifndef TRACE_DUMP_WAIT_MS
+#define TRACE_DUMP_WAIT_MS 2000
+#endif
+
+// queues and mutexes with a name, the others are not traced
+#define TRACE_MAX_QUEUES 8
+// tasks named in the dump
+#define TRACE_MAX_TASKS 16
+
+// event types, in the dump and in tools/trace2chrome.py
+typedef enum {
+	TRACE_TASK_IN = 0,		// id task number
+	TRACE_TASK_OUT,
+	TRACE_FIFO_WRITE,		// id sensor, value samples in the FIFO after the operation
+	TRACE_FIFO_READ,
+	TRACE_FIFO_OVERFLOW,
+	TRACE_QUEUE_SEND,		// id queue number, value items in the queue before the operation
+	TRACE_QUEUE_RECEIVE,
+	TRACE_QUEUE_BLOCK,		// the running task waits on the queue
+	TRACE_QUEUE_FAIL,		// timeout, or empty/full without waiting
+	TRACE_MUTEX_GIVE,		// same as the queue events, for mutexes
+	TRACE_MUTEX_TAKE,
+	TRACE_MUTEX_BLOCK,
+	TRACE_MUTEX_FAIL,
+	TRACE_UART_TX_START,	// id 0 queued line, 1 alarm lane, value bytes
+	TRACE_UART_TX_DONE,
+	TRACE_I2C_START,		// id bus priority, value device address
+	TRACE_I2C_DONE,			// value SUCCESS or FAILURE
+	TRACE_TYPE_COUNT
+} trace_type;
+
+#if TRACE_ENABLE
+void TRACE_Record(uint8_t type, uint8_t id, uint16_t value);
+void TRACE_Queue(uint8_t type, uint32_t number, uint8_t queue_type, uint32_t waiting);
+void TRACE_NameQueue(const char *name, void *queue);
+void TRACE_Dump(void);
+void TRACE_Poll(void);
+
+#define TRACE_QUEUE_HOOK(type, queue) do { \
+		if ((queue)->uxQueueNumber != 0) { \
+			TRACE_Queue(type, (queue)->uxQueueNumber, (queue)->ucQueueType, (queue)->uxMessagesWaiting); \
+		} \
+	} while (0)
+
+#define traceTASK_SWITCHED_IN()					TRACE_Record(TRACE_TASK_IN, (uint8_t)pxCurrentTCB->uxTCBNumber, 0)
+#define traceTASK_SWITCHED_OUT()				TRACE_Record(TRACE_TASK_OUT, (uint8_t)pxCurrentTCB->uxTCBNumber, 0)
+#define traceQUEUE_SEND(pxQueue)				TRACE_QUEUE_HOOK(TRACE_QUEUE_SEND, pxQueue)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)		TRACE_QUEUE_HOOK(TRACE_QUEUE_SEND, pxQueue)
+#define traceQUEUE_SEND_FAILED(pxQueue)			TRACE_QUEUE_HOOK(TRACE_QUEUE_FAIL, pxQueue)
+#define traceQUEUE_RECEIVE(pxQueue)				TRACE_QUEUE_HOOK(TRACE_QUEUE_RECEIVE, pxQueue)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)	TRACE_QUEUE_HOOK(TRACE_QUEUE_RECEIVE, pxQueue)
+#define traceQUEUE_RECEIVE_FAILED(pxQueue)		TRACE_QUEUE_HOOK(TRACE_QUEUE_FAIL, pxQueue)
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue)	TRACE_QUEUE_HOOK(TRACE_QUEUE_BLOCK, pxQueue)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue)	TRACE_QUEUE_HOOK(TRACE_QUEUE_BLOCK, pxQueue)
+#else
+#define TRACE_Record(type, id, value) ((void)0)
+#define TRACE_NameQueue(name, queue) ((void)0)
+#define TRACE_Dump() ((void)0)
+#define TRACE_Poll() ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,237 @@
+/*
+ * vibration.c
+ *
+ * Purpose: Reduce high rate accelerometer blocks to a vibration spectrum.
+ * Content:
+ * Block collection per axis, mean removal and Hann window.
+ * Real FFT: CMSIS-DSP arm_rfft_fast_f32, portable radix-2 fallback.
+ * Power spectra summed over the axes, band energies and top-K peaks of
+ * each block, UART report.
+ *
+ * Fed with the three accelerometer axes at the LSM6DSL ODR by the IMU FIFO
+ * task (ACQ_MODE_HWFIFO). Bearing wear or cavitation shows up as peaks at
+ * fixed frequencies well before the magnitude crosses a threshold, and a
+ * block of VIB_FFT_SIZE samples is sent as a few dozen numbers.
+ * The magnitude would not do as input: with gravity in it, a vibration
+ * perpendicular to gravity only shows up at second order, attenuated and
+ * at twice its frequency. Each axis loses its own mean (gravity, offset)
+ * instead, and the summed power is that of the vibration vector, whatever
+ * its direction.
+ */
+
+#include "vibration.h"
+#include "dsp_kernels.h"
+#include "timing.h"
+#include <math.h>
+#include <string.h>
+
+#if DSP_USE_CMSIS
+#include "arm_math.h"
+static arm_rfft_fast_instance_f32 rfft;
+#endif
+
+#define VIB_PI 3.14159265f
+
+// Hann: coherent gain 0.5, equivalent noise bandwidth 1.5 bins
+#define HANN_ENBW 1.5f
+
+static float window[VIB_FFT_SIZE];
+static float block[3][VIB_FFT_SIZE];
+static float spectrum[VIB_FFT_SIZE];
+static float power[VIB_FFT_SIZE / 2 + 1];
+static int fill;
+static float bin_hz;
+
+static vib_result result;
+static int result_new;
+
+void VIB_Init(float sample_rate_hz) {
+	for (int i = 0; i < VIB_FFT_SIZE; i++) {
+		window[i] = 0.5f - 0.5f * cosf(2 * VIB_PI * i / (VIB_FFT_SIZE - 1));
+	}
+	bin_hz = sample_rate_hz / VIB_FFT_SIZE;
+	fill = 0;
+	memset(&result, 0, sizeof(result));
+	result_new = 0;
+
+#if DSP_USE_CMSIS
+	arm_rfft_fast_init_f32(&rfft, VIB_FFT_SIZE);
+#endif
+}
+
+#if !DSP_USE_CMSIS
+/* Same output layout as arm_rfft_fast_f32: out[0] = X[0], out[1] = X[N/2],
+ * then re/im of X[1] .. X[N/2-1]. Plain complex radix-2 on the real input.
+ * */
+static void rfft_portable(const float *in, float *out) {
+	static float re[VIB_FFT_SIZE], im[VIB_FFT_SIZE];
+	const int n = VIB_FFT_SIZE;
+
+	for (int i = 0, j = 0; i < n; i++) {
+		re[j] = in[i];
+		im[j] = 0;
+		// bit reversed increment of j
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j |= bit;
+	}
+
+	for (int len = 2; len <= n; len <<= 1) {
+		float angle = -2 * VIB_PI / len;
+		float w_re = cosf(angle), w_im = sinf(angle);
+		for (int start = 0; start < n; start += len) {
+			float t_re = 1, t_im = 0;
+			for (int k = 0; k < len / 2; k++) {
+				int a = start + k, b = a + len / 2;
+				float b_re = re[b] * t_re - im[b] * t_im;
+				float b_im = re[b] * t_im + im[b] * t_re;
+				re[b] = re[a] - b_re;
+				im[b] = im[a] - b_im;
+				re[a] += b_re;
+				im[a] += b_im;
+				float next = t_re * w_re - t_im * w_im;
+				t_im = t_re * w_im + t_im * w_re;
+				t_re = next;
+			}
+		}
+	}
+
+	out[0] = re[0];
+	out[1] = re[n / 2];
+	for (int k = 1; k < n / 2; k++) {
+		out[2 * k] = re[k];
+		out[2 * k + 1] = im[k];
+	}
+}
+#endif
+
+/* Strongest local maxima of the power spectrum, DC excluded */
+static void find_peaks(vib_peak *peak) {
+	memset(peak, 0, VIB_PEAKS * sizeof(*peak));
+
+	for (int k = 2; k < VIB_FFT_SIZE / 2; k++) {
+		float p = power[k];
+		if (p <= power[k - 1] || p < power[k + 1]) {
+			continue;
+		}
+
+		float rms = sqrtf(p);
+		int slot = VIB_PEAKS;
+		while (slot > 0 && rms > peak[slot - 1].rms) {
+			slot--;
+		}
+		if (slot == VIB_PEAKS) {
+			continue;
+		}
+		memmove(&peak[slot + 1], &peak[slot], (VIB_PEAKS - 1 - slot) * sizeof(*peak));
+
+		// parabolic interpolation of the peak position between bins
+		float a = sqrtf(power[k - 1]), c = sqrtf(power[k + 1]);
+		float denom = a - 2 * rms + c;
+		float offset = denom != 0 ? 0.5f * (a - c) / denom : 0;
+		peak[slot].frequency = (k + offset) * bin_hz;
+		peak[slot].rms = rms;
+	}
+}
+
+static void analyse(void) {
+	uint32_t start = TIMING_Cycles();
+	vib_result r;
+
+	/* mean square of the sine in each bin: amplitude 2|X| / (N * 0.5), halved;
+	 * DC and Nyquist have no conjugate bin and are left out of the bands
+	 * */
+	const float scale = 8.0f / ((float)VIB_FFT_SIZE * VIB_FFT_SIZE);
+	memset(power, 0, sizeof(power));
+
+	for (int axis = 0; axis < 3; axis++) {
+		float *x = block[axis];
+		float mean = 0;
+
+		// the gravity offset would leak into the low bins through the window
+		for (int i = 0; i < VIB_FFT_SIZE; i++) {
+			mean += x[i];
+		}
+		mean /= VIB_FFT_SIZE;
+		for (int i = 0; i < VIB_FFT_SIZE; i++) {
+			x[i] = (x[i] - mean) * window[i];
+		}
+
+#if DSP_USE_CMSIS
+		arm_rfft_fast_f32(&rfft, x, spectrum, 0);	// overwrites the axis block
+#else
+		rfft_portable(x, spectrum);
+#endif
+
+		for (int k = 1; k < VIB_FFT_SIZE / 2; k++) {
+			float re = spectrum[2 * k], im = spectrum[2 * k + 1];
+			power[k] += (re * re + im * im) * scale;
+		}
+	}
+
+	memset(r.band_energy, 0, sizeof(r.band_energy));
+	for (int k = 1; k < VIB_FFT_SIZE / 2; k++) {
+		r.band_energy[k * VIB_BANDS / (VIB_FFT_SIZE / 2)] += power[k] / HANN_ENBW;
+	}
+	find_peaks(r.peak);
+	r.cycles = TIMING_Cycles() - start;
+
+	taskENTER_CRITICAL();
+	r.sequence = result.sequence + 1;
+	result = r;
+	result_new = 1;
+	taskEXIT_CRITICAL();
+}
+
+/* One accelerometer sample, x y z in m/s2, at the sample rate given to
+ * VIB_Init(). Returns 1 when it completed a block and a new result is
+ * available.
+ * */
+int VIB_AddSample(const float *xyz) {
+	block[0][fill] = xyz[0];
+	block[1][fill] = xyz[1];
+	block[2][fill] = xyz[2];
+	fill++;
+	if (fill < VIB_FFT_SIZE) {
+		return 0;
+	}
+	fill = 0;
+	analyse();
+	return 1;
+}
+
+/* Copy of the last result, SUCCESS once per new result */
+int VIB_GetResult(vib_result *out) {
+	int status;
+
+	taskENTER_CRITICAL();
+	*out = result;
+	status = result_new ? SUCCESS : FAILURE;
+	result_new = 0;
+	taskEXIT_CRITICAL();
+	return status;
+}
+
+/* Three lines per new block: peaks, lower and upper half of the bands */
+void VIB_Report(void) {
+	char message[MAX_MESSAGE_LENGTH];
+	vib_result r;
+
+	if (VIB_GetResult(&r) != SUCCESS) {
+		return;
+	}
+
+	snprintf(message, sizeof(message), "Vib#%lu pk %.1fHz %.3f %.1fHz %.3f %.1fHz %.3f\r\n",
+			(unsigned long)r.sequence, r.peak[0].frequency, r.peak[0].rms, r.peak[1].frequency, r.peak[1].rms,
+			r.peak[2].frequency, r.peak[2].rms);
+	send_uart_message(message);
+
+	for (int half = 0; half < 2; half++) {
+		const float *e = &r.band_energy[half * VIB_BANDS / 2];
+		snprintf(message, sizeof(message), "Vib#%lu b%d-%d %.2e %.2e %.2e %.2e\r\n",
+				(unsigned long)r.sequence, half * VIB_BANDS / 2, (half + 1) * VIB_BANDS / 2 - 1, e[0], e[1], e[2], e[3]);
+		send_uart_message(message);
+	}
+}
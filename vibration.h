@@ -0,0 +1,43 @@
+/*
+ * vibration.h
+ *
+ * Purpose: Declare the vibration spectrum stage.
+ * Content:
+ * Block size, band and peak counts, result structure and the functions
+ * fed by the motion acquisition and read by the scheduler.
+ */
+
+#ifndef VIBRATION_H
+#define VIBRATION_H
+
+#include "sensors.h"
+
+// accelerometer samples per spectrum, power of two (CMSIS rfft: 32..4096)
+#ifndef VIB_FFT_SIZE
+#define VIB_FFT_SIZE 256
+#endif
+
+// equal width bands between 0 and half the sample rate
+#define VIB_BANDS 8
+
+// strongest spectral peaks reported per block
+#define VIB_PEAKS 3
+
+typedef struct {
+	float frequency;	// Hz, interpolated between bins
+	float rms;			// m/s2
+} vib_peak;
+
+typedef struct {
+	uint32_t sequence;				// blocks analysed since start
+	float band_energy[VIB_BANDS];	// (m/s2)^2 of each band, all axes, DC excluded
+	vib_peak peak[VIB_PEAKS];		// strongest first, frequency 0 if fewer peaks
+	uint32_t cycles;				// window + FFT + reduction
+} vib_result;
+
+void VIB_Init(float sample_rate_hz);
+int VIB_AddSample(const float *xyz);
+int VIB_GetResult(vib_result *result);
+void VIB_Report(void);
+
+#endif